@@ -0,0 +1,293 @@
+// byte_io's common.h declares names that general/constants.h defines as macros, so it goes first
+#include "general/c/byte_io.h"
+
+#include "ast_cache.h"
+
+AstCache::AstCache():
+enabled(false),
+dir(nullptr),
+path(nullptr),
+source_hash(0),
+pending(),
+waiting(),
+symbols()
+{}
+
+AstCache::~AstCache() {}
+
+void AstCache::ctor() {
+	ctor(false);
+}
+
+void AstCache::ctor(const bool enabled_, const char *dir_) {
+	enabled     = enabled_;
+	dir         = dir_;
+	path        = nullptr;
+	source_hash = 0;
+
+	pending.ctor();
+	waiting.ctor();
+	symbols.ctor();
+}
+
+AstCache *AstCache::NEW(const bool enabled_, const char *dir_) {
+	AstCache *cake = (AstCache*) calloc(1, sizeof(AstCache));
+	if (!cake) {
+		return nullptr;
+	}
+
+	cake->ctor(enabled_, dir_);
+	return cake;
+}
+
+void AstCache::dtor() {
+	free(path);
+	path = nullptr;
+
+	pending.dtor();
+	waiting.dtor();
+	symbols.dtor();
+}
+
+void AstCache::DELETE(AstCache *cache) {
+	if (!cache) {
+		return;
+	}
+
+	cache->dtor();
+	free(cache);
+}
+
+//=============================================================================
+
+// eight bytes a step, it has to be much cheaper than lexing the same text
+unsigned long long AstCache::hash(const char *data, const size_t length) {
+	const unsigned long long mul = 0x9E3779B97F4A7C15ull;
+	unsigned long long ret = length * mul;
+
+	size_t i = 0;
+	for (; i + 8 <= length; i += 8) {
+		unsigned long long word = 0;
+		memcpy(&word, data + i, 8);
+		ret = (ret ^ word) * mul;
+		ret ^= ret >> 29;
+	}
+
+	unsigned long long tail = 0;
+	memcpy(&tail, data + i, length - i);
+	ret = (ret ^ tail) * mul;
+
+	ret ^= ret >> 32;
+	ret *= mul;
+	ret ^= ret >> 29;
+	return ret;
+}
+
+bool AstCache::make_path(const File *source) {
+	free(path);
+	path = nullptr;
+
+	if (!dir && (!source->name || !strcmp(source->name, "-"))) { // stdin has nothing to sit next to
+		return false;
+	}
+
+	const size_t length = (dir ? strlen(dir) + 17 : strlen(source->name)) + sizeof(AST_CACHE_EXT) + 1;
+	path = (char*) calloc(length, sizeof(char));
+	if (!path) {
+		return false;
+	}
+
+	if (dir) {
+		snprintf(path, length, "%s/%016llx%s", dir, source_hash, AST_CACHE_EXT);
+	} else {
+		snprintf(path, length, "%s%s", source->name, AST_CACHE_EXT);
+	}
+
+	return true;
+}
+
+CodeNode *AstCache::load(const File *source) {
+	if (!enabled || !source->data) {
+		return nullptr;
+	}
+
+	source_hash = hash(source->data, source->length);
+	if (!make_path(source)) {
+		return nullptr;
+	}
+
+	File cache = {};
+	cache.ctor(path, FILE_MAP);
+
+	CodeNode *tree = cache.data ? read_tree(&cache, source) : nullptr;
+	cache.dtor();
+	return tree;
+}
+
+CodeNode *AstCache::read_tree(const File *cache, const File *source) {
+	ByteIP input = {cache->length, 0, cache->length, (byte*) cache->data};
+
+	AstCacheHeader header = {};
+	if (ByteIP_get(&input, &header, sizeof(header))
+		|| header.magic         != AST_CACHE_MAGIC
+		|| header.version       != AST_CACHE_VERSION
+		|| header.source_hash   != source_hash
+		|| header.source_length != source->length
+		|| header.symbol_cnt < 0 || header.node_cnt <= 0) {
+		return nullptr;
+	}
+
+	const size_t symbols_size = (size_t) header.symbol_cnt * sizeof(AstCacheSymbol);
+	const size_t nodes_size   = (size_t) header.node_cnt   * sizeof(AstCacheNode);
+	if (header.names_size % 8 || header.names_size > input.size
+		|| input.size - input.cur_idx != symbols_size + header.names_size + nodes_size) {
+		return nullptr;
+	}
+
+	if (hash((const char*) input.buffer + input.cur_idx, input.size - input.cur_idx) != header.body_hash) {
+		return nullptr;
+	}
+
+	const byte *names = input.buffer + input.cur_idx + symbols_size;
+
+	symbols.dtor();
+	symbols.ctor();
+	for (int i = 0; i < header.symbol_cnt; ++i) {
+		AstCacheSymbol symbol = {};
+		ByteIP_get(&input, &symbol, sizeof(symbol));
+		if (symbol.offset < 0 || symbol.length < 0 || (size_t) symbol.offset + (size_t) symbol.length > header.names_size) {
+			return nullptr;
+		}
+
+		symbols.push_back(SYMBOL_POOL.intern((const char*) names + symbol.offset, (size_t) symbol.length));
+	}
+	input.cur_idx += header.names_size;
+
+	// preorder: a node is the L of the one before it if that one has an L, else
+	// the R of the latest node still waiting for one
+	CodeNode *root   = nullptr;
+	CodeNode *parent = nullptr;
+	waiting.dtor();
+	waiting.ctor();
+
+	for (int i = 0; i < header.node_cnt; ++i) {
+		AstCacheNode record = {};
+		ByteIP_get(&input, &record, sizeof(record));
+
+		bool broken = record.type < OPERATION || record.type > ID
+		           || (record.type == ID && (record.data.id < 0 || record.data.id >= header.symbol_cnt))
+		           || (i > 0 && !parent && !waiting.size());
+		if (broken) {
+			CodeNode::DELETE(root, true);
+			return nullptr;
+		}
+
+		CodeNode *node = CodeNode::NEW();
+		node->type = record.type;
+		node->data = record.data;
+		node->line = record.line;
+		node->pos  = record.pos;
+		if (node->type == ID) {
+			node->data.id = symbols[(size_t) record.data.id];
+		}
+
+		if (parent) {
+			parent->L = node;
+		} else if (waiting.size()) {
+			waiting.pop_back()->R = node;
+		} else {
+			root = node;
+		}
+
+		if (record.kids & AST_CACHE_HAS_R) {
+			waiting.push_back(node);
+		}
+		parent = (record.kids & AST_CACHE_HAS_L) ? node : nullptr;
+	}
+
+	if (parent || waiting.size()) {
+		CodeNode::DELETE(root, true);
+		return nullptr;
+	}
+
+	return root;
+}
+
+bool AstCache::store(const File *source, const CodeNode *tree) {
+	if (!enabled || !path || !tree) {
+		return false;
+	}
+
+	ByteOP *output = new_ByteOP(sizeof(AstCacheHeader) + (size_t) SYMBOL_POOL.size() * 32);
+	if (!output) {
+		return false;
+	}
+
+	AstCacheHeader header = {};
+	header.magic         = AST_CACHE_MAGIC;
+	header.version       = AST_CACHE_VERSION;
+	header.source_hash   = source_hash;
+	header.source_length = source->length;
+	header.symbol_cnt    = SYMBOL_POOL.size();
+	ByteOP_put(output, &header, sizeof(header));
+
+	int offset = 0;
+	for (int i = 0; i < header.symbol_cnt; ++i) {
+		AstCacheSymbol symbol = {offset, (int) SYMBOL_POOL.get(i)->length()};
+		ByteOP_put(output, &symbol, sizeof(symbol));
+		offset += symbol.length;
+	}
+
+	for (int i = 0; i < header.symbol_cnt; ++i) {
+		const StringView *name = SYMBOL_POOL.get(i);
+		ByteOP_put(output, name->get_buffer(), name->length());
+	}
+
+	const char padding[8] = {};
+	ByteOP_put(output, padding, (8 - offset % 8) % 8);
+	header.names_size = (unsigned long long) offset + (8 - offset % 8) % 8;
+
+	// same walk as FlatAst::flatten(): down the L spine, R subtrees wait on pending
+	pending.dtor();
+	pending.ctor();
+	pending.push_back(tree);
+	while (pending.size()) {
+		for (const CodeNode *node = pending.pop_back(); node; node = node->L) {
+			AstCacheNode record = {};
+			record.data = node->data;
+			record.line = node->line;
+			record.pos  = node->pos;
+			record.type = node->type;
+			record.kids = (char) ((node->L ? AST_CACHE_HAS_L : 0) | (node->R ? AST_CACHE_HAS_R : 0));
+			ByteOP_put(output, &record, sizeof(record));
+			++header.node_cnt;
+
+			if (node->R) {
+				pending.push_back(node->R);
+			}
+		}
+	}
+
+	header.body_hash = hash((const char*) output->buffer + sizeof(header), output->size - sizeof(header));
+	memcpy(output->buffer, &header, sizeof(header));
+
+	// written aside and renamed over, a concurrent reader never sees half a file
+	const size_t tmp_length = strlen(path) + 32;
+	char *tmp_path = (char*) calloc(tmp_length, sizeof(char));
+	bool ok = tmp_path != nullptr;
+	if (ok) {
+		snprintf(tmp_path, tmp_length, "%s.%d.tmp", path, (int) getpid());
+		ok = ByteOP_to_file(output, tmp_path) == OK && !rename(tmp_path, path);
+		if (!ok) {
+			remove(tmp_path);
+		}
+	}
+
+	free(tmp_path);
+	delete_ByteOP(output);
+	return ok;
+}
+
+bool AstCache::is_enabled() const {
+	return enabled;
+}
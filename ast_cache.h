@@ -0,0 +1,100 @@
+#ifndef AST_CACHE_H
+#define AST_CACHE_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "general/cpp/file.hpp"
+#include "general/cpp/vector.hpp"
+
+#include "code_node.h"
+#include "symbol_pool.h"
+
+const int  AST_CACHE_MAGIC   = 0x5453414B; // "KAST" in the file
+const int  AST_CACHE_VERSION = 1; // bump on any change to the format or to the trees the parser builds
+const char AST_CACHE_EXT[]   = ".kast";
+
+const char AST_CACHE_HAS_L = 1;
+const char AST_CACHE_HAS_R = 2;
+
+// A cache file is these fixed-size parts, one after another, so it is read in
+// place from a mapping:
+//   AstCacheHeader
+//   AstCacheSymbol[symbol_cnt]  - SYMBOL_POOL in symbol order
+//   names[names_size]           - their bytes, padded to 8
+//   AstCacheNode[node_cnt]      - the tree in preorder, L before R
+struct AstCacheHeader {
+	int                magic;
+	int                version;
+	unsigned long long source_hash;
+	unsigned long long source_length;
+	int                symbol_cnt;
+	int                node_cnt;
+	unsigned long long names_size;
+	unsigned long long body_hash;  // of everything after the header
+};
+
+struct AstCacheSymbol {
+	int offset; // into names
+	int length;
+};
+
+struct AstCacheNode {
+	CodeNodeData data;
+	int          line;
+	int          pos;
+	char         type;
+	char         kids; // AST_CACHE_HAS_L | AST_CACHE_HAS_R
+	char         padding[6];
+};
+
+//=============================================================================
+// AstCache ===================================================================
+// Parsed trees of sources that were compiled before, keyed by a hash of the
+// source text. A file lives next to its source as <source>.kast, or in a cache
+// dir as <hash>.kast. Anything that does not match the source - a stale or
+// foreign file, an old version, a broken one - is a miss, never an error.
+
+class AstCache {
+private:
+// data =======================================================================
+	bool  enabled;
+	const char *dir;  // nullptr puts the files next to their sources
+	char *path;       // of the source last looked up
+	unsigned long long source_hash;
+
+	Vector<const CodeNode*> pending; // store(): R subtrees still to write
+	Vector<CodeNode*>       waiting; // load(): nodes whose R comes later
+	Vector<int>             symbols; // load(): cached symbol -> SYMBOL_POOL one
+//=============================================================================
+
+	bool make_path(const File *source);
+
+	CodeNode *read_tree(const File *cache, const File *source);
+
+public:
+	AstCache            (const AstCache&) = delete;
+	AstCache &operator= (const AstCache&) = delete;
+
+	AstCache ();
+	~AstCache();
+
+	void ctor();
+	void ctor(const bool enabled_, const char *dir_ = nullptr);
+	static AstCache *NEW(const bool enabled_, const char *dir_ = nullptr);
+
+	void dtor();
+	static void DELETE(AstCache *cache);
+
+//=============================================================================
+
+	static unsigned long long hash(const char *data, const size_t length);
+
+	CodeNode *load (const File *source);                       // nullptr on a miss
+	bool      store(const File *source, const CodeNode *tree); // after the miss load() had on it
+
+	bool is_enabled() const;
+};
+
+#endif // AST_CACHE_H
@@ -0,0 +1,238 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Shared by the bench tools: timing, generated sources and token and tree
+// comparisons. Everything is checked against the plain serial path, a tool
+// exits with 1 on the first mismatch it reports.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+
+#include "../lexical_parser.h"
+#include "../code_node.h"
+
+static inline double bench_ms() {
+	timespec now = {};
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double) now.tv_sec * 1e3 + (double) now.tv_nsec / 1e6;
+}
+
+// xorshift64*, the same numbers on every box
+static inline unsigned long long bench_rand(unsigned long long *state) {
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return *state * 0x2545F4914F6CDD1Dull;
+}
+
+static inline size_t bench_below(unsigned long long *state, const size_t n) {
+	return n ? (size_t) (bench_rand(state) % n) : 0;
+}
+
+//=============================================================================
+// BenchText ==================================================================
+// A growing '\0'-terminated source.
+
+struct BenchText {
+	char   *data;
+	size_t  length;
+	size_t  capacity;
+
+	void ctor() {
+		capacity = 1 << 12;
+		length   = 0;
+		data     = (char*) calloc(capacity, sizeof(char));
+		if (!data) {
+			throw std::length_error("[ERR]<bench>: calloc fail");
+		}
+	}
+
+	void dtor() {
+		free(data);
+		data     = nullptr;
+		length   = 0;
+		capacity = 0;
+	}
+
+	void reserve(const size_t new_length) {
+		if (new_length + 1 <= capacity) {
+			return;
+		}
+
+		while (capacity < new_length + 1) {
+			capacity *= 2;
+		}
+		char *new_data = (char*) realloc(data, capacity);
+		if (!new_data) {
+			throw std::length_error("[ERR]<bench>: realloc fail");
+		}
+		data = new_data;
+	}
+
+	void append(const char *str, const size_t len) {
+		reserve(length + len);
+		memcpy(data + length, str, len);
+		length += len;
+		data[length] = '\0';
+	}
+
+	void append(const char *str) {
+		append(str, strlen(str));
+	}
+
+	// [start, start + old_length) becomes str
+	void replace(const size_t start, const size_t old_length, const char *str, const size_t len) {
+		reserve(length - old_length + len);
+		memmove(data + start + len, data + start + old_length, length - start - old_length + 1);
+		memcpy(data + start, str, len);
+		length = length - old_length + len;
+	}
+
+	bool read(const char *path) {
+		FILE *file = fopen(path, "rb");
+		if (!file) {
+			return false;
+		}
+
+		char buf[1 << 14];
+		for (size_t got = 0; (got = fread(buf, 1, sizeof(buf), file)) > 0;) {
+			append(buf, got);
+		}
+		fclose(file);
+		return true;
+	}
+
+	bool write(const char *path) const {
+		FILE *file = fopen(path, "wb");
+		if (!file) {
+			return false;
+		}
+
+		const bool written = fwrite(data, 1, length, file) == length;
+		fclose(file);
+		return written;
+	}
+};
+
+//=============================================================================
+// generated sources ==========================================================
+
+const int BENCH_FUNC_BYTES = 290; // what bench_gen_program() makes of a func
+
+// funcs top-level funcs, each calls the one before it
+static inline void bench_gen_program(BenchText *text, const int funcs) {
+	char line[256] = {};
+
+	text->append("{\n");
+	for (int i = 0; i < funcs; ++i) {
+		snprintf(line, sizeof(line), "\tfunc f%d[var a = a][var b = b] {\n", i);
+		text->append(line);
+		text->append("\t\tvar s = 0; /* running sum */\n");
+		text->append("\t\t>> (var i = 0 | i < a * b + 3 | i = i + 1) {\n");
+		text->append("\t\t\t? (i / 2 * 2 == i && s < 1000 || b > a) { s = s + (i - a) * (b + 1) ^ 2 / (3 + i); }\n");
+		text->append("\t\t\tvar t = -s + a * -2.5e-1;\n");
+		text->append("\t\t\ts += t * 0.5; // halved\n");
+		text->append("\t\t}\n");
+		if (i) {
+			snprintf(line, sizeof(line), "\t\tf%d[a][b];\n", i - 1);
+			text->append(line);
+		}
+		text->append("\t\tret s;\n");
+		text->append("\t}\n");
+	}
+	snprintf(line, sizeof(line), "\t__PUT_NUMBER__ f%d[1][2];\n}\n", funcs - 1);
+	text->append(line);
+}
+
+// pieces a random edit or soup is made of: comment and char literal edges,
+// partial operators, numbers and newlines are where the lexer state changes
+static const char *BENCH_PIECES[] = {
+	"/*", "*/", "//", "\n", "/>", "</", "'", "1", "2.5e3", "x", "abc", " ", "\t", "<=", "<", "=", ">|",
+	"__PUT_", "ret", "var ", ";", "{", "}", "-", "+1", "'a'", "\n\n", "~", "e", ".", "__PUT_NUMBER__",
+	"id_long_name ", "/*/", "'\\n'",
+};
+
+static const size_t BENCH_PIECE_CNT = sizeof(BENCH_PIECES) / sizeof(BENCH_PIECES[0]);
+
+// not a program, only lexable: random pieces with long comments now and then
+static inline void bench_gen_soup(BenchText *text, const size_t length, unsigned long long *rng) {
+	while (text->length < length) {
+		if (!bench_below(rng, 50)) {
+			text->append("/* a comment\n\n spanning lines */");
+		}
+		if (!bench_below(rng, 20000)) {
+			text->append("/*");
+			for (int k = 0; k < 300000; ++k) {
+				text->append(k % 37 ? "q" : "\n", 1);
+			}
+			text->append("*/");
+		}
+		text->append(BENCH_PIECES[bench_below(rng, BENCH_PIECE_CNT)]);
+	}
+}
+
+//=============================================================================
+// comparisons ================================================================
+
+static inline bool bench_same_data(const int type, const TokenData a, const TokenData b) {
+	if (type == T_NUMBER) {
+		return !memcmp(&a.num, &b.num, sizeof(a.num));
+	}
+	return a.op == b.op; // op or symbol id
+}
+
+// type, data, line and pos of every token; the first difference is reported
+static inline bool bench_same_tokens(const TokenStream *a, const TokenStream *b, const char *what) {
+	const size_t cnt = a->size() < b->size() ? a->size() : b->size();
+	for (size_t i = 0; i < cnt; ++i) {
+		const Token x = a->get(i);
+		const Token y = b->get(i);
+		if (x.type != y.type || x.line != y.line || x.pos != y.pos || !bench_same_data(x.type, x.data, y.data)) {
+			printf("%s: token %zu is (%d, %d, %d:%d), expected (%d, %d, %d:%d)\n", what, i,
+			       y.type, y.data.op, y.line, y.pos, x.type, x.data.op, x.line, x.pos);
+			return false;
+		}
+	}
+
+	if (a->size() != b->size()) {
+		printf("%s: %zu tokens, expected %zu\n", what, b->size(), a->size());
+		return false;
+	}
+	return true;
+}
+
+// type, payload, line and pos of every node, walked without recursion
+static inline bool bench_same_tree(const CodeNode *a, const CodeNode *b, const char *what) {
+	Vector<const CodeNode*> walk = {};
+	walk.ctor();
+	walk.push_back(a);
+	walk.push_back(b);
+
+	bool same = true;
+	while (same && walk.size()) {
+		const CodeNode *y = walk.pop_back();
+		const CodeNode *x = walk.pop_back();
+		if (!x || !y) {
+			same = x == y;
+		} else {
+			same = x->type == y->type && x->line == y->line && x->pos == y->pos
+			    && (x->type == VALUE ? !memcmp(&x->data.val, &y->data.val, sizeof(double)) : x->data.op == y->data.op);
+			walk.push_back(x->L);
+			walk.push_back(y->L);
+			walk.push_back(x->R);
+			walk.push_back(y->R);
+		}
+
+		if (!same) {
+			printf("%s: trees differ at line %d pos %d\n", what, x ? x->line : -1, x ? x->pos : -1);
+		}
+	}
+
+	walk.dtor();
+	return same;
+}
+
+#endif // BENCH_H
@@ -0,0 +1,131 @@
+// lex_bench - times the lexer paths and checks them against serial parse()
+// usage: lex_bench [megabytes = 10] [soups = 20] [seed = 1] [out.ctx]
+//
+// On a generated program of the given size:
+//   full     parse(): time, tokens and stream memory per KB of source
+//   stream   the lazy stream() pulled to T_END as the parser does
+//   -jN      parse(threads) at 1..16 threads
+// Then soups, random lexable garbage of 0.6..2.1 MB with comments across
+// chunk cuts, are lexed at 2, 5 and 8 threads. Every token of every path
+// must match serial parse(). Each lex has a LexicalParser of its own, as
+// parse() keeps counting lines where the last lex stopped. out.ctx gets the
+// program, so kncc -jN can be run on it too.
+
+#include "bench.h"
+
+const int LEX_BENCH_REPEATS = 3; // the best one is reported
+
+static TokenStream *lex_full(const BenchText &text, const int threads, double *ms) {
+	TokenStream *best = nullptr;
+	*ms = 0;
+	for (int r = 0; r < LEX_BENCH_REPEATS; ++r) {
+		LexicalParser lexer = {};
+		lexer.ctor();
+
+		const double start = bench_ms();
+		TokenStream *tokens = threads ? lexer.parse(text.data, text.length, threads) : lexer.parse(text.data, text.length);
+		const double spent = bench_ms() - start;
+
+		if (!best || spent < *ms) {
+			*ms = spent;
+		}
+		TokenStream::DELETE(best);
+		best = tokens;
+		lexer.dtor();
+	}
+	return best;
+}
+
+// pulls the lazy stream to its end, checking every token on the way if serial is given
+static bool pull_stream(const BenchText &text, const TokenStream *serial, double *ms) {
+	LexicalParser lexer = {};
+	lexer.ctor();
+
+	const double start = bench_ms();
+	TokenStream *tokens = lexer.stream(text.data, text.length);
+
+	bool same = true;
+	Token token = {};
+	for (size_t i = 0; same; ++i) {
+		tokens->fetch(i, &token);
+		if (serial) {
+			const Token expected = serial->get(i);
+			same = token.type == expected.type && bench_same_data(token.type, token.data, expected.data)
+			    && tokens->line(i) == expected.line && tokens->pos(i) == expected.pos;
+			if (!same) {
+				printf("stream: token %zu differs from parse()\n", i);
+			}
+		}
+
+		if (token.type == T_END) {
+			break;
+		}
+	}
+	*ms = bench_ms() - start;
+
+	TokenStream::DELETE(tokens);
+	lexer.dtor();
+	return same;
+}
+
+int main(const int argc, const char **argv) {
+	const size_t       megabytes = argc > 1 ? (size_t) atoi(argv[1]) : 10;
+	const int          soups     = argc > 2 ? atoi(argv[2]) : 20;
+	unsigned long long rng       = argc > 3 ? (unsigned long long) atoll(argv[3]) : 1;
+	rng = rng * 0x9E3779B97F4A7C15ull + 1;
+
+	BenchText text = {};
+	text.ctor();
+	bench_gen_program(&text, (int) (megabytes * 1024 * 1024 / BENCH_FUNC_BYTES) + 1);
+	if (argc > 4 && !text.write(argv[4])) {
+		printf("lex_bench: can't write [%s]\n", argv[4]);
+		return 1;
+	}
+
+	int fails = 0;
+	double ms = 0;
+
+	TokenStream *serial = lex_full(text, 0, &ms);
+	printf("lex_bench: %zu chars, %zu tokens\n", text.length, serial->size());
+	printf("    full     %8.1f ms, %zu B of tokens per KB\n", ms, serial->memory() * 1024 / text.length);
+
+	fails += !pull_stream(text, nullptr, &ms);
+	printf("    stream   %8.1f ms\n", ms);
+	fails += !pull_stream(text, serial, &ms);
+
+	for (int threads = 1; threads <= 16; threads *= 2) {
+		TokenStream *tokens = lex_full(text, threads, &ms);
+		printf("    -j%-2d     %8.1f ms\n", threads, ms);
+		fails += !bench_same_tokens(serial, tokens, "parallel");
+		TokenStream::DELETE(tokens);
+	}
+	TokenStream::DELETE(serial);
+
+	for (int s = 0; s < soups; ++s) {
+		text.length = 0;
+		bench_gen_soup(&text, 600000 + bench_below(&rng, 1500000), &rng);
+
+		LexicalParser lexer = {};
+		lexer.ctor();
+		TokenStream *soup = lexer.parse(text.data, text.length);
+
+		for (int threads = 2; threads <= 8; threads += 3) {
+			LexicalParser chunk_lexer = {};
+			chunk_lexer.ctor();
+			TokenStream *tokens = chunk_lexer.parse(text.data, text.length, threads);
+			if (!bench_same_tokens(soup, tokens, "soup")) {
+				printf("lex_bench: soup %d at %d threads\n", s, threads);
+				++fails;
+			}
+			TokenStream::DELETE(tokens);
+			chunk_lexer.dtor();
+		}
+
+		TokenStream::DELETE(soup);
+		lexer.dtor();
+	}
+	printf("lex_bench: %d soups at 2, 5 and 8 threads, %d failed checks in all\n", soups, fails);
+
+	text.dtor();
+	return fails ? 1 : 0;
+}
@@ -0,0 +1,98 @@
+// nest_bench - runs kncc on programs nested as deep as the source can go
+// usage: nest_bench [depth = 1000000] [kncc = ./kncc]
+//
+// Every case is head, depth times open, middle, depth times close and tail,
+// written to bench/nest.ctx and compiled by kncc with the stack limited to
+// the default 8 MB, so a pass that recurses once per level crashes it. A
+// case fails if kncc does not exit with 0.
+
+#include <sys/resource.h>
+
+#include "bench.h"
+
+const rlim_t NEST_BENCH_STACK = 8 << 20;
+
+struct NestCase {
+	const char *name;
+	const char *head;
+	const char *open;
+	const char *middle;
+	const char *close;
+	const char *tail;
+};
+
+static const NestCase NEST_CASES[] = {
+	{"- - x",         "{ var x = 1; __PUT_NUMBER__ ", "- ",       "x",       "",   "; }\n"},
+	{"((x))",         "{ var x = 1; __PUT_NUMBER__ ", "(",        "x",       ")",  "; }\n"},
+	{"x ^ x ^ x",     "{ var x = 1; __PUT_NUMBER__ ", "x ^ ",     "x",       "",   "; }\n"},
+	{"{ { } }",       "{ var x = 1; ",                "{ ",       "x = 2; ", "} ", "}\n"  },
+	{"? (x) { }",     "{ var x = 1; ",                "? (x) { ", "x = 2; ", "} ", "}\n"  },
+	{">| (x) { }",    "{ var x = 1; ",                ">| (x) { ", "x = 0; ", "} ", "}\n" },
+	{">> (x) { }",    "{ var x = 1; ", ">> (x = 0 | x < 1 | x = x + 1) { ", "x = 2; ", "} ", "}\n"},
+	{"func f { }",    "{ var x = 1; ",                "func f { ", "x = 2; ", "} ", "}\n" },
+	{"x && x && x",   "{ var x = 1; __PUT_NUMBER__ ", "x && ",    "x",       "",   "; }\n"},
+	{"x || x || x",   "{ var x = 1; __PUT_NUMBER__ ", "x || ",    "x",       "",   "; }\n"},
+	{"? (x && x)",    "{ var x = 1; ? (",             "x && ",    "x",       "",   ") x = 2; }\n"},
+	{"? (x && (x))",  "{ var x = 1; ? (",             "x && (",   "x",       ")",  ") x = 2; }\n"},
+	{"x || (x)",      "{ var x = 1; __PUT_NUMBER__ ", "x || (",   "x",       ")",  "; }\n"},
+	{"x && -(x)",     "{ var x = 1; __PUT_NUMBER__ ", "x && -(",  "x",       ")",  "; }\n"},
+};
+
+static const size_t NEST_CASE_CNT = sizeof(NEST_CASES) / sizeof(NEST_CASES[0]);
+
+static void gen_nest(BenchText *text, const NestCase &nest, const int depth) {
+	const size_t open_len  = strlen(nest.open);
+	const size_t close_len = strlen(nest.close);
+
+	text->append(nest.head);
+	for (int i = 0; i < depth; ++i) {
+		text->append(nest.open, open_len);
+	}
+	text->append(nest.middle);
+	for (int i = 0; i < depth; ++i) {
+		text->append(nest.close, close_len);
+	}
+	text->append(nest.tail);
+}
+
+int main(const int argc, const char **argv) {
+	const int   depth = argc > 1 ? atoi(argv[1]) : 1000000;
+	const char *kncc  = argc > 2 ? argv[2] : "./kncc";
+
+	// kncc inherits it through system()
+	rlimit stack = {};
+	getrlimit(RLIMIT_STACK, &stack);
+	stack.rlim_cur = stack.rlim_max == RLIM_INFINITY || stack.rlim_max > NEST_BENCH_STACK ? NEST_BENCH_STACK : stack.rlim_max;
+	if (setrlimit(RLIMIT_STACK, &stack)) {
+		printf("nest_bench: can't limit the stack\n");
+		return 1;
+	}
+
+	char command[512] = {};
+	snprintf(command, sizeof(command), "%s bench/nest.ctx bench/nest.kc > /dev/null", kncc);
+
+	printf("nest_bench: depth %d, %zu KB stack\n", depth, (size_t) stack.rlim_cur >> 10);
+	int fails = 0;
+	for (size_t i = 0; i < NEST_CASE_CNT; ++i) {
+		BenchText text = {};
+		text.ctor();
+		gen_nest(&text, NEST_CASES[i], depth);
+		if (!text.write("bench/nest.ctx")) {
+			printf("nest_bench: can't write [bench/nest.ctx]\n");
+			return 1;
+		}
+
+		fflush(stdout);
+		const double start  = bench_ms();
+		const int    status = system(command);
+		const double spent  = bench_ms() - start;
+
+		const bool ok = status == 0;
+		printf("    %-12s %6zu KB %9.1f ms %s\n", NEST_CASES[i].name, text.length >> 10, spent, ok ? "ok" : "FAILED");
+		fails += !ok;
+		text.dtor();
+	}
+	printf("nest_bench: %d failed cases\n", fails);
+
+	return fails ? 1 : 0;
+}
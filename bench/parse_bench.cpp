@@ -0,0 +1,69 @@
+// parse_bench - times the parser at -p1..-p8 and checks the trees against -p1
+// usage: parse_bench [funcs = 10000] [out.ctx]
+//
+// The program is bench_gen_program() of the given size, lexed once in full.
+// Every tree must match the serial one node by node: type, payload, line and
+// pos. out.ctx gets the program, so kncc can be run on it too.
+
+#include "bench.h"
+#include "../recursive_parser.h"
+
+const int PARSE_BENCH_REPEATS = 5; // the best one is reported
+
+static ParseNode *parse_with(TokenStream *tokens, const int threads, double *ms) {
+	ParseNode *tree = nullptr;
+	*ms = 0;
+	for (int r = 0; r < PARSE_BENCH_REPEATS; ++r) {
+		RecursiveParser parser = {};
+		parser.ctor();
+		parser.set_threads(threads);
+
+		const double start = bench_ms();
+		ParseNode *parsed = parser.parse(tokens);
+		const double spent = bench_ms() - start;
+
+		if (!tree || spent < *ms) {
+			*ms = spent;
+		}
+		CodeNode::DELETE(tree, true);
+		tree = parsed;
+		parser.dtor();
+	}
+	return tree;
+}
+
+int main(const int argc, const char **argv) {
+	const int funcs = argc > 1 ? atoi(argv[1]) : 10000;
+
+	BenchText text = {};
+	text.ctor();
+	bench_gen_program(&text, funcs);
+	if (argc > 2 && !text.write(argv[2])) {
+		printf("parse_bench: can't write [%s]\n", argv[2]);
+		return 1;
+	}
+
+	LexicalParser lexer = {};
+	lexer.ctor();
+	TokenStream *tokens = lexer.parse(text.data, text.length);
+
+	double ms = 0;
+	ParseNode *serial = parse_with(tokens, 1, &ms);
+	printf("parse_bench: %d funcs, %zu tokens\n", funcs, tokens->size());
+	printf("    -p1  %8.1f ms\n", ms);
+
+	int fails = !serial;
+	for (int threads = 2; threads <= 8 && serial; threads *= 2) {
+		ParseNode *tree = parse_with(tokens, threads, &ms);
+		printf("    -p%-2d %8.1f ms\n", threads, ms);
+		fails += !bench_same_tree(serial, tree, "parallel parse");
+		CodeNode::DELETE(tree, true);
+	}
+	printf("parse_bench: %d failed checks\n", fails);
+
+	CodeNode::DELETE(serial, true);
+	TokenStream::DELETE(tokens);
+	lexer.dtor();
+	text.dtor();
+	return fails ? 1 : 0;
+}
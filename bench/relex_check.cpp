@@ -0,0 +1,89 @@
+// relex_check - applies random edits to a source and checks LexicalParser::relex()
+// against a full lex of the edited text, token by token
+// usage: relex_check <file.ctx | -gen FUNCS> [edits = 1000] [seed = 1]
+//
+// Edits replace up to 5 chars with up to 3 pieces of BENCH_PIECES, so they open
+// and close comments, split literals and operators and add newlines. The full
+// lex runs on a LexicalParser of its own every time: parse() keeps counting
+// lines where the last lex stopped. Prints the average time of both.
+
+#include "bench.h"
+
+int main(const int argc, const char **argv) {
+	if (argc < 2) {
+		printf("usage: relex_check <file.ctx | -gen FUNCS> [edits = 1000] [seed = 1]\n");
+		return 1;
+	}
+
+	BenchText text = {};
+	text.ctor();
+	int arg = 2;
+	if (!strcmp(argv[1], "-gen") && argc > 2) {
+		bench_gen_program(&text, atoi(argv[2]));
+		arg = 3;
+	} else if (!text.read(argv[1])) {
+		printf("relex_check: can't read [%s]\n", argv[1]);
+		return 1;
+	}
+
+	const int          edits = argc > arg     ? atoi(argv[arg]) : 1000;
+	unsigned long long rng   = argc > arg + 1 ? (unsigned long long) atoll(argv[arg + 1]) : 1;
+	rng = rng * 0x9E3779B97F4A7C15ull + 1;
+
+	LexicalParser lexer = {};
+	lexer.ctor();
+	TokenStream *stream = lexer.parse(text.data, text.length);
+
+	double relex_ms = 0;
+	double full_ms  = 0;
+	size_t relexed  = 0;
+	int    fails    = 0;
+
+	char piece[128] = {};
+	for (int e = 0; e < edits && !fails; ++e) {
+		size_t piece_len = 0;
+		for (size_t k = bench_below(&rng, 4); k > 0; --k) {
+			const char *next = BENCH_PIECES[bench_below(&rng, BENCH_PIECE_CNT)];
+			memcpy(piece + piece_len, next, strlen(next));
+			piece_len += strlen(next);
+		}
+
+		TextEdit edit = {};
+		edit.start      = bench_below(&rng, text.length + 1);
+		edit.old_length = bench_below(&rng, 4) ? bench_below(&rng, 6) : 0;
+		edit.new_length = piece_len;
+		if (edit.start + edit.old_length > text.length) {
+			edit.old_length = text.length - edit.start;
+		}
+		text.replace(edit.start, edit.old_length, piece, piece_len);
+
+		double start = bench_ms();
+		relexed  += lexer.relex(stream, text.data, text.length, edit);
+		relex_ms += bench_ms() - start;
+
+		LexicalParser full_lexer = {};
+		full_lexer.ctor();
+		start = bench_ms();
+		TokenStream *full = full_lexer.parse(text.data, text.length);
+		full_ms += bench_ms() - start;
+
+		if (!bench_same_tokens(full, stream, "relex")) {
+			printf("relex_check: edit %d at %zu replaced %zu chars with [%.*s]\n", e, edit.start, edit.old_length, (int) piece_len, piece);
+			++fails;
+		}
+
+		TokenStream::DELETE(full);
+		full_lexer.dtor();
+	}
+
+	printf("relex_check: %d edits on %zu chars, %d failed\n", edits, text.length, fails);
+	if (edits) {
+		printf("    relex %8.3f ms, %zu tokens lexed on average\n", relex_ms / edits, relexed / (size_t) edits);
+		printf("    full  %8.3f ms\n", full_ms / edits);
+	}
+
+	TokenStream::DELETE(stream);
+	lexer.dtor();
+	text.dtor();
+	return fails ? 1 : 0;
+}
@@ -1,5 +1,8 @@
 #include "code_node.h"
 
+Pool<CodeNode> CODE_NODE_POOL;
+thread_local Pool<CodeNode> *THREAD_NODE_POOL = &CODE_NODE_POOL;
+
 CodeNode::CodeNode():
 type(0),
 data(),
@@ -22,7 +25,7 @@ void CodeNode::ctor() {
 }
 
 CodeNode *CodeNode::NEW() {
-	CodeNode *cake = (CodeNode*) calloc(1, sizeof(CodeNode));
+	CodeNode *cake = THREAD_NODE_POOL->get();
 	if (!cake) {
 		return nullptr;
 	}
@@ -31,12 +34,15 @@ CodeNode *CodeNode::NEW() {
 	return cake;
 }
 
-void CodeNode::ctor(const char type_, const int op_or_var, CodeNode *L_, CodeNode *R_, const int line_, const int pos_) {
+void CodeNode::ctor(const char type_, const int op_var_id, CodeNode *L_, CodeNode *R_, const int line_, const int pos_) {
 	type = type_;
+	data.val = 0;
 	if (type == OPERATION) {
-		data.op = op_or_var;
+		data.op = op_var_id;
+	} else if (type == ID) {
+		data.id = op_var_id;
 	} else {
-		data.var = op_or_var;
+		data.var = op_var_id;
 	}
 	L = L_;
 	R = R_;
@@ -44,13 +50,13 @@ void CodeNode::ctor(const char type_, const int op_or_var, CodeNode *L_, CodeNod
 	pos  = pos_;
 }
 
-CodeNode *CodeNode::NEW(const char type_, const int op_or_var, CodeNode *L_, CodeNode *R_, const int line_, const int pos_) {
-	CodeNode *cake = (CodeNode*) calloc(1, sizeof(CodeNode));
+CodeNode *CodeNode::NEW(const char type_, const int op_var_id, CodeNode *L_, CodeNode *R_, const int line_, const int pos_) {
+	CodeNode *cake = THREAD_NODE_POOL->get();
 	if (!cake) {
 		return nullptr;
 	}
 
-	cake->ctor(type_, op_or_var, L_, R_, line_, pos_);
+	cake->ctor(type_, op_var_id, L_, R_, line_, pos_);
 	return cake;
 }
 
@@ -64,7 +70,7 @@ void CodeNode::ctor(const char type_, const double val_, CodeNode *L_, CodeNode
 }
 
 CodeNode *CodeNode::NEW(const char type_, const double val_, CodeNode *L_, CodeNode *R_, const int line_, const int pos_) {
-	CodeNode *cake = (CodeNode*) calloc(1, sizeof(CodeNode));
+	CodeNode *cake = THREAD_NODE_POOL->get();
 	if (!cake) {
 		return nullptr;
 	}
@@ -73,25 +79,6 @@ CodeNode *CodeNode::NEW(const char type_, const double val_, CodeNode *L_, CodeN
 	return cake;
 }
 
-void CodeNode::ctor(const char type_, StringView *id_, CodeNode *L_, CodeNode *R_, const int line_, const int pos_) {
-	type    = type_;
-	data.id = id_;
-	L       = L_;
-	R       = R_;
-	line    = line_;
-	pos     = pos_;
-}
-
-CodeNode *CodeNode::NEW(const char type_, StringView *id_, CodeNode *L_, CodeNode *R_, const int line_, const int pos_) {
-	CodeNode *cake = (CodeNode*) calloc(1, sizeof(CodeNode));
-	if (!cake) {
-		return nullptr;
-	}
-
-	cake->ctor(type_, id_, L_, R_, line_, pos_);
-	return cake;
-}
-
 void CodeNode::dtor() {
 	type     = NONE;
 	data.val = 0;
@@ -101,22 +88,33 @@ void CodeNode::dtor() {
 	pos      = 0;
 }
 
-void CodeNode::DELETE(CodeNode *node, bool recursive, bool to_delete_id) {
+void CodeNode::DELETE(CodeNode *node, bool recursive) {
 	if (!node) {
 		return;
 	}
 
-	if (recursive) {
-		if (node->L) DELETE(node->L, recursive, to_delete_id);
-		if (node->R) DELETE(node->R, recursive, to_delete_id);
+	if (!recursive) {
+		node->dtor();
+		THREAD_NODE_POOL->put(node);
+		return;
 	}
 
-	if (to_delete_id && node->type == ID) {
-		StringView::DELETE(node->data.id);
-	}
+	// a left child is rotated up over its parent until the parent has none, then
+	// the parent goes and its R is next: no stack at any depth
+	while (node) {
+		if (node->L) {
+			CodeNode *left = node->L;
+			node->L  = left->R;
+			left->R  = node;
+			node     = left;
+			continue;
+		}
 
-	node->dtor();
-	free(node);
+		CodeNode *next = node->R;
+		node->dtor();
+		THREAD_NODE_POOL->put(node);
+		node = next;
+	}
 }
 
 //=============================================================================
@@ -155,9 +153,9 @@ void CodeNode::set_val(const double val_) {
 	data.val = val_;
 }
 
-void CodeNode::set_id(StringView *id_) {
+void CodeNode::set_sym(const int sym_) {
 	set_type(ID);
-	data.id = id_;
+	data.id = sym_;
 }
 
 char CodeNode::get_type() const {
@@ -176,12 +174,16 @@ double CodeNode::get_val() const {
 	return data.val;
 }
 
-StringView *CodeNode::get_id() const {
+int CodeNode::get_sym() const {
 	return data.id;
 }
 
+const StringView *CodeNode::get_id() const {
+	return SYMBOL_POOL.get(data.id);
+}
+
 int CodeNode::get_var_from_id() const {
-	return (*data.id)[0];
+	return (*get_id())[0];
 }
 
 bool CodeNode::is_op() const {
@@ -230,7 +232,7 @@ void CodeNode::space_dump(FILE *file) const {
 	} else if (is_val()) {
 		fprintf(file, "%lg", data.val);
 	} else if (is_id()) {
-		data.id->print(file);
+		get_id()->print(file);
 	} else {
 		fprintf(file, ">ERR<");
 	}
@@ -262,7 +264,7 @@ void CodeNode::full_dump(FILE *file) const {
 	} else if (is_val()) {
 		fprintf(file, "%lg", data.val);
 	} else if (is_id()) {
-		data.id->print(file);
+		get_id()->print(file);
 	} else {
 		fprintf(file, "ERR");
 	}
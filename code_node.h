@@ -2,8 +2,10 @@
 #define CODENODE_H
 
 #include "general/cpp/stringview.hpp"
+#include "general/cpp/pool.hpp"
 #include "general/constants.h"
 #include "compiler_options.h"
+#include "symbol_pool.h"
 
 #include <cstdio>
 
@@ -22,7 +24,7 @@ union CodeNodeData {
 	int op;
 	int var;
 	double val;
-	StringView *id;
+	int id; // symbol from SYMBOL_POOL
 };
 
 struct CodeNode {
@@ -43,17 +45,15 @@ public:
 	~CodeNode();
 
 	void ctor();
-	void ctor(const char type_, const int op_or_var, CodeNode *L_, CodeNode *R_, const int line_, const int pos_);
+	void ctor(const char type_, const int op_var_id, CodeNode *L_, CodeNode *R_, const int line_, const int pos_);
 	void ctor(const char type_, const double val_,   CodeNode *L_, CodeNode *R_, const int line_, const int pos_);
-	void ctor(const char type_, StringView *id_,     CodeNode *L_, CodeNode *R_, const int line_, const int pos_);
 
 	static CodeNode *NEW();
-	static CodeNode *NEW(const char type_, const int op_or_var, CodeNode *L_, CodeNode *R_, const int line_, const int pos_);
+	static CodeNode *NEW(const char type_, const int op_var_id, CodeNode *L_, CodeNode *R_, const int line_, const int pos_);
 	static CodeNode *NEW(const char type_, const double val_,   CodeNode *L_, CodeNode *R_, const int line_, const int pos_);
-	static CodeNode *NEW(const char type_, StringView *id_,     CodeNode *L_, CodeNode *R_, const int line_, const int pos_);
 
 	void dtor();
-	static void DELETE(CodeNode *node, bool recursive = false, bool to_delete_id = false);
+	static void DELETE(CodeNode *node, bool recursive = false);
 
 //=============================================================================
 // Setters & Getters ==========================================================
@@ -67,14 +67,16 @@ public:
 	void set_op(const int op_);
 	void set_var(const int var_);
 	void set_val(const double val_);
-	void set_id(StringView *id_);
+	void set_sym(const int sym_);
 
 	char get_type  () const;
 	int  get_op    () const;
 	int  get_var   () const;
 	double get_val () const;
 
-	StringView *get_id  () const;
+	int  get_sym   () const;
+
+	const StringView *get_id() const;
 	int get_var_from_id () const;
 
 	bool is_op  () const;
@@ -90,4 +92,10 @@ public:
 	void gv_dump(FILE *file = nullptr, const char *name = (const char*) "code_tree") const;
 };
 
+// every node of the compilation comes from here, the whole tree goes at once with CODE_NODE_POOL.dtor()
+extern Pool<CodeNode> CODE_NODE_POOL;
+
+// the pool this thread's NEW and DELETE use, parser workers point it at their own one
+extern thread_local Pool<CodeNode> *THREAD_NODE_POOL;
+
 #endif // CODENODE_H
\ No newline at end of file
@@ -1,92 +1,45 @@
 #include "compiler.h"
 
-void Compiler::fprintf_asgn_additional_operation(FILE *file, const int op) {
+void Compiler::add_asgn_additional_operation(const int op) {
 	switch (op) {
 		case OPCODE_ASGN_ADD :
-			fprintf(file, "add\n");
+			ir.add(IR_ADD);
 			break;
 		case OPCODE_ASGN_SUB :
-			fprintf(file, "sub\n");
+			ir.add(IR_SUB);
 			break;
 		case OPCODE_ASGN_MUL :
-			fprintf(file, "mul\n");
+			ir.add(IR_MUL);
 			break;
 		case OPCODE_ASGN_DIV :
-			fprintf(file, "div\n");
+			ir.add(IR_DIV);
 			break;
 		case OPCODE_ASGN_POW :
-			fprintf(file, "pow\n");
+			ir.add(IR_POW);
 			break;
 		default:
 			RAISE_ERROR("bad asgn operation, HOW\n");
 	}
 }
 
-void Compiler::compile_operation(const CodeNode *node, FILE *file) {
+void Compiler::compile_operation(AstNode node) {
 	assert(node);
-	assert(file);
 
-	#define LOG_ERROR_LINE_POS(node) RAISE_ERROR("line [%d] | pos [%d]\n", node->line, node->pos);
+	#define LOG_ERROR_LINE_POS(node) RAISE_ERROR("line [%d] | pos [%d]\n", node->line(), node->pos());
 
-	#define DUMP_L() if (node->L) {printf("L] "); node->L->full_dump(); printf("\n");}
-	#define DUMP_R() if (node->R) {printf("R] "); node->R->full_dump(); printf("\n");}
-	#define COMPILE_L() if (node->L) compile(node->L, file)
-	#define COMPILE_R() if (node->R) compile(node->R, file)
-	#define COMPILE_L_COMMENT() if (node->L && (is_compiling_loggable_op(node->L->get_op()))) { fprintf(file, "\n; "); node->L->space_dump(file); fprintf(file, "\n");} COMPILE_L()
-	#define COMPILE_R_COMMENT() if (node->R && (is_compiling_loggable_op(node->R->get_op()))) { fprintf(file, "\n; "); node->R->space_dump(file); fprintf(file, "\n");} COMPILE_R()
+	#define DUMP_L() if (node->L()) {printf("L] "); node->L()->full_dump(); printf("\n");}
+	#define DUMP_R() if (node->R()) {printf("R] "); node->R()->full_dump(); printf("\n");}
+	#define COMPILE_L() if (node->L()) compile(node->L())
+	#define COMPILE_R() if (node->R()) compile(node->R())
+	#define COMPILE_L_COMMENT() if (node->L() && (is_compiling_loggable_op(node->L()->get_op()))) { ir.add_comment(node->L()); } COMPILE_L()
+	#define COMPILE_R_COMMENT() if (node->R() && (is_compiling_loggable_op(node->R()->get_op()))) { ir.add_comment(node->R()); } COMPILE_R()
 	#define COMPILE_LR() do {COMPILE_L(); COMPILE_R();} while (0)
 
-	#define CHECK_ERROR() do {if (ANNOUNCEMENT_ERROR) {return;}} while (0)
-
 	switch (node->get_op()) {
-		case '+' : {
-			if (node->L) {
-				COMPILE_LR();
-				fprintf(file, "add\n");
-			} else {
-				COMPILE_R();
-			}
-			break;
-		}
-
-		case '-' : {
-			if (node->L) {
-				COMPILE_LR();
-			} else {
-				fprintf(file, "push 0\n");
-				COMPILE_R();
-			}
-			fprintf(file, "sub\n");
-			break;
-		}
-
-		case '/' : {
-			COMPILE_LR();
-			fprintf(file, "div\n");
-			break;
-		}
-
-		case '*' : {
-			COMPILE_LR();
-			fprintf(file, "mul\n");
-			break;
-		}
-
-		case '^' : {
-			COMPILE_LR();
-			fprintf(file, "pow\n");
-			break;
-		}
-
 		case '=' : {
 			COMPILE_R();
-			fprintf(file, "pop ");
-			compile_lvalue(node->L, file);
-			fprintf(file, "\n");
-
-			fprintf(file, "push ");
-			compile_lvalue(node->L, file, true);
-			fprintf(file, "\n");
+			compile_lvalue(node->L(), IR_POP);
+			compile_lvalue(node->L(), IR_PUSH, true);
 
 			break;
 		}
@@ -95,78 +48,24 @@ void Compiler::compile_operation(const CodeNode *node, FILE *file) {
 		case OPCODE_ASGN_MUL :
 		case OPCODE_ASGN_DIV :
 		case OPCODE_ASGN_POW : {
-			fprintf(file, "push ");
-			compile_lvalue(node->L, file, false, true);
-			fprintf(file, "\n");
+			compile_lvalue(node->L(), IR_PUSH, false, true);
 
 			COMPILE_R();
-			fprintf_asgn_additional_operation(file, node->get_op());
+			add_asgn_additional_operation(node->get_op());
 
-			fprintf(file, "pop ");
-			compile_lvalue(node->L, file);
-			fprintf(file, "\n");
-
-			fprintf(file, "push ");
-			compile_lvalue(node->L, file, true);
-			fprintf(file, "\n");
-
-			break;
-		}
-
-		case '<' : {
-			COMPILE_LR();
-			fprintf(file, "lt\n");
-			break;
-		}
-
-		case '>' : {
-			COMPILE_LR();
-			fprintf(file, "gt\n");
-			break;
-		}
-
-		case OPCODE_LE  : {
-			COMPILE_LR();
-			fprintf(file, "le\n");
-			break;
-		}
-		case OPCODE_GE  : {
-			COMPILE_LR();
-			fprintf(file, "ge\n");
-			break;
-		}
-
-		case OPCODE_EQ  : {
-			COMPILE_LR();
-			fprintf(file, "eq\n");
-			break;
-		}
-
-		case OPCODE_NEQ : {
-			COMPILE_LR();
-			fprintf(file, "neq\n");
-			break;
-		}
-
-		case OPCODE_OR : {
-			COMPILE_LR();
-			fprintf(file, "l_or\n");
-			break;
-		}
+			compile_lvalue(node->L(), IR_POP);
+			compile_lvalue(node->L(), IR_PUSH, true);
 
-		case OPCODE_AND : {
-			COMPILE_LR();
-			fprintf(file, "l_and\n");
 			break;
 		}
 
 		case OPCODE_EXPR : {
-			compile_expr(node, file, true);
+			compile_expr(node, true);
 			break;
 		}
 
 		case OPCODE_VAR_DEF : {
-			if (!node->L || !node->L->is_id()) {
+			if (!node->L() || !node->L()->is_id()) {
 				RAISE_ERROR("bad variable definition [\n");
 				node->space_dump();
 				printf("]\n");
@@ -174,78 +73,38 @@ void Compiler::compile_operation(const CodeNode *node, FILE *file) {
 				break;
 			}
 
-			if (node->R) {
-				COMPILE_R();
+			if (node->L()->get_binding().kind == BOUND_CONST) { // its uses push the value, nothing is stored
+				break;
 			}
 
-			bool ret = id_table.declare_var(node->L->get_id(), 1);
-			if (!ret) {
-				RAISE_ERROR("Redefinition of the id [");
-				node->L->get_id()->print();
-				printf("]\n");
-				LOG_ERROR_LINE_POS(node);
-				break;
+			if (node->R()) {
+				COMPILE_R();
 			}
 
-			if (node->R) {
-				fprintf(file, "pop ");
-				compile_lvalue(node->L, file, false, false, true);
-				fprintf(file, "\n");
+			if (node->R()) {
+				compile_lvalue(node->L(), IR_POP, false, false, true);
 			}
 
 			break;
 		}
 
 		case OPCODE_ARR_DEF : {
-			CodeNode *arr_name = node->L->R;
-			if (!node->L || !node->L->is_op(OPCODE_ARR_INFO)) {
+			AstNode arr_name = node->L()->R();
+			if (!node->L() || !node->L()->is_op(OPCODE_ARR_INFO)) {
 				RAISE_ERROR("bad variable definition [\n");
 				node->space_dump();
 				printf("]\n");
 				LOG_ERROR_LINE_POS(node);
 				break;
 			}
-			
-			bool ret = id_table.declare_var(arr_name->get_id(), 1);
-			if (!ret) {
-				RAISE_ERROR("Redefinition of the id [");
-				arr_name->get_id()->print();
-				printf("]\n");
-				LOG_ERROR_LINE_POS(node);
-				break;
-			}
-			id_table.add_buffer_zone((int) node->L->L->get_val());
 
-			int offset = 0;
-			id_table.find_var(arr_name->get_id(), &offset);
-			fprintf(file, "push rvx + %d\n", offset);
-			//fprintf(file, "add\n");
-			// fprintf(file, "dup\n");
-			// fprintf(file, "out\n");
-			// fprintf(file, "out_n\n");
-			fprintf(file, "pop [rvx + %d]\n", offset);
+			const int offset = arr_name->get_binding().value;
+			ir.add(IR_PUSH, reg_plus(REG_RVX, offset));
+			ir.add(IR_POP,  mem_plus(REG_RVX, offset));
 
 			break;
 		}
 
-		case OPCODE_WHILE : {
-			int cur_while_cnt = ++while_cnt;
-
-			cycles_end_stack.push_back(Loop(LOOP_TYPE_WHILE, cur_while_cnt));
-			fprintf(file, "while_%d_cond:\n", cur_while_cnt);
-
-			COMPILE_L();
-			fprintf(file, "\npush 0\n");
-			fprintf(file, "je while_%d_end\n", cur_while_cnt);
-
-			COMPILE_R();
-			fprintf(file, "jmp while_%d_cond\n", cur_while_cnt);
-
-			fprintf(file, "\nwhile_%d_end:\n", cur_while_cnt);
-			cycles_end_stack.pop_back();
-			break;
-		}
-
 		case OPCODE_BREAK : {
 			if (!cycles_end_stack.size()) {
 				RAISE_ERROR("You can't use |< outside of the loop\n");
@@ -255,9 +114,9 @@ void Compiler::compile_operation(const CodeNode *node, FILE *file) {
 
 			Loop cur_cycle = cycles_end_stack[cycles_end_stack.size() - 1];
 			if (cur_cycle.type == LOOP_TYPE_WHILE) {
-				fprintf(file, "jmp while_%d_end\n", cur_cycle.number);
+				ir.add(IR_JMP, label(LABEL_WHILE_END, cur_cycle.number));
 			} else if (cur_cycle.type == LOOP_TYPE_FOR) {
-				fprintf(file, "jmp for_%d_end\n", cur_cycle.number);
+				ir.add(IR_JMP, label(LABEL_FOR_END, cur_cycle.number));
 			} else {
 				RAISE_ERROR("What cycle are you using??\n");
 				LOG_ERROR_LINE_POS(node);
@@ -276,9 +135,9 @@ void Compiler::compile_operation(const CodeNode *node, FILE *file) {
 
 			Loop cur_cycle = cycles_end_stack[cycles_end_stack.size() - 1];
 			if (cur_cycle.type == LOOP_TYPE_WHILE) {
-				fprintf(file, "jmp while_%d_cond\n", cur_cycle.number);
+				ir.add(IR_JMP, label(LABEL_WHILE_COND, cur_cycle.number));
 			} else if (cur_cycle.type == LOOP_TYPE_FOR) {
-				fprintf(file, "jmp for_%d_action\n", cur_cycle.number);
+				ir.add(IR_JMP, label(LABEL_FOR_ACTION, cur_cycle.number));
 			} else {
 				RAISE_ERROR("What cycle are you using??\n");
 				LOG_ERROR_LINE_POS(node);
@@ -288,292 +147,172 @@ void Compiler::compile_operation(const CodeNode *node, FILE *file) {
 			break;
 		}
 
-		case OPCODE_IF : {
-			int cur_if_cnt = ++if_cnt;
-			fprintf(file, "if_%d_cond:\n", cur_if_cnt);
-			COMPILE_L();
-			fprintf(file, "\npush 0\n");
-			fprintf(file, "jne if_%d_true\n", cur_if_cnt);
-			COMPILE_R();
-			fprintf(file, "\nif_%d_end:\n", cur_if_cnt);
-			break;
-		}
-
-		case OPCODE_FOR : {
-			int cur_for_cnt = ++for_cnt;
-			cycles_end_stack.push_back(Loop(LOOP_TYPE_FOR, cur_for_cnt));
-
-			if (!node->L || !node->R || !node->L->L || !node->L->R || !node->L->L->L || !node->L->L->R) {
-				RAISE_ERROR("bad for node, something is missing\n");
-				break;
-			}
-			
-			id_table.add_scope();
-			fprintf(file, "\nfor_%d_init_block:\n", cur_for_cnt);
-			compile(node->L->L->L, file);
-
-			fprintf(file, "\nfor_%d_start:\n", cur_for_cnt);
-			fprintf(file, "\nfor_%d_cond:\n", cur_for_cnt);
-			compile(node->L->L->R, file);
-			fprintf(file, "\npush 0\n");
-			fprintf(file, "je for_%d_end\n", cur_for_cnt);
-
-			compile(node->R, file);
-
-			fprintf(file, "for_%d_action:\n", cur_for_cnt);
-			compile_expr(node->L->R, file, true);
-			fprintf(file, "jmp for_%d_cond\n", cur_for_cnt);
-			
-			fprintf(file, "\nfor_%d_end:\n", cur_for_cnt);
-			cycles_end_stack.pop_back();
-			id_table.remove_scope();
-			break;
-		}
-
-		case OPCODE_COND_DEPENDENT : {
-			int cur_if_cnt = if_cnt;
-			fprintf(file, "if_%d_false:\n", cur_if_cnt);
-			COMPILE_L_COMMENT();
-			fprintf(file, "\njmp if_%d_end\n", cur_if_cnt);
-			fprintf(file, "\nif_%d_true:\n", cur_if_cnt);
-			COMPILE_R_COMMENT();
-			break;
-		}
-
 		case OPCODE_ELEM_EXIT : {
-			fprintf(file, "halt\n");
+			ir.add(IR_HALT);
 			break;
 		}
 
 		case OPCODE_ELEM_RANDOM : {
-			//fprintf(file, "push\n");
 			COMPILE_L();
 			COMPILE_R();
-			fprintf(file, "bin_op $\n");
+			ir.add(IR_BIN_OP, chr('$'));
 			break;
 		}
 
 		case OPCODE_ELEM_PUTN : {
-			if (node->R) {
+			if (node->R()) {
 				COMPILE_R();
-				fprintf(file, "dup\n");
-				fprintf(file, "out\n");
+				ir.add(IR_DUP);
+				ir.add(IR_OUT);
 			} else {
-				fprintf(file, "push %d\n", '\n');
-				fprintf(file, "dup\n");
-				fprintf(file, "out_c\n");
+				ir.add(IR_PUSH, imm('\n'));
+				ir.add(IR_DUP);
+				ir.add(IR_OUT_C);
 			}
 
 			break;
 		}
 
 		case OPCODE_ELEM_PUTC : {
-			if (node->R) {
+			if (node->R()) {
 				COMPILE_R();
 			} else {
-				fprintf(file, "push %d\n", ' ');
+				ir.add(IR_PUSH, imm(' '));
 			}
-			fprintf(file, "dup\n");
-			fprintf(file, "out_c\n");
+			ir.add(IR_DUP);
+			ir.add(IR_OUT_C);
 
 			break;
 		}
 
 		case OPCODE_ELEM_MALLOC : {
-			if (node->R) {
+			if (node->R()) {
 				COMPILE_R();
 			} else {
-				fprintf(file, "push rmx\n");
+				ir.add(IR_PUSH, reg(REG_RMX));
 				break;
 			}
 			
-			fprintf(file, "pop rax\n");
-			fprintf(file, "push rmx\n");
-			fprintf(file, "push rmx\n");
-			fprintf(file, "push rax\n");
-			fprintf(file, "add\n");
-			fprintf(file, "pop rmx\n");
+			ir.add(IR_POP,  reg(REG_RAX));
+			ir.add(IR_PUSH, reg(REG_RMX));
+			ir.add(IR_PUSH, reg(REG_RMX));
+			ir.add(IR_PUSH, reg(REG_RAX));
+			ir.add(IR_ADD);
+			ir.add(IR_POP,  reg(REG_RMX));
 
 			break;
 		}
 
 		case OPCODE_ELEM_INPUT : {
-			fprintf(file, "in\n");
+			ir.add(IR_IN);
 
 			break;
 		}
 
 		case OPCODE_ELEM_G_INIT : {
-			if (!node->R || !node->L) {
+			if (!node->R() || !node->L()) {
 				RAISE_ERROR("graphics initialization is invalid without paramets");
 				break;
 			}
 			
 			COMPILE_L();
-			fprintf(file, "dup\n");
-			fprintf(file, "pop rax\n");
+			ir.add(IR_DUP);
+			ir.add(IR_POP,  reg(REG_RAX));
 			COMPILE_R();
-			fprintf(file, "dup\n");
-			fprintf(file, "pop rbx\n");
-			fprintf(file, "g_init\n");
-			fprintf(file, "push rax\n");
-			fprintf(file, "push rbx\n");
-			fprintf(file, "mul\n");
+			ir.add(IR_DUP);
+			ir.add(IR_POP,  reg(REG_RBX));
+			ir.add(IR_G_INIT);
+			ir.add(IR_PUSH, reg(REG_RAX));
+			ir.add(IR_PUSH, reg(REG_RBX));
+			ir.add(IR_MUL);
 
 			break;
 		}
 
 		case OPCODE_ELEM_G_DRAW_TICK : {
-			fprintf(file, "g_draw\n");
-			fprintf(file, "push 0\n");
+			ir.add(IR_G_DRAW);
+			ir.add(IR_PUSH, imm(0));
 
 			break;
 		}
 
 		case OPCODE_ELEM_G_PUT_PIXEL : {
-			if (!node->R || !node->L) {
+			if (!node->R() || !node->L()) {
 				RAISE_ERROR("graphics pixel put is invalid without paramets");
 				break;
 			}
 			
 			COMPILE_L();
-			fprintf(file, "pop rax\n");
+			ir.add(IR_POP,  reg(REG_RAX));
 			COMPILE_R();
-			fprintf(file, "dup\n");
-			fprintf(file, "pop (rax)\n");
+			ir.add(IR_DUP);
+			ir.add(IR_POP,  pixel(REG_RAX));
 
 			break;
 		}
 
 		case OPCODE_ELEM_G_FILL : {
-			if (node->R) {
+			if (node->R()) {
 				COMPILE_R();
 			} else {
-				fprintf(file, "push 256\n");
+				ir.add(IR_PUSH, imm(256));
 				break;
 			}
 
-			fprintf(file, "dup\n");
-			fprintf(file, "g_fill\n");
+			ir.add(IR_DUP);
+			ir.add(IR_G_FILL);
 
 			break;
 		}
 
 		case OPCODE_RET : {
-			if (!node->R) {
-				fprintf(file, "push 0\n");
+			if (!node->R()) {
+				ir.add(IR_PUSH, imm(0));
 			} else {
 				COMPILE_R();
 			}
 
-			fprintf(file, "swp\n");
-			fprintf(file, "ret\n");
+			ir.add(IR_SWP);
+			ir.add(IR_RET);
 
 			break;
 		}
 
-		case OPCODE_FUNC_DECL : {
-			if (!node->L) {
-				RAISE_ERROR("bad func decl node, func info node id is absent\n");
-				LOG_ERROR_LINE_POS(node);
-				break;
-			}
-
-			if (!node->L->R) {
-				RAISE_ERROR("bad func info node, func id id is absent\n");
-				LOG_ERROR_LINE_POS(node);
-				break;
-			}
-
-			StringView *id = node->L->R->get_id();
-			if (id_table.find_in_upper_scope(ID_TYPE_FUNC, id) != NOT_FOUND) {
-				RAISE_ERROR("Redifenition of function [");
-				id->print();
-				printf("]\n");
-				LOG_ERROR_LINE_POS(node);
-			}
-
-			id_table.declare_func(id, node->L->L, id_table.size());
-			int offset = id_table.find_func(id);
-
-			fprintf(file, "jmp _func_");
-			id->print(file);
-			fprintf(file, "_%d_END\n", offset);
-			fprintf(file, "_func_");
-			id->print(file);
-			fprintf(file, "_%d_BEGIN:\n", offset);
-
-			id_table.add_scope(FUNC_SCOPE);
-			COMPILE_L();
-			COMPILE_R();
-			id_table.remove_scope();
-			fprintf(file, "push 0\n");
-			fprintf(file, "swp\n");
-			fprintf(file, "ret\n");
-			fprintf(file, "_func_");
-			id->print(file);
-			fprintf(file, "_%d_END:\n", offset);
-			break;
-		}
-
 		case OPCODE_FUNC_INFO : {
 			COMPILE_L();
 
-			node->R->get_id()->print(file);
-			fprintf(file, "_%d:\n", id_table.find_func(node->R->get_id()));
+			ir.add_label(label(LABEL_FUNC, node->R()->get_binding().value, node->R()->get_sym()));
 			break;
 		}
 
 		case OPCODE_FUNC_ARG_DECL : {
-			if (!node->L) {
-				if (node->R) {
+			if (!node->L()) {
+				if (node->R()) {
 					RAISE_ERROR("bad argument node, arg is absent\n");
 					LOG_ERROR_LINE_POS(node);
 				}
 				break;
 			}
 
-			if (node->L->is_op(OPCODE_VAR_DEF)) {
-				if (!node->L->L) {
-					RAISE_ERROR("bad argument node, name of arg is absent\n");
-					LOG_ERROR_LINE_POS(node);
-					break;
-				}
-
-				id_table.declare_var(node->L->L->get_id(), 1);
-			} else if (node->L->is_id()) {
-				id_table.declare_var(node->L->get_id(), 1);
-			} 
+			if (node->L()->is_op(OPCODE_VAR_DEF) && !node->L()->L()) {
+				RAISE_ERROR("bad argument node, name of arg is absent\n");
+				LOG_ERROR_LINE_POS(node);
+				break;
+			}
 
 			COMPILE_R();
 			break;
 		}
 
 		case OPCODE_FUNC_CALL : {
-			if (id_table.find_func(node->R->get_id()) == NOT_FOUND) {
-				compile_arr_call(node, file);
+			if (node->R()->get_binding().kind != BOUND_FUNC) {
+				compile_arr_call(node);
 			} else {
-				compile_func_call(node, file);
+				compile_func_call(node);
 			}
 			break;
 		}
 
-		case '{' : {
-			id_table.add_scope();
-			COMPILE_L_COMMENT();
-			id_table.remove_scope();
-			COMPILE_R_COMMENT();
-
-			break;
-		}
-
-		case ';' : {
-			COMPILE_L_COMMENT();
-			COMPILE_R_COMMENT();
-
-			break;
-		}
-
 		default : {
 			RAISE_ERROR("bad operation: [");
 			node->space_dump();
@@ -584,228 +323,89 @@ void Compiler::compile_operation(const CodeNode *node, FILE *file) {
 	}
 }
 
-void Compiler::compile_expr(const CodeNode *node, FILE *file, const bool to_pop) {
+void Compiler::compile_expr(AstNode node, const bool to_pop) {
 	if (node->is_op(OPCODE_EXPR)) {
 		COMPILE_L();
 	} else {
-		compile(node, file);
+		compile(node);
 	}
 
 	if (to_pop) {
-		fprintf(file, "pop rzx\n");
+		ir.add(IR_POP,  reg(REG_RZX));
 	}
 }
 
-void Compiler::compile_func_call(const CodeNode *node, FILE *file) {
+// compile() jumps to target there if node is jump_if (nonzero for true) and
+// falls through if not
+void Compiler::push_cond(AstNode node, const Operand &target, const bool jump_if) {
+	compile_stack.push_back({node, COMPILE_COND, 0, target, jump_if});
+}
+
+void Compiler::compile_func_call(AstNode node) {
 	assert(node);
-	assert(file);
 
-	if (false && !node->L) {
+	if (false && !node->L()) {
 		RAISE_ERROR("bad func call, arglist is absent\n");
 		LOG_ERROR_LINE_POS(node);
 		return;
 	}
 
-	const StringView *id = nullptr;
-	if (!node->R) {
+	int sym = NO_SYMBOL;
+	if (!node->R()) {
 		if (node->is_id()) {
-			id = node->get_id();
+			sym = node->get_sym();
 		} else {
 			RAISE_ERROR("bad func call, func name is absent\n");
 			LOG_ERROR_LINE_POS(node);
 			return;
 		}
 	} else {
-		if (!node->R->is_id()) {
+		if (!node->R()->is_id()) {
 			RAISE_ERROR("bad func call, func name is not a name lol\n");
 			LOG_ERROR_LINE_POS(node);
 			return;
 		}
-		id = node->R->get_id();
-	}
-
-	const CodeNode *arglist = node->L;
-
-	int func_offset = 0;
-	if ((func_offset = id_table.find_func(id)) == NOT_FOUND) {
-		RAISE_ERROR("bad func call, func not declared [");
-		id->print();
-		printf("]\n");
-		LOG_ERROR_LINE_POS(node);
-		return;
-	}
-
-	const CodeNode *func_arglist = id_table.get_arglist(id);
-	if (!func_arglist) {
-		RAISE_ERROR("bad func call, declared func arglist is absent\n");
-		LOG_ERROR_LINE_POS(node);
-		return;
+		sym = node->R()->get_sym();
 	}
 
-	//=====================================================================
-	// here we definetly will compile a function
+	// the Resolver has bound the call: label, frame and what goes to each arg slot
+	const AstCall &call = node->get_call();
 
-	id_table.add_scope(ARG_SCOPE);
+	for (int i = call.first_param; i != NO_PARAM; i = ast.get_param(i).next) {
+		const AstParam &param = ast.get_param(i);
 
-	while (arglist && func_arglist && arglist->L && func_arglist->L) {
-		const CodeNode *arg  = arglist->L;
-		const CodeNode *prot = func_arglist->L;
-
-		if (arg->is_op(OPCODE_DEFAULT_ARG)) {
-			compile_default_arg(arg, prot, file);
-		} else if (arg->is_op(OPCODE_CONTEXT_ARG)) {
-			compile_context_arg(arg, prot, file);
-		} else if (arg->is_op(OPCODE_EXPR)) {
-			compile_expr_arg(arg, prot, file);
+		if (param.source) {
+			compile(param.source);
+		} else {
+			compile_binding(IR_PUSH, param.source_name);
 		}
 
-		arglist = arglist->R;
-		func_arglist = func_arglist->R;
-		CHECK_ERROR();
-	}
-
-	while (func_arglist && func_arglist->L) {
-		compile_default_arg(node, func_arglist->L, file);
-		func_arglist = func_arglist->R;
-		CHECK_ERROR();
+		compile_binding(IR_POP, param.target);
 	}
 
-	id_table.remove_scope();
-
-	fprintf(file, "push rvx\n");
-	fprintf(file, "push %d\n", id_table.get_func_offset());
-	fprintf(file, "add\n");
-	fprintf(file, "pop rvx\n");
+	ir.add(IR_PUSH, reg(REG_RVX));
+	ir.add(IR_PUSH, imm(call.frame));
+	ir.add(IR_ADD);
+	ir.add(IR_POP,  reg(REG_RVX));
 
-	fprintf(file, "call ");
-	id->print(file);
-	fprintf(file, "_%d\n", func_offset);
+	ir.add(IR_CALL, label(LABEL_FUNC, call.label, sym));
 
-	fprintf(file, "push rvx\n");
-	fprintf(file, "push %d\n", id_table.get_func_offset());
-	fprintf(file, "sub\n");
-	fprintf(file, "pop rvx\n");
+	ir.add(IR_PUSH, reg(REG_RVX));
+	ir.add(IR_PUSH, imm(call.frame));
+	ir.add(IR_SUB);
+	ir.add(IR_POP,  reg(REG_RVX));
 }
 
-void Compiler::compile_default_arg(const CodeNode *arg, const CodeNode *prot, FILE *file) {
-	if (prot->is_id()) {
-		id_table.shift_backward();
-		bool ret = compile_push(prot, file);
-		id_table.shift_forward();
-
-		if (!ret) {
-			RAISE_ERROR("func call arg position:\n");
-			LOG_ERROR_LINE_POS(arg);
-			return;
-		}
-
-		id_table.declare_var(prot->get_id(), 1);
-		fprintf(file, "pop ");
-		compile_lvalue(prot, file, false, false, true);
-		fprintf(file, "\n");
-	} else if (prot->is_op(OPCODE_VAR_DEF)) {
-		if (!prot->R) {
-			RAISE_ERROR("bad func call, required arg [");
-			prot->L->get_id()->print();
-			printf("] has no default set\n");
-			LOG_ERROR_LINE_POS(arg);
-			return;
-		}
-
-		id_table.shift_backward();
-		compile(prot->R, file);
-		id_table.shift_forward();
-
-		id_table.declare_var(prot->L->get_id(), 1);
-		fprintf(file, "pop ");
-		compile_lvalue(prot->L, file, false, false, true);
-		fprintf(file, "\n");
-	} else {
-		RAISE_ERROR("bad func call, unexpected PROT type [");
-		printf("%d]\n", prot->get_op());
-		LOG_ERROR_LINE_POS(prot);
-		return;
-	}
-}
-
-void Compiler::compile_context_arg(const CodeNode *arg, const CodeNode *prot, FILE *file) {
-	if (prot->is_id()) {
-		id_table.shift_backward();
-		bool ret = compile_push(prot, file);
-		id_table.shift_forward();
-
-		if (!ret) {
-			RAISE_ERROR("func call arg position:\n");
-			LOG_ERROR_LINE_POS(arg);
-			return;
-		}
-
-		id_table.declare_var(prot->get_id(), 1);
-		fprintf(file, "pop ");
-		compile_lvalue(prot, file, false, false, true);
-		fprintf(file, "\n");
-	} else if (prot->is_op(OPCODE_VAR_DEF)) {
-		id_table.shift_backward();
-		bool ret = compile_push(prot->L, file);
-		id_table.shift_forward();
-
-		if (!ret) {
-			RAISE_ERROR("func call arg position:\n");
-			LOG_ERROR_LINE_POS(arg);
-			return;
-		}
-
-		id_table.declare_var(prot->L->get_id(), 1);
-		fprintf(file, "pop ");
-		compile_lvalue(prot->L, file, false, false, true);
-		fprintf(file, "\n");
-	} else {
-		RAISE_ERROR("bad func call, unexpected PROT type [");
-		printf("%d]\n", prot->get_op());
-		LOG_ERROR_LINE_POS(arg);
-		return;
-	}
-}
-
-void Compiler::compile_expr_arg(const CodeNode *arg, const CodeNode *prot, FILE *file) {
-	if (!arg->L) {
-		RAISE_ERROR("bad func call, expr node has no expression inside\n");
-		LOG_ERROR_LINE_POS(arg);
-		return;
-	}
-	CodeNode *expr = arg->L;
-	id_table.shift_backward();
-	compile(expr, file);
-	id_table.shift_forward();
-
-	if (prot->is_id()) {
-		id_table.declare_var(prot->get_id(), 1);
-		fprintf(file, "pop ");
-		compile_lvalue(prot, file, false, false, true);
-		fprintf(file, "\n");
-	} else if (prot->is_op(OPCODE_VAR_DEF)) {
-		id_table.declare_var(prot->L->get_id(), 1);
-		fprintf(file, "pop ");
-		compile_lvalue(prot->L, file, false, false, true);
-		fprintf(file, "\n");
-	} else {
-		RAISE_ERROR("bad func call, unexpected PROT type [");
-		printf("%d]\n", prot->get_op());
-		LOG_ERROR_LINE_POS(arg);
-		return;
-	}
-}
-
-void Compiler::compile_arr_call(const CodeNode *node, FILE *file) {
-	if (!node->R) {
+void Compiler::compile_arr_call(AstNode node) {
+	if (!node->R()) {
 		RAISE_ERROR("bad arr call, where is name, you are worthless [");
 		printf("%d]\n", node->get_op());
 		LOG_ERROR_LINE_POS(node);
 		return;
 	}
 
-	CodeNode *id = node->R;
-	CodeNode *args = node->L;
+	AstNode id = node->R();
+	AstNode args = node->L();
 	// if (!arg->is_op(OPCODE_EXPR)) {
 	// 	RAISE_ERROR("bad arr call, argument is not an expr [");
 	// 	printf("%d]\n", node->get_op());
@@ -813,68 +413,91 @@ void Compiler::compile_arr_call(const CodeNode *node, FILE *file) {
 	// 	return;
 	// }
 
-	int offset = 0;
-	int ret = id_table.find_var(id->get_id(), &offset);
-	if (ret == NOT_FOUND) {
-		RAISE_ERROR("variable does not exist [");
-		id->get_id()->print();
-		printf("]\n");
-		LOG_ERROR_LINE_POS(node);
-		return;
+	if (id->get_binding().kind == BOUND_CONST) {
+		compile_binding(IR_PUSH, id->get_binding());
+	} else {
+		ir.add(IR_PUSH, mem_plus(REG_RVX, id->get_binding().value));
+	}
+
+	while (args && args->L()) {
+		AstNode arg = args->L();
+
+		int index = 0;
+		if (const_index(arg, &index)) {
+			ir.add(IR_POP,  reg(REG_RAX));
+			ir.add(IR_PUSH, mem_plus(REG_RAX, 1 + index));
+		} else {
+			compile_expr(arg);
+			ir.add(IR_ADD);
+			ir.add(IR_POP,  reg(REG_RAX));
+			ir.add(IR_PUSH, mem_plus(REG_RAX, 1));
+		}
+		args = args->R();
+	}
+}
+
+// from -O1 on an index that is a value or a constant is added at compile time
+bool Compiler::const_index(AstNode arg, int *index) const {
+	if (opt_level < 1) {
+		return false;
 	}
 
-	fprintf(file, "push [rvx + %d]\n", offset);
+	if (arg->is_op(OPCODE_EXPR)) {
+		arg = arg->L();
+	}
+	if (arg && arg->is_id() && arg->get_binding().kind == BOUND_CONST) {
+		arg = AstNode(&ast, arg->get_binding().value);
+	}
+	if (!arg || !arg->is_val()) {
+		return false;
+	}
 
-	while (args && args->L) {
-		CodeNode *arg = args->L;
-		compile_expr(arg, file);
-		fprintf(file, "add\n");
-		fprintf(file, "pop rax\n");
-		fprintf(file, "push [rax + 1]\n");
-		args = args->R;
+	const double value = arg->get_val();
+	if (!(value >= 0 && value <= COMPILER_MAX_CONST_INDEX) || value != floor(value)) {
+		return false;
 	}
+
+	*index = (int) value;
+	return true;
 }
 
-bool Compiler::compile_push(const CodeNode *node, FILE *file) {
+bool Compiler::compile_push(AstNode node) {
 	assert(node);
-	assert(file);
 
-	fprintf(file, "push ");
 	bool result = false;
-	if (node->type == VALUE) {
+	if (node->get_type() == VALUE) {
 		if (node->get_val() < 0) {
-			fprintf(file, "0\npush ");
-			
-			CodeNode tmp = {};
-			tmp.ctor(VALUE, fabs(node->get_val()), nullptr, nullptr, node->line, node->pos);
-			compile_value(&tmp, file);
-			tmp.dtor();
-
-			fprintf(file, "\nsub\n");
+			ir.add(IR_PUSH, imm(0));
+			ir.add(IR_PUSH, number(fabs(node->get_val())));
+			ir.add(IR_SUB);
+			ir.add_blank();
 		} else {
-			result = compile_value(node, file);
+			result = compile_value(node);
 		}
-	} else if (node->type == ID) {
-		result = compile_lvalue(node, file, false, false, true);
+	} else if (node->get_type() == ID) {
+		result = compile_lvalue(node, IR_PUSH, false, false, true);
 	}
-	fprintf(file, "\n");
 	return result;
 }
 
-bool Compiler::compile_value(const CodeNode *node, FILE *file) {
+bool Compiler::compile_value(AstNode node) {
 	assert(node);
-	assert(file);
 
-	fprintf(file, "%.7lg", node->get_val());
+	ir.add(IR_PUSH, number(node->get_val()));
 	return true;
 }
 
-bool Compiler::compile_lvalue(const CodeNode *node, FILE *file, 
+// from -O1 on a value keeps all its digits, folded ones have more than 7
+Operand Compiler::number(const double value) const {
+	return opt_level >= 1 ? num_exact(value) : num(value);
+}
+
+bool Compiler::compile_lvalue(AstNode node, 
+					const int  op,
 					const bool for_asgn_dup, 
 					const bool to_push, 
 					const bool initialization) {
 	assert(node);
-	assert(file);
 
 	if (node->is_id()) {
 		if (!initialization && node->get_id()->starts_with("_") && !node->get_id()->starts_with("_)")) {
@@ -883,39 +506,11 @@ bool Compiler::compile_lvalue(const CodeNode *node, FILE *file,
 			printf("]\n");
 			LOG_ERROR_LINE_POS(node);
 		}
-		// printf("\n\n==================\n");
-		// printf("compile var |");
-		// node->get_id()->print();
-		// printf("|\n");
-		// printf("~~~~~~~~~~~~~~~~~~\n");
-		// printf("cur id_table:\n");
-		// id_table.dump();
-
-		int offset = 0;
-		int is_found = id_table.find_var(node->get_id(), &offset);
-
-		// printf("\nfound = %d", offset);
-		// printf("\n==================\n");
-
-
-
-		if (is_found == NOT_FOUND) {
-			RAISE_ERROR("variable does not exist [");
-			node->get_id()->print();
-			printf("]\n");
-			LOG_ERROR_LINE_POS(node);
-			return false;
-		}
 
-		if (is_found == ID_TYPE_GLOBAL) {
-			fprintf(file, "[%d]\n", GLOBAL_VARS_OFFSET + offset);
-		} else {
-			fprintf(file, "[rvx + %d]", offset);
-		}
-		return true;
-	} else if (node->is_op(OPCODE_FUNC_CALL) && id_table.find_func(node->R->get_id()) == NOT_FOUND) { // so that's an array
-		CodeNode *id  = node->R;
-		CodeNode *args = node->L;
+		return compile_binding(op, node->get_binding());
+	} else if (node->is_op(OPCODE_FUNC_CALL) && node->R()->get_binding().kind != BOUND_FUNC) { // so that's an array
+		AstNode id  = node->R();
+		AstNode args = node->L();
 
 		if (!initialization && id->get_id()->starts_with("_") && !id->get_id()->starts_with("_)")) {
 			RAISE_ERROR("_varname is a constant, dont change it please: [");
@@ -924,57 +519,58 @@ bool Compiler::compile_lvalue(const CodeNode *node, FILE *file,
 			LOG_ERROR_LINE_POS(node);
 		}
 
-		int offset = 0;
-		int ret = id_table.find_var(id->get_id(), &offset);
-		if (ret == NOT_FOUND) {
-			RAISE_ERROR("variable does not exist [");
-			id->get_id()->print();
-			printf("]\n");
-			LOG_ERROR_LINE_POS(node);
-			return false;
-		}
+		const int offset = id->get_binding().value;
 
-		// we are called by assign, so there's 'pop ' already written in assembler, let's fix it
+		// the assign has left the element's address in rcx
 		if (for_asgn_dup) {
-			fprintf(file, "[rcx]\n");
-			//fprintf(file, "pop rzx\n");
-			// fprintf(file, "push [rax + %d + 1]\n", offset);
+			ir.add(op, mem(REG_RCX));
+			ir.add_blank();
 			return true;
 		}
 
 		if (to_push) {
-			fprintf(file, "0\n");
-			fprintf(file, "pop rzx\n");
+			ir.add(op, imm(0));
+			ir.add(IR_POP,  reg(REG_RZX));
 		} else {
-			fprintf(file, "rbx\n");
-			fprintf(file, "push rbx\n");
+			ir.add(op, reg(REG_RBX));
+			ir.add(IR_PUSH, reg(REG_RBX));
 		}
 
-		fprintf(file, "push rvx + %d\n", offset);
-		fprintf(file, "pop rax\n");
-		while (args && args->L) {
-			fprintf(file, "push [rax]\n");
-			CodeNode *arg = args->L;
-			compile_expr(arg, file);
+		ir.add(IR_PUSH, reg_plus(REG_RVX, offset));
+		ir.add(IR_POP,  reg(REG_RAX));
+		while (args && args->L()) {
+			ir.add(IR_PUSH, mem(REG_RAX));
+			AstNode arg = args->L();
+
+			int index = 0;
+			if (const_index(arg, &index)) {
+				ir.add(IR_PUSH, imm(index + 1));
+				ir.add(IR_ADD);
+				ir.add(IR_POP,  reg(REG_RAX));
+				args = args->R();
+				continue;
+			}
+
+			compile_expr(arg);
 			// TODO wtf is this... it works... so let it be... for 2d arrs... but not anyhow more...
-			//if (args->R->L) {
-				fprintf(file, "push 1\n");
-				fprintf(file, "add\n");
+			//if (args->R()->L()) {
+				ir.add(IR_PUSH, imm(1));
+				ir.add(IR_ADD);
 			//}
 			// -------------------------------------------------------------------------------------
-			fprintf(file, "add\n");
-			fprintf(file, "pop rax\n");
-			//fprintf(file, "push [rax]\n");
-			args = args->R;
+			ir.add(IR_ADD);
+			ir.add(IR_POP,  reg(REG_RAX));
+			args = args->R();
 		};
 
-		fprintf(file, "push rax\n");
-		fprintf(file, "pop rcx\n");
+		ir.add(IR_PUSH, reg(REG_RAX));
+		ir.add(IR_POP,  reg(REG_RCX));
 		if (to_push) {
-			fprintf(file, "push [rax]\n");
+			ir.add(IR_PUSH, mem(REG_RAX));
 		} else {
-			fprintf(file, "pop [rax]\n");
+			ir.add(IR_POP,  mem(REG_RAX));
 		}
+		ir.add_blank();
 		return true;
 	} else {
 		RAISE_ERROR("bad compiling type, node is [%d]\n", node->get_type());
@@ -983,43 +579,334 @@ bool Compiler::compile_lvalue(const CodeNode *node, FILE *file,
 	}
 }
 
-void Compiler::compile_id(const CodeNode *node, FILE *file) {
-	assert(node);
-	assert(file);
+bool Compiler::compile_binding(const int op, const AstBinding &binding) {
+	if (binding.kind == BOUND_GLOBAL) {
+		ir.add(op, mem_abs(GLOBAL_VARS_OFFSET + binding.value));
+		ir.add_blank();
+	} else if (binding.kind == BOUND_LOCAL) {
+		ir.add(op, mem_plus(REG_RVX, binding.value));
+	} else if (binding.kind == BOUND_CONST && op == IR_PUSH) {
+		return compile_push(AstNode(&ast, binding.value));
+	} else {
+		return false;
+	}
 
-	fprintf(file, "[%d]", node->get_var_from_id());
+	return true;
 }
 
-void Compiler::compile(const CodeNode *node, FILE *file) {
+// Statements with a body nest as deep as the source does too: compile_body()
+// emits what comes before the body, pushes the rest and the body itself on
+// compile_stack. False if node is not such a statement.
+bool Compiler::compile_body(const CompileFrame &frame) {
+	AstNode node = frame.node;
+
+	#define PUSH_BODY(body) if (body) compile_stack.push_back({body, 0, 0, {}, false})
+	#define PUSH_STAGE(stage, number) compile_stack.push_back({node, stage, number, {}, false})
+
+	switch (node->get_op()) {
+		case OPCODE_IF : {
+			if (frame.stage == 0) {
+				int cur_if_cnt = ++if_cnt;
+				ir.add_label(label(LABEL_IF_COND, cur_if_cnt));
+				PUSH_STAGE(1, cur_if_cnt);
+				PUSH_BODY(node->R());
+				push_cond(node->L(), label(LABEL_IF_TRUE, cur_if_cnt), true);
+			} else {
+				ir.add_blank();
+				ir.add_label(label(LABEL_IF_END, frame.number));
+			}
+			break;
+		}
+
+		case OPCODE_COND_DEPENDENT : {
+			if (frame.stage == 0) {
+				int cur_if_cnt = if_cnt;
+				ir.add_label(label(LABEL_IF_FALSE, cur_if_cnt));
+				if (node->L() && is_compiling_loggable_op(node->L()->get_op())) {
+					ir.add_comment(node->L());
+				}
+				PUSH_STAGE(1, cur_if_cnt);
+				PUSH_BODY(node->L());
+			} else {
+				ir.add_blank();
+				ir.add(IR_JMP, label(LABEL_IF_END, frame.number));
+				ir.add_blank();
+				ir.add_label(label(LABEL_IF_TRUE, frame.number));
+				if (node->R() && is_compiling_loggable_op(node->R()->get_op())) {
+					ir.add_comment(node->R());
+				}
+				PUSH_BODY(node->R());
+			}
+			break;
+		}
+
+		case OPCODE_WHILE : {
+			if (frame.stage == 0) {
+				int cur_while_cnt = ++while_cnt;
+
+				cycles_end_stack.push_back(Loop(LOOP_TYPE_WHILE, cur_while_cnt));
+				ir.add_label(label(LABEL_WHILE_COND, cur_while_cnt));
+
+				PUSH_STAGE(1, cur_while_cnt);
+				PUSH_BODY(node->R());
+				push_cond(node->L(), label(LABEL_WHILE_END, cur_while_cnt), false);
+			} else {
+				ir.add(IR_JMP, label(LABEL_WHILE_COND, frame.number));
+
+				ir.add_blank();
+				ir.add_label(label(LABEL_WHILE_END, frame.number));
+				cycles_end_stack.pop_back();
+			}
+			break;
+		}
+
+		case OPCODE_FOR : {
+			if (frame.stage == 0) {
+				int cur_for_cnt = ++for_cnt;
+				cycles_end_stack.push_back(Loop(LOOP_TYPE_FOR, cur_for_cnt));
+
+				if (!node->L() || !node->R() || !node->L()->L() || !node->L()->R() || !node->L()->L()->L() || !node->L()->L()->R()) {
+					RAISE_ERROR("bad for node, something is missing\n");
+					break;
+				}
+
+				ir.add_blank();
+				ir.add_label(label(LABEL_FOR_INIT_BLOCK, cur_for_cnt));
+				compile(node->L()->L()->L());
+
+				ir.add_blank();
+				ir.add_label(label(LABEL_FOR_START, cur_for_cnt));
+				ir.add_blank();
+				ir.add_label(label(LABEL_FOR_COND, cur_for_cnt));
+				PUSH_STAGE(1, cur_for_cnt);
+				PUSH_BODY(node->R());
+				push_cond(node->L()->L()->R(), label(LABEL_FOR_END, cur_for_cnt), false);
+			} else {
+				ir.add_label(label(LABEL_FOR_ACTION, frame.number));
+				compile_expr(node->L()->R(), true);
+				ir.add(IR_JMP, label(LABEL_FOR_COND, frame.number));
+
+				ir.add_blank();
+				ir.add_label(label(LABEL_FOR_END, frame.number));
+				cycles_end_stack.pop_back();
+			}
+			break;
+		}
+
+		case OPCODE_FUNC_DECL : {
+			if (!node->L()) {
+				RAISE_ERROR("bad func decl node, func info node id is absent\n");
+				LOG_ERROR_LINE_POS(node);
+				break;
+			}
+
+			if (!node->L()->R()) {
+				RAISE_ERROR("bad func info node, func id id is absent\n");
+				LOG_ERROR_LINE_POS(node);
+				break;
+			}
+
+			const int sym    = node->L()->R()->get_sym();
+			const int offset = node->L()->R()->get_binding().value;
+
+			if (frame.stage == 0) {
+				ir.add(IR_JMP, label(LABEL_FUNC_END, offset, sym));
+				ir.add_label(label(LABEL_FUNC_BEGIN, offset, sym));
+
+				PUSH_STAGE(1, 0);
+				PUSH_BODY(node->R());
+				PUSH_BODY(node->L());
+			} else {
+				ir.add(IR_PUSH, imm(0));
+				ir.add(IR_SWP);
+				ir.add(IR_RET);
+				ir.add_label(label(LABEL_FUNC_END, offset, sym));
+			}
+			break;
+		}
+
+		default : {
+			return false;
+		}
+	}
+
+	#undef PUSH_BODY
+	#undef PUSH_STAGE
+
+	return true;
+}
+
+// Conditions and && / || values nest as deep as the source does as well, so
+// they are frames on compile_stack too. A cond frame of a chain of && or ||
+// jumps out at the first operand that decides it, so the rest are not
+// evaluated; anything else is evaluated and compared with 0. An && / || value
+// is its chain as a cond, then 0 or 1. False if frame is neither.
+bool Compiler::compile_logic(const CompileFrame &frame) {
+	AstNode node = frame.node;
+
+	switch (frame.stage) {
+		case COMPILE_COND_JUMP : {
+			ir.add_blank();
+			ir.add(IR_PUSH, imm(0));
+			ir.add(frame.jump_if ? IR_JNE : IR_JE, frame.target);
+			return true;
+		}
+
+		case COMPILE_LABEL : {
+			ir.add_label(frame.target);
+			return true;
+		}
+
+		case COMPILE_COND : {
+			const int op = node && node->is_op() ? node->get_op() : 0;
+			if ((op != OPCODE_AND && op != OPCODE_OR) || !node->L() || !node->R()) {
+				compile_stack.push_back({node, COMPILE_COND_JUMP, 0, frame.target, frame.jump_if});
+				if (node) {
+					compile_stack.push_back({node, 0, 0, {}, false});
+				}
+				return true;
+			}
+
+			// && is decided by a false operand, || by a true one: that goes to target
+			// if it is what jump_if wants, past the chain if not
+			const bool    decided_by = op == OPCODE_OR;
+			const Operand decided    = decided_by == frame.jump_if ? frame.target : label(LABEL_LOGIC_SKIP, ++logic_cnt);
+			if (decided_by != frame.jump_if) {
+				compile_stack.push_back({node, COMPILE_LABEL, 0, decided, false});
+			}
+
+			// a && b && c nests to the left as deep as the chain is long, its L spine
+			// has the operands last to first: the last one goes to target
+			push_cond(node->R(), frame.target, frame.jump_if);
+			for (node = node->L(); node->is_op(op) && node->L() && node->R(); node = node->L()) {
+				push_cond(node->R(), decided, decided_by);
+			}
+			push_cond(node, decided, decided_by);
+			return true;
+		}
+
+		default : {
+			break;
+		}
+	}
+
+	const int op = node->is_op() ? node->get_op() : 0;
+	if ((op != OPCODE_AND && op != OPCODE_OR) || !node->L() || !node->R()) {
+		return false;
+	}
+
+	const bool is_or = op == OPCODE_OR;
+	if (frame.stage == 0) {
+		// 0 or 1, the operands past the one that decides it are not evaluated
+		const int cur_logic_cnt = ++logic_cnt;
+		compile_stack.push_back({node, 1, cur_logic_cnt, {}, false});
+		push_cond(node, label(LABEL_LOGIC_SHORT, cur_logic_cnt), is_or);
+	} else {
+		ir.add(IR_PUSH, imm(!is_or));
+		ir.add(IR_JMP,  label(LABEL_LOGIC_END, frame.number));
+		ir.add_label(label(LABEL_LOGIC_SHORT, frame.number));
+		ir.add(IR_PUSH, imm(is_or));
+		ir.add_label(label(LABEL_LOGIC_END, frame.number));
+	}
+
+	return true;
+}
+
+// Operator chains and blocks nest as deep as the source does, so compile() walks
+// them on compile_stack: stage 0 before the children, 1 after L (and R). The rest
+// goes to compile_node(), which comes back here for its subtrees.
+void Compiler::compile(AstNode node) {
 	if (!node) {
 		return;
 	}
 
-	//node->gv_dump();
+	const size_t base = compile_stack.size();
+	compile_stack.push_back({node, 0, 0, {}, false});
+
+	while (compile_stack.size() > base) {
+		CompileFrame frame = compile_stack.pop_back();
+		node = frame.node;
 
-	switch (node->type) {
+		if (frame.stage >= COMPILE_COND) { // node may be null
+			compile_logic(frame);
+			continue;
+		}
+
+		const int op = node->is_op() ? node->get_op() : 0;
+		if (op == '{' || op == ';') {
+			if (frame.stage == 0) {
+				if (node->L() && is_compiling_loggable_op(node->L()->get_op())) {
+					ir.add_comment(node->L());
+				}
+
+				compile_stack.push_back({node, 1, 0, {}, false});
+				if (node->L()) {
+					compile_stack.push_back({node->L(), 0, 0, {}, false});
+				}
+			} else {
+				if (node->R() && is_compiling_loggable_op(node->R()->get_op())) {
+					ir.add_comment(node->R());
+				}
+
+				if (node->R()) {
+					compile_stack.push_back({node->R(), 0, 0, {}, false});
+				}
+			}
+			continue;
+		}
+
+		if (op && (compile_body(frame) || compile_logic(frame))) {
+			continue;
+		}
+
+		const int instruction = op ? ir_stack_op(op) : IR_NONE;
+		if (instruction == IR_NONE) {
+			compile_node(node);
+			continue;
+		}
+
+		if (frame.stage == 0) {
+			if (op == '-' && !node->L()) { // unary minus is 0 - R
+				ir.add(IR_PUSH, imm(0));
+			}
+
+			compile_stack.push_back({node, 1, 0, {}, false});
+			if (node->R()) {
+				compile_stack.push_back({node->R(), 0, 0, {}, false});
+			}
+			if (node->L()) {
+				compile_stack.push_back({node->L(), 0, 0, {}, false});
+			}
+		} else if (op != '+' || node->L()) { // unary plus is R itself
+			ir.add(instruction);
+		}
+	}
+}
+
+void Compiler::compile_node(AstNode node) {
+	switch (node->get_type()) {
 		case VALUE : {
-			compile_push(node, file);
+			compile_push(node);
 			break;
 		}
 
 		case OPERATION : {
-			compile_operation(node, file);
+			compile_operation(node);
 			break;
 		}
 
 		case VARIABLE : {
-			compile_lvalue(node, file);
+			compile_lvalue(node, IR_PUSH);
 			break;
 		}
 
 		case ID : {
-			if (id_table.find_func(node->get_id()) != NOT_FOUND) {
-				compile_func_call(node, file);
-			} else if (node->R) {
-				compile_arr_call(node, file);
+			if (node->get_binding().kind == BOUND_FUNC) {
+				compile_func_call(node);
+			} else if (node->R()) {
+				compile_arr_call(node);
 			} else {
-				compile_push(node, file);
+				compile_push(node);
 			}
 			break;
 		}
@@ -1037,11 +924,21 @@ Compiler::Compiler():
 prog_text(nullptr),
 rec_parser(),
 lex_parser(),
-id_table(),
+ast(),
+ast_cache(),
+resolver(),
+ir(),
+out(),
+peephole(),
+simplifier(),
 cycles_end_stack(),
+compile_stack(),
 if_cnt(0),
 while_cnt(0),
-for_cnt(0)
+for_cnt(0),
+logic_cnt(0),
+opt_level(0),
+opt_stats(false)
 {}
 
 Compiler::~Compiler() {}
@@ -1050,12 +947,24 @@ void Compiler::ctor() {
 	prog_text = nullptr;
 	rec_parser.ctor();
 	lex_parser.ctor();
+	ast.ctor();
+	ast_cache.ctor();
+	resolver.ctor();
+	ir.ctor();
+	out.ctor();
+	peephole.ctor();
+	simplifier.ctor();
 
 	cycles_end_stack.ctor();
+	compile_stack.ctor();
 
 	if_cnt    = 0;
 	while_cnt = 0;
 	for_cnt   = 0;
+	logic_cnt = 0;
+
+	opt_level = 0;
+	opt_stats = false;
 }
 
 Compiler *Compiler::NEW() {
@@ -1069,7 +978,17 @@ Compiler *Compiler::NEW() {
 }
 
 void Compiler::dtor() {
-	id_table.dtor();
+	rec_parser.dtor();
+	ast.dtor();
+	ast_cache.dtor();
+	compile_stack.dtor();
+	resolver.dtor();
+	ir.dtor();
+	out.dtor();
+	peephole.dtor();
+	simplifier.dtor();
+	SYMBOL_POOL.dtor();
+	CODE_NODE_POOL.dtor();
 }
 
 void Compiler::DELETE(Compiler *compiler) {
@@ -1083,22 +1002,47 @@ void Compiler::DELETE(Compiler *compiler) {
 
 //=============================================================================
 
-CodeNode *Compiler::read_to_nodes(const File *file) {
-	Vector<Token> *tokens = lex_parser.parse(file->data);
-	// for (size_t i = 0; i < tokens->size(); ++i) {
-	// 	(*tokens)[i].dump(stdout, false);
-	// 	printf(" ");
-	// }
-	// printf("\n");
+CodeNode *Compiler::read_to_nodes(const File *file, const int lex_threads, const int parse_threads) {
+	CodeNode *cached = ast_cache.load(file);
+	if (cached) {
+		return cached;
+	}
 
+	TokenStream *tokens = nullptr;
+	if (lex_threads > 1 || parse_threads > 1) { // parse workers need the whole stream
+		tokens = lex_parser.parse(file->data, file->length, lex_threads);
+	} else {
+		tokens = lex_parser.stream(file->data, file->length);
+	}
+
+	rec_parser.set_threads(parse_threads);
 	CodeNode *ret = rec_parser.parse(tokens);
 
-	Vector<Token>::DELETE(tokens);
+	TokenStream::DELETE(tokens);
+
+	if (ret) {
+		ast_cache.store(file, ret);
+	}
 
 	return ret;
 }
 
-bool Compiler::compile(const CodeNode *prog, const char *filename) {
+void Compiler::set_parse_memo(const bool caching, const bool counting) {
+	rec_parser.set_memo(caching, counting);
+}
+
+void Compiler::set_ast_cache(const bool enabled, const char *dir) {
+	ast_cache.dtor();
+	ast_cache.ctor(enabled, dir);
+}
+
+void Compiler::set_optimization(const int level, const bool stats) {
+	opt_level = level;
+	opt_stats = stats;
+	resolver.set_propagation(level >= 1);
+}
+
+bool Compiler::compile(CodeNode *prog, const char *filename) {
 	if (filename == nullptr) {
 		RAISE_ERROR("[filename](nullptr)\n");
 		return false;
@@ -1113,21 +1057,51 @@ bool Compiler::compile(const CodeNode *prog, const char *filename) {
 	if_cnt    = 0;
 	while_cnt = 0;
 	for_cnt   = 0;
-	id_table.dtor();
-	id_table.ctor();
+	logic_cnt = 0;
 	cycles_end_stack.dtor();
 	cycles_end_stack.ctor();
+	ir.clear();
+	out.clear();
+
+	ir.add(IR_PUSH, imm(INIT_RVX_OFFSET));
+	ir.add(IR_POP,  reg(REG_RVX));
+	ir.add(IR_PUSH, imm(INIT_RMX_OFFSET));
+	ir.add(IR_POP,  reg(REG_RMX));
+
+	if (opt_level >= 1) {
+		simplifier.simplify(prog);
+		if (opt_stats) {
+			simplifier.dump_stats(stderr);
+		}
+	}
+
+	AstNode root = ast.flatten(prog);
+	if (resolver.resolve(&ast, root)) { // every name is reported first, nothing is emitted past one that is wrong
+		compile(root);
+	}
+
+	if (opt_level >= 1 && !ANNOUNCEMENT_ERROR) {
+		peephole.optimize(&ir);
+		if (opt_stats) {
+			peephole.dump_stats(stderr);
+		}
+	}
 
-	fprintf(file, "push %d\n", INIT_RVX_OFFSET);
-	fprintf(file, "pop rvx\n");
-	fprintf(file, "push %d\n", INIT_RMX_OFFSET);
-	fprintf(file, "pop rmx\n");
+	ir.print(&out, &ast);
 
-	compile(prog, file);
+	if (ANNOUNCEMENT_ERROR) {
+		out.put("AN ERROR OCCURED DURING COMPILATION IUCK\n");
+	}
+
+	// the whole asm goes out in one write
+	const bool written = out.write(file);
 	fclose(file);
 
+	if (!written) {
+		RAISE_ERROR("[filename](%s) can't be written\n", filename);
+	}
+
 	if (ANNOUNCEMENT_ERROR) {
-		fprintf(file, "AN ERROR OCCURED DURING COMPILATION IUCK\n");
 		ANNOUNCE("ERR", "kncc", "An error occured during compilation");
 		return false;
 	}
@@ -1143,4 +1117,3 @@ bool Compiler::compile(const CodeNode *prog, const char *filename) {
 #undef COMPILE_L_COMMENT
 #undef COMPILE_R_COMMENT
 #undef COMPILE_LR
-#undef CHECK_ERROR
@@ -11,7 +11,28 @@
 
 #include "lexical_parser.h"
 #include "recursive_parser.h"
-#include "id_table.h"
+#include "resolver.h"
+#include "flat_ast.h"
+#include "ast_cache.h"
+#include "emitter.h"
+#include "ir.h"
+#include "peephole.h"
+#include "simplifier.h"
+
+// a node compile() has entered, stage says what is left to emit for it and
+// number is the if, while, for or logic count its labels carry; a cond frame
+// jumps to target if node is jump_if
+struct CompileFrame {
+	AstNode node;
+	int     stage;
+	int     number;
+	Operand target;
+	bool    jump_if;
+};
+
+const int COMPILE_COND      = 2; // a cond frame, node is yet to be evaluated
+const int COMPILE_COND_JUMP = 3; // its value is on the stack: compare it and jump
+const int COMPILE_LABEL     = 4; // target is the skip label of a chain, put it here
 
 //=============================================================================
 // Compiler ===================================================================
@@ -22,32 +43,47 @@ private:
 	char *prog_text;
 	RecursiveParser rec_parser;
 	LexicalParser   lex_parser;
+	FlatAst         ast; // what compile() walks, rebuilt from the parsed tree
+	AstCache        ast_cache;
 	
-	IdTable 		id_table;
+	Resolver        resolver; // binds the names of ast before compile() walks it
+	IrProgram       ir;       // what codegen emits, printed into out at the end
+	Emitter         out;      // the asm text of ir, flushed to the file at once
+	Peephole        peephole; // rewrites ir from -O1 on
+	Simplifier      simplifier; // folds the parsed tree from -O1 on
 	Vector<Loop> cycles_end_stack;
+	Vector<CompileFrame> compile_stack;
 
 
 	int if_cnt;
 	int while_cnt;
 	int for_cnt;
+	int logic_cnt;
+
+	int  opt_level;
+	bool opt_stats; // per-rule simplifier and peephole counts to stderr
 //=============================================================================
-	void fprintf_asgn_additional_operation(FILE *file, const int op);
-	void compile_operation(const CodeNode *node, FILE *file);
-
-	void compile_expr 		(const CodeNode *node, FILE *file, const bool to_pop = false);
-	void compile_func_call	(const CodeNode *node, FILE *file);
-	void compile_default_arg(const CodeNode *arg, const CodeNode *prot, FILE *file);
-	void compile_context_arg(const CodeNode *arg, const CodeNode *prot, FILE *file);
-	void compile_expr_arg	(const CodeNode *arg, const CodeNode *prot, FILE *file);
-	void compile_arr_call	(const CodeNode *node, FILE *file);
-	bool compile_push		(const CodeNode *node, FILE *file);
-	bool compile_value 		(const CodeNode *node, FILE *file);
-	bool compile_lvalue		(const CodeNode *node, FILE *file, 
+	void add_asgn_additional_operation(const int op);
+	void compile_operation(AstNode node);
+
+	void compile_expr 		(AstNode node, const bool to_pop = false);
+	void push_cond			(AstNode node, const Operand &target, const bool jump_if);
+	void compile_func_call	(AstNode node);
+	void compile_arr_call	(AstNode node);
+	bool const_index		(AstNode arg, int *index) const;
+	bool compile_push		(AstNode node);
+	bool compile_value 		(AstNode node);
+	Operand number			(const double value) const;
+	bool compile_binding	(const int op, const AstBinding &binding);
+	bool compile_lvalue		(AstNode node, 
+							 const int  op,
 							 const bool for_asgn_dup = false, 
 							 const bool to_push = false, 
 							 const bool initialization = false);
-	void compile_id			(const CodeNode *node, FILE *file);
-	void compile 			(const CodeNode *node, FILE *file);
+	bool compile_body		(const CompileFrame &frame);
+	bool compile_logic		(const CompileFrame &frame);
+	void compile_node		(AstNode node);
+	void compile 			(AstNode node);
 
 
 public:
@@ -65,9 +101,12 @@ public:
 
 //=============================================================================
 
-	CodeNode *read_to_nodes(const File *file);
+	CodeNode *read_to_nodes(const File *file, const int lex_threads = 1, const int parse_threads = 1); // lex_threads > 1 lexes the whole file in parallel first
+	void set_parse_memo(const bool caching, const bool counting);
+	void set_ast_cache(const bool enabled, const char *dir = nullptr); // dir nullptr keeps <source>.kast next to the source
+	void set_optimization(const int level, const bool stats = false);
 
-	bool compile(const CodeNode *prog, const char *filename);
+	bool compile(CodeNode *prog, const char *filename); // from -O1 on prog is simplified in place
 
 };
 
@@ -7,6 +7,7 @@ const int GLOBAL_VARS_OFFSET = 100;
 const int GLOBAL_VARS_MAX_COUNT = 100;
 const int INIT_RVX_OFFSET = GLOBAL_VARS_OFFSET + GLOBAL_VARS_MAX_COUNT;
 const int INIT_RMX_OFFSET = 1000;
+const int COMPILER_MAX_CONST_INDEX = 1 << 20; // a larger constant index is added at run time
 
 enum LOOP_TYPE {
 	LOOP_TYPE_WHILE = 1,
@@ -0,0 +1,191 @@
+#include "emitter.h"
+
+// powers of ten a double holds exactly
+static const double EXACT_POW10[] = {
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+static const int EXACT_POW10_MAX = 22;
+
+Emitter::Emitter():
+buffer(nullptr),
+cur_size(0),
+capacity(0)
+{}
+
+Emitter::~Emitter() {}
+
+void Emitter::ctor() {
+	buffer   = nullptr;
+	cur_size = 0;
+	capacity = 0;
+}
+
+Emitter *Emitter::NEW() {
+	Emitter *cake = (Emitter*) calloc(1, sizeof(Emitter));
+	if (!cake) {
+		return nullptr;
+	}
+
+	cake->ctor();
+	return cake;
+}
+
+void Emitter::dtor() {
+	free(buffer);
+	buffer   = nullptr;
+	cur_size = 0;
+	capacity = 0;
+}
+
+void Emitter::DELETE(Emitter *emitter) {
+	if (!emitter) {
+		return;
+	}
+
+	emitter->dtor();
+	free(emitter);
+}
+
+//=============================================================================
+
+void Emitter::grow(const size_t need) {
+	size_t new_cap = capacity ? capacity * 2 : EMITTER_INIT_CAPACITY;
+	while (new_cap < need) {
+		new_cap *= 2;
+	}
+
+	char *new_buffer = (char*) realloc(buffer, new_cap);
+	if (!new_buffer) {
+		throw std::length_error("[ERR]<emitter>: buffer realloc fail");
+	}
+
+	buffer   = new_buffer;
+	capacity = new_cap;
+}
+
+void Emitter::put(const int value) {
+	char digits[12];
+	int  length = 0;
+
+	unsigned long long rest = value < 0 ? -(long long) value : value;
+	do {
+		digits[sizeof(digits) - 1 - length++] = (char) ('0' + rest % 10);
+		rest /= 10;
+	} while (rest);
+
+	if (value < 0) {
+		digits[sizeof(digits) - 1 - length++] = '-';
+	}
+
+	put_chars(digits + sizeof(digits) - length, (size_t) length);
+}
+
+// The value is scaled to precision digits by one exact power of ten, which is
+// off by far less than the 1e-6 kept from a tie, so rounding it gives printf's
+// digits. Ties, and values the powers do not reach, go to snprintf.
+void Emitter::put_double(const double value, const int precision) {
+	if (value == 0) {
+		put(std::signbit(value) ? "-0" : "0");
+		return;
+	}
+
+	const double magnitude = fabs(value);
+	int    exponent = 0;
+	int    shift    = 0;
+	double scaled   = 0;
+	bool   by_hand  = std::isfinite(value) && precision >= 1 && precision <= EMITTER_MAX_PRECISION;
+
+	if (by_hand) {
+		exponent = (int) floor(log10(magnitude));
+		for (int tries = 0; tries < 3; ++tries) { // log10 can be one off next to a power of ten
+			shift = precision - 1 - exponent;
+			if (shift > EXACT_POW10_MAX || shift < -EXACT_POW10_MAX) {
+				by_hand = false;
+				break;
+			}
+
+			scaled = shift >= 0 ? magnitude * EXACT_POW10[shift] : magnitude / EXACT_POW10[-shift];
+			if (scaled >= EXACT_POW10[precision]) {
+				++exponent;
+			} else if (scaled < EXACT_POW10[precision - 1]) {
+				--exponent;
+			} else {
+				break;
+			}
+		}
+
+		by_hand = by_hand && scaled >= EXACT_POW10[precision - 1] && scaled < EXACT_POW10[precision]
+		                  && fabs(scaled - floor(scaled) - 0.5) > 1e-6;
+	}
+
+	if (!by_hand) {
+		char printed[64];
+		int length = snprintf(printed, sizeof(printed), "%.*g", precision, value);
+		put_chars(printed, (size_t) length);
+		return;
+	}
+
+	long long rounded = (long long) floor(scaled + 0.5);
+	if (rounded == (long long) EXACT_POW10[precision]) {
+		rounded /= 10;
+		++exponent;
+	}
+
+	char digits[EMITTER_MAX_PRECISION];
+	for (int i = precision - 1; i >= 0; --i) {
+		digits[i] = (char) ('0' + rounded % 10);
+		rounded /= 10;
+	}
+
+	int length = precision; // %g drops the trailing zeros of the fraction
+	while (length > 1 && digits[length - 1] == '0') {
+		--length;
+	}
+
+	if (value < 0) {
+		put('-');
+	}
+
+	if (exponent < -4 || exponent >= precision) {
+		put(digits[0]);
+		if (length > 1) {
+			put('.');
+			put_chars(digits + 1, (size_t) length - 1);
+		}
+
+		put('e', exponent < 0 ? '-' : '+');
+		if (abs(exponent) < 10) {
+			put('0');
+		}
+		put(abs(exponent));
+	} else if (exponent >= 0) {
+		put_chars(digits, (size_t) exponent + 1);
+		if (length > exponent + 1) {
+			put('.');
+			put_chars(digits + exponent + 1, (size_t) (length - exponent - 1));
+		}
+	} else {
+		put("0.");
+		for (int i = -1; i > exponent; --i) {
+			put('0');
+		}
+		put_chars(digits, (size_t) length);
+	}
+}
+
+void Emitter::clear() {
+	cur_size = 0;
+}
+
+size_t Emitter::size() const {
+	return cur_size;
+}
+
+const char *Emitter::data() const {
+	return buffer;
+}
+
+bool Emitter::write(FILE *file) const {
+	return fwrite(buffer, 1, cur_size, file) == cur_size;
+}
@@ -0,0 +1,104 @@
+#ifndef EMITTER_H
+#define EMITTER_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <stdexcept>
+
+#include "general/cpp/stringview.hpp"
+
+const size_t EMITTER_INIT_CAPACITY = 1 << 16;
+const int    EMITTER_MAX_PRECISION = 9; // above it the scaled digits are not exact enough to round by hand
+
+//=============================================================================
+// Emitter ====================================================================
+// A growable text buffer. Pieces are appended with put(): strings, chars,
+// ints and names, several at once - put("jmp while_", n, "_end\n") - and
+// doubles with put_double(), which prints what "%.<precision>lg" would. No
+// format strings are parsed and no stdio lock is taken on the way; the text
+// goes out in one write at the end.
+
+class Emitter {
+private:
+// data =======================================================================
+	char   *buffer;
+	size_t  cur_size;
+	size_t  capacity;
+//=============================================================================
+
+	void grow(const size_t need);
+
+	inline char *reserve(const size_t length);
+
+public:
+	Emitter            (const Emitter&) = delete;
+	Emitter &operator= (const Emitter&) = delete;
+
+	Emitter ();
+	~Emitter();
+
+	void ctor();
+	static Emitter *NEW();
+
+	void dtor();
+	static void DELETE(Emitter *emitter);
+
+//=============================================================================
+
+	inline void put_chars(const char *str, const size_t length);
+	inline void put(const char *str);
+	inline void put(const char c);
+	inline void put(const StringView *str);
+	void put(const int value);
+
+	template <typename T, typename U, typename... Rest>
+	inline void put(const T &first, const U &second, const Rest&... rest);
+
+	void put_double(const double value, const int precision = 6);
+
+	void clear();
+	size_t      size() const;
+	const char *data() const;
+
+	bool write(FILE *file) const; // all of it at once
+};
+
+//=============================================================================
+
+inline char *Emitter::reserve(const size_t length) {
+	if (cur_size + length > capacity) {
+		grow(cur_size + length);
+	}
+
+	char *ret = buffer + cur_size;
+	cur_size += length;
+	return ret;
+}
+
+inline void Emitter::put_chars(const char *str, const size_t length) {
+	memcpy(reserve(length), str, length);
+}
+
+inline void Emitter::put(const char *str) {
+	put_chars(str, strlen(str));
+}
+
+inline void Emitter::put(const char c) {
+	*reserve(1) = c;
+}
+
+inline void Emitter::put(const StringView *str) {
+	if (str->get_buffer()) {
+		put_chars(str->get_buffer(), str->length());
+	}
+}
+
+template <typename T, typename U, typename... Rest>
+inline void Emitter::put(const T &first, const U &second, const Rest&... rest) {
+	put(first);
+	put(second, rest...);
+}
+
+#endif // EMITTER_H
@@ -0,0 +1,418 @@
+#include "flat_ast.h"
+
+//=============================================================================
+// AstNode ====================================================================
+//=============================================================================
+
+const StringView *AstNode::get_id() const {
+	return SYMBOL_POOL.get(get_sym());
+}
+
+int AstNode::get_var_from_id() const {
+	return (*get_id())[0];
+}
+
+void AstNode::space_dump(FILE *file) const {
+	ast->dump(file, index, true);
+}
+
+void AstNode::full_dump(FILE *file) const {
+	ast->dump(file, index, false);
+}
+
+void AstNode::space_dump(Emitter *out) const {
+	ast->dump(out, index, true);
+}
+
+//=============================================================================
+// FlatAst ====================================================================
+//=============================================================================
+
+FlatAst::FlatAst():
+kinds(nullptr),
+payloads(nullptr),
+rights(nullptr),
+locations(nullptr),
+values(nullptr),
+bindings(nullptr),
+calls(),
+params(),
+node_cnt(0),
+node_cap(0),
+value_cnt(0),
+value_cap(0),
+pending(),
+walk(),
+text()
+{}
+
+FlatAst::~FlatAst() {}
+
+void FlatAst::ctor() {
+	kinds     = nullptr;
+	payloads  = nullptr;
+	rights    = nullptr;
+	locations = nullptr;
+	values    = nullptr;
+	bindings  = nullptr;
+
+	calls.ctor();
+	params.ctor();
+
+	node_cnt  = 0;
+	node_cap  = 0;
+	value_cnt = 0;
+	value_cap = 0;
+
+	pending.ctor();
+	walk.ctor();
+	text.ctor();
+}
+
+FlatAst *FlatAst::NEW() {
+	FlatAst *cake = (FlatAst*) calloc(1, sizeof(FlatAst));
+	if (!cake) {
+		return nullptr;
+	}
+
+	cake->ctor();
+	return cake;
+}
+
+void FlatAst::dtor() {
+	free(kinds);
+	free(payloads);
+	free(rights);
+	free(locations);
+	free(values);
+	free(bindings);
+	calls.dtor();
+	params.dtor();
+	pending.dtor();
+	walk.dtor();
+	text.dtor();
+
+	kinds     = nullptr;
+	payloads  = nullptr;
+	rights    = nullptr;
+	locations = nullptr;
+	values    = nullptr;
+	bindings  = nullptr;
+
+	node_cnt  = 0;
+	node_cap  = 0;
+	value_cnt = 0;
+	value_cap = 0;
+}
+
+void FlatAst::DELETE(FlatAst *ast) {
+	if (!ast) {
+		return;
+	}
+
+	ast->dtor();
+	free(ast);
+}
+
+//=============================================================================
+
+void FlatAst::grow_nodes() {
+	int new_cap = node_cap ? node_cap * 2 : FLAT_AST_INIT_CAPACITY;
+
+	unsigned char *new_kinds     = (unsigned char*) realloc(kinds,     (size_t) new_cap * sizeof(unsigned char));
+	if (new_kinds)     kinds     = new_kinds;
+	int           *new_payloads  = (int*)           realloc(payloads,  (size_t) new_cap * sizeof(int));
+	if (new_payloads)  payloads  = new_payloads;
+	int           *new_rights    = (int*)           realloc(rights,    (size_t) new_cap * sizeof(int));
+	if (new_rights)    rights    = new_rights;
+	AstLocation   *new_locations = (AstLocation*)   realloc(locations, (size_t) new_cap * sizeof(AstLocation));
+	if (new_locations) locations = new_locations;
+	AstBinding    *new_bindings  = (AstBinding*)    realloc(bindings,  (size_t) new_cap * sizeof(AstBinding));
+	if (new_bindings)  bindings  = new_bindings;
+
+	if (!new_kinds || !new_payloads || !new_rights || !new_locations || !new_bindings) {
+		throw std::length_error("[ERR]<flat_ast>: node arrays realloc fail");
+	}
+
+	node_cap = new_cap;
+}
+
+int FlatAst::push(const CodeNode *node) {
+	if (node_cnt == node_cap) {
+		grow_nodes();
+	}
+
+	int payload = 0;
+	if (node->is_val()) {
+		if (value_cnt == value_cap) {
+			int new_cap = value_cap ? value_cap * 2 : FLAT_AST_INIT_CAPACITY;
+			double *new_values = (double*) realloc(values, (size_t) new_cap * sizeof(double));
+			if (!new_values) {
+				throw std::length_error("[ERR]<flat_ast>: values realloc fail");
+			}
+
+			values    = new_values;
+			value_cap = new_cap;
+		}
+
+		values[value_cnt] = node->get_val();
+		payload = value_cnt++;
+	} else if (node->is_op()) {
+		payload = node->get_op();
+	} else if (node->is_id()) {
+		payload = node->get_sym();
+	} else {
+		payload = node->get_var();
+	}
+
+	int index = node_cnt++;
+	kinds[index]     = (unsigned char) (((unsigned) node->get_type() & AST_TYPE_MASK) | (node->L ? AST_HAS_L : 0));
+	payloads[index]  = payload;
+	rights[index]    = NO_NODE;
+	locations[index] = {node->line, node->pos};
+	bindings[index]  = {BOUND_NONE, 0, NO_CALL};
+
+	return index;
+}
+
+// preorder without recursion: down the L spine, every R met on the way waits
+// in pending and is laid out, with its own spine, once the spine below is done
+AstNode FlatAst::flatten(const CodeNode *tree) {
+	node_cnt  = 0;
+	value_cnt = 0;
+	calls.dtor();
+	calls.ctor();
+	params.dtor();
+	params.ctor();
+
+	if (!tree) {
+		return AstNode();
+	}
+
+	pending.push_back({tree, NO_NODE});
+	while (pending.size()) {
+		FlattenFrame frame = pending.pop_back();
+
+		int parent = frame.parent;
+		for (const CodeNode *node = frame.node; node; node = node->L) {
+			int index = push(node);
+			if (parent != NO_NODE) {
+				rights[parent] = index;
+				parent = NO_NODE;
+			}
+
+			if (node->R) {
+				pending.push_back({node->R, index});
+			}
+		}
+	}
+
+	return AstNode(this, 0);
+}
+
+AstNode FlatAst::root() const {
+	return node_cnt ? AstNode(this, 0) : AstNode();
+}
+
+int FlatAst::size() const {
+	return node_cnt;
+}
+
+size_t FlatAst::memory() const {
+	return (size_t) node_cnt  * (sizeof(unsigned char) + 2 * sizeof(int) + sizeof(AstLocation) + sizeof(AstBinding))
+		 + (size_t) value_cnt * sizeof(double);
+}
+
+// a subtree is a run of the preorder: it starts at its root and ends at the
+// node the walk down R first, L otherwise stops at
+AstNode FlatAst::clone(const AstNode subtree) {
+	int last = subtree.get_index();
+	for (;;) {
+		if (rights[last] != NO_NODE) {
+			last = rights[last];
+		} else if (kinds[last] & AST_HAS_L) {
+			++last;
+		} else {
+			break;
+		}
+	}
+
+	const int first = subtree.get_index();
+	const int cnt   = last - first + 1;
+	while (node_cnt + cnt > node_cap) {
+		grow_nodes();
+	}
+
+	const int shift = node_cnt - first;
+	for (int i = 0; i < cnt; ++i) {
+		kinds    [node_cnt + i] = kinds[first + i];
+		payloads [node_cnt + i] = payloads[first + i];
+		rights   [node_cnt + i] = rights[first + i] != NO_NODE ? rights[first + i] + shift : NO_NODE;
+		locations[node_cnt + i] = locations[first + i];
+		bindings [node_cnt + i] = {BOUND_NONE, 0, NO_CALL};
+	}
+
+	node_cnt += cnt;
+	return AstNode(this, first + shift);
+}
+
+void FlatAst::bind(const AstNode node, const int kind, const int value) {
+	bindings[node.get_index()] = {kind, value, NO_CALL};
+}
+
+int FlatAst::add_call(const AstNode node, const int label) {
+	const int call = (int) calls.size();
+	calls.push_back({label, 0, NO_PARAM, NO_PARAM});
+	bindings[node.get_index()] = {BOUND_FUNC, label, call};
+	return call;
+}
+
+void FlatAst::add_param(const int call, const AstParam &param) {
+	const int index = (int) params.size();
+	params.push_back(param);
+	params[(size_t) index].next = NO_PARAM;
+
+	AstCall &site = calls[(size_t) call];
+	if (site.last_param == NO_PARAM) {
+		site.first_param = index;
+	} else {
+		params[(size_t) site.last_param].next = index;
+	}
+	site.last_param = index;
+}
+
+void FlatAst::set_frame(const int call, const int frame) {
+	calls[(size_t) call].frame = frame;
+}
+
+const AstParam &FlatAst::get_param(const int param) const {
+	return params[(size_t) param];
+}
+
+//=============================================================================
+
+void FlatAst::dump(FILE *file, const int index, const bool skip_statements) const {
+	text.clear();
+	dump(&text, index, skip_statements);
+	text.write(file);
+}
+
+// "(L)node(R)" for every node, an explicit stack of index * 4 + stage:
+// 0 - before L, 1 - the node itself, 2 - after R
+void FlatAst::dump(Emitter *out, const int index, const bool skip_statements) const {
+	const size_t base = walk.size();
+	walk.push_back(index * 4);
+
+	while (walk.size() > base) {
+		const int frame = walk.pop_back();
+		const AstNode node(this, frame / 4);
+
+		switch (frame % 4) {
+			case 0 : {
+				if (skip_statements && node.is_op(';')) {
+					break;
+				}
+
+				walk.push_back(frame + 1);
+				if (node.L()) {
+					out->put('(');
+					walk.push_back(node.L().get_index() * 4);
+				}
+				break;
+			}
+
+			case 1 : {
+				if (node.L()) {
+					out->put(')');
+				}
+
+				if (node.is_op()) {
+					if (is_printable_op(node.get_op())) {
+						out->put((char) node.get_op());
+					} else {
+						out->put("[op_", node.get_op(), ']');
+					}
+				} else if (node.is_var()) {
+					out->put('{', node.get_var(), '}');
+				} else if (node.is_val()) {
+					out->put_double(node.get_val());
+				} else if (node.is_id()) {
+					out->put(node.get_id());
+				} else {
+					out->put(skip_statements ? ">ERR<" : "ERR");
+				}
+
+				if (node.R()) {
+					out->put('(');
+					walk.push_back(frame + 1);
+					walk.push_back(node.R().get_index() * 4);
+				}
+				break;
+			}
+
+			case 2 : {
+				out->put(')');
+				break;
+			}
+		}
+	}
+}
+
+void FlatAst::gv_dump_node(FILE *file, const int index) const {
+	AstNode node(this, index);
+
+	fprintf(file, "\"node_%d\" [label=\"", index);
+
+	if (node.is_val()) {
+		fprintf(file, "%lg\" shape=circle style=filled fillcolor=\"#FFFFCC\"", node.get_val());
+	} else if (node.is_op()) {
+		const char *opname = OPERATION_NAME(node.get_op());
+		if (opname) {
+			fprintf(file, "%s\" shape=invhouse style=filled fillcolor=\"#CCCCFF\"", opname);
+		} else {
+			if (is_printable_op(node.get_op()))
+				fprintf(file, "%c\" shape=invhouse style=filled fillcolor=\"#FFCCCC\" fontsize=16", node.get_op());
+			else
+				fprintf(file, "[OP_%d]\" shape=invhouse style=filled fillcolor=\"#CCCCCC\"", node.get_op());
+		}
+	} else if (node.is_id()) {
+		node.get_id()->print(file);
+		fprintf(file, "\" shape=circle style=filled fillcolor=\"#CCFFFF\"");
+	}
+
+	fprintf(file, "]\n");
+
+	if (node.L()) {
+		fprintf(file, "\"node_%d\" -> \"node_%d\"\n", index, index + 1);
+	}
+
+	if (node.R()) {
+		fprintf(file, "\"node_%d\" -> \"node_%d\"\n", index, rights[index]);
+	}
+}
+
+void FlatAst::gv_dump(FILE *file, const char *name) const {
+	bool call_show = false;
+	if (!file) {
+		call_show = true;
+		file = fopen(name, "w");
+		fprintf(file, "digraph list {rankdir=\"UD\";\n");
+	}
+
+	for (int i = 0; i < node_cnt; ++i) {
+		gv_dump_node(file, i);
+	}
+
+	if (call_show) {
+		fprintf(file, "}\n");
+		fclose(file);
+		char generate_picture_command[100];
+		sprintf(generate_picture_command, "dot %s -T%s -o%s.svg", name, "svg", name);
+
+		char view_picture_command[100];
+		sprintf(view_picture_command, "eog %s.%s", name, "svg");
+
+		system(generate_picture_command);
+		system(view_picture_command);
+	}
+}
@@ -0,0 +1,247 @@
+#ifndef FLAT_AST_H
+#define FLAT_AST_H
+
+#include <cstdio>
+#include <cstddef>
+#include <stdexcept>
+
+#include "general/cpp/vector.hpp"
+
+#include "code_node.h"
+#include "emitter.h"
+
+const int NO_NODE = -1;
+
+const int      AST_TYPE_BITS     = 7;
+const unsigned AST_TYPE_MASK     = (1u << AST_TYPE_BITS) - 1;
+const unsigned AST_HAS_L         = 1u << AST_TYPE_BITS;
+
+const int      FLAT_AST_INIT_CAPACITY = 1024;
+
+struct AstLocation {
+	int line;
+	int pos;
+};
+
+const int NO_CALL  = -1;
+const int NO_PARAM = -1;
+
+enum BINDING_KIND {
+	BOUND_NONE      = 0, // not a name, or one no pass has looked up
+	BOUND_LOCAL     = 1, // frame slot: [rvx + value]
+	BOUND_GLOBAL    = 2, // global index: [GLOBAL_VARS_OFFSET + value]
+	BOUND_FUNC      = 3, // label value
+	BOUND_UNDEFINED = 4,
+	BOUND_CONST     = 5, // a _name with no slot: value is the VALUE node it was defined with
+};
+
+// what the Resolver bound a node to
+struct AstBinding {
+	int kind;
+	int value;
+	int call; // into the calls of the tree for a node that calls a func, NO_CALL otherwise
+};
+
+struct FlattenFrame {
+	const CodeNode *node;
+	int             parent; // the node whose R it is
+};
+
+class FlatAst;
+struct AstCall;
+
+//=============================================================================
+// AstNode ====================================================================
+// A node of a FlatAst: the tree and an index into it. Reads like a const
+// CodeNode pointer (node->get_op(), node->L(), if (node)), a null AstNode has
+// no tree. Handles stay valid while the tree is not rebuilt.
+
+class AstNode {
+private:
+// data =======================================================================
+	const FlatAst *ast;
+	int            index;
+//=============================================================================
+
+public:
+	AstNode() : ast(nullptr), index(0) {}
+	AstNode(std::nullptr_t) : ast(nullptr), index(0) {}
+	AstNode(const FlatAst *ast_, const int index_) : ast(ast_), index(index_) {}
+
+	explicit operator bool() const { return ast; }
+	const AstNode *operator->() const { return this; }
+
+	bool operator==(const AstNode &other) const { return ast == other.ast && index == other.index; }
+	bool operator!=(const AstNode &other) const { return !(*this == other); }
+
+	int get_index() const { return index; }
+
+	inline AstNode L() const;
+	inline AstNode R() const;
+
+	inline char   get_type() const;
+	inline int    get_op  () const;
+	inline int    get_var () const;
+	inline double get_val () const;
+	inline int    get_sym () const;
+
+	const StringView *get_id() const;
+	int get_var_from_id() const;
+
+	bool is_op () const { return get_type() == OPERATION; }
+	bool is_op (const int op) const { return is_op() && get_op() == op; }
+	bool is_var() const { return get_type() == VARIABLE; }
+	bool is_val() const { return get_type() == VALUE; }
+	bool is_id () const { return get_type() == ID; }
+
+	inline int line() const;
+	inline int pos () const;
+
+	inline const AstBinding &get_binding() const;
+	inline const AstCall    &get_call   () const;
+
+	void space_dump(FILE *file = stdout) const;
+	void full_dump (FILE *file = stdout) const;
+	void space_dump(Emitter *out) const;
+};
+
+// a func call resolved at its site
+struct AstCall {
+	int label;
+	int frame;       // var slots of the caller, rvx moves past them for the call
+	int first_param; // into the params of the tree, chained through next
+	int last_param;
+};
+
+// one argument of a call: source is pushed - the subtree compiled in the
+// caller's scope or, if null, the caller's var source_name - and target is
+// the arg slot it is popped to
+struct AstParam {
+	AstNode    source;
+	AstBinding source_name;
+	AstBinding target;
+	int        next;
+};
+
+//=============================================================================
+// FlatAst ====================================================================
+// The CodeNode tree laid out in preorder in parallel arrays. A node is a kind
+// byte (type and has-L bit), a payload (op, symbol, var or an index into
+// values) and the index of its R child; its L child, if any, is the next
+// node. Source positions live in a side table only error reporting touches.
+// Names carry what the Resolver bound them to, calls and their arguments live
+// in their own tables.
+
+class FlatAst {
+private:
+// data =======================================================================
+	unsigned char *kinds;     // type | AST_HAS_L
+	int           *payloads;  // full 32 bits, a value index or a symbol id can be any int
+	int           *rights;    // R child, NO_NODE if none
+	AstLocation   *locations;
+	double        *values;    // payloads of VALUE nodes
+	AstBinding    *bindings;
+
+	Vector<AstCall>  calls;
+	Vector<AstParam> params;
+
+	int          node_cnt;
+	int          node_cap;
+	int          value_cnt;
+	int          value_cap;
+
+	Vector<FlattenFrame> pending; // R subtrees flatten() has yet to lay out
+	mutable Vector<int>  walk;    // dump() stack
+	mutable Emitter      text;    // what dump() to a FILE writes out
+//=============================================================================
+
+	friend class AstNode;
+
+	int  push(const CodeNode *node);
+	void grow_nodes();
+
+	void dump(FILE    *file, const int index, const bool skip_statements) const;
+	void dump(Emitter *out,  const int index, const bool skip_statements) const;
+	void gv_dump_node(FILE *file, const int index) const;
+
+public:
+	FlatAst            (const FlatAst&) = delete;
+	FlatAst &operator= (const FlatAst&) = delete;
+
+	FlatAst ();
+	~FlatAst();
+
+	void ctor();
+	static FlatAst *NEW();
+
+	void dtor();
+	static void DELETE(FlatAst *ast);
+
+//=============================================================================
+
+	AstNode flatten(const CodeNode *tree); // replaces the contents, returns the root
+	AstNode root() const;
+
+	int    size  () const;
+	size_t memory() const; // bytes taken by the nodes
+
+	AstNode clone(const AstNode subtree); // a copy at the end, to be bound on its own
+
+	void bind     (const AstNode node, const int kind, const int value);
+	int  add_call (const AstNode node, const int label); // binds node to the func and returns the call
+	void add_param(const int call, const AstParam &param);
+	void set_frame(const int call, const int frame);
+
+	const AstParam &get_param(const int param) const;
+
+	void gv_dump(FILE *file = nullptr, const char *name = (const char*) "code_tree") const;
+};
+
+//=============================================================================
+
+inline AstNode AstNode::L() const {
+	return (ast->kinds[index] & AST_HAS_L) ? AstNode(ast, index + 1) : AstNode();
+}
+
+inline AstNode AstNode::R() const {
+	const int right = ast->rights[index];
+	return right != NO_NODE ? AstNode(ast, right) : AstNode();
+}
+
+inline char AstNode::get_type() const {
+	return (char) (ast->kinds[index] & AST_TYPE_MASK);
+}
+
+inline int AstNode::get_op() const {
+	return ast->payloads[index];
+}
+
+inline int AstNode::get_var() const {
+	return ast->payloads[index];
+}
+
+inline double AstNode::get_val() const {
+	return ast->values[ast->payloads[index]];
+}
+
+inline int AstNode::get_sym() const {
+	return ast->payloads[index];
+}
+
+inline int AstNode::line() const {
+	return ast->locations[index].line;
+}
+
+inline int AstNode::pos() const {
+	return ast->locations[index].pos;
+}
+
+inline const AstBinding &AstNode::get_binding() const {
+	return ast->bindings[index];
+}
+
+inline const AstCall &AstNode::get_call() const {
+	return ast->calls[(size_t) ast->bindings[index].call];
+}
+
+#endif // FLAT_AST_H
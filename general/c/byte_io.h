@@ -23,12 +23,12 @@ typedef struct ByteOP_s {
 } ByteOP;
 
 ByteOP *new_ByteOP(const size_t size) {
-    ByteOP *bop = calloc(sizeof(ByteOP), 1);
+    ByteOP *bop = (ByteOP*) calloc(sizeof(ByteOP), 1);
     if (!bop) {
         return NULL;
     }
 
-    bop->buffer = calloc(size, 1);
+    bop->buffer = (byte*) calloc(size, 1);
     if (!bop->buffer) {
         free(bop);
         return NULL;
@@ -73,7 +73,7 @@ int ByteOP_put(ByteOP *cake, const void *src, const size_t size) {
     VERIFY(cake != NULL);
     VERIFY(src  != NULL);
 
-    if (cake->size + size >= cake->capacity) {
+    while (cake->size + size >= cake->capacity) {
         VERIFY_OK(ByteOP_realloc_up(cake));
     }
 
@@ -117,10 +117,14 @@ int ByteOP_put_string(ByteOP *cake, const char *src) {
 int ByteOP_to_file(const ByteOP *cake, const char* filename) {
     VERIFY(cake != NULL);
     FILE *fout = fopen(filename, "wb");
-    fwrite(cake->buffer, sizeof(byte), cake->size, fout);
+    if (!fout) {
+        return ERROR_FILE_NOT_FOUND;
+    }
+
+    size_t written = fwrite(cake->buffer, sizeof(byte), cake->size, fout);
     fclose(fout);
 
-    return 0;
+    return written == cake->size ? 0 : ERROR_ERROR;
 }
 
 //=============================================================================
@@ -134,12 +138,12 @@ typedef struct ByteIP_s {
 } ByteIP;
 
 ByteIP *new_ByteIP(const size_t capacity) {
-    ByteIP *bip = calloc(sizeof(ByteIP), 1);
+    ByteIP *bip = (ByteIP*) calloc(sizeof(ByteIP), 1);
     if (!bip) {
         return NULL;
     }
 
-    bip->buffer = calloc(capacity + 1, 1);
+    bip->buffer = (byte*) calloc(capacity + 1, 1);
     if (!bip->buffer) {
         free(bip);
         return NULL;
@@ -169,7 +173,7 @@ int ByteIP_read_file(ByteIP *cake, const char *file_name, const size_t file_size
     VERIFY(file_name != NULL);
 
     if (file_size > cake->capacity) {
-        byte *new_buffer = realloc(cake->buffer, file_size + 1);
+        byte *new_buffer = (byte*) realloc(cake->buffer, file_size + 1);
         VERIFY(new_buffer != NULL);
 
         cake->buffer = new_buffer;
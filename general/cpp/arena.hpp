@@ -0,0 +1,183 @@
+#ifndef GENERAL_ARENA
+#define GENERAL_ARENA
+
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+const size_t ARENA_CHUNK_SIZE = 1 << 16;
+
+struct ArenaChunk {
+	ArenaChunk *next;
+	size_t size;
+};
+
+//=============================================================================
+// Arena ======================================================================
+// Bump allocator over a list of chunks. Allocations are never freed one by
+// one: release() drops all of them at once and keeps the newest chunk for
+// reuse, dtor() gives every chunk back. A zeroed Arena is ready to use.
+
+class Arena {
+private:
+// data =======================================================================
+	ArenaChunk *chunks;     // newest first
+	char       *cur;
+	char       *end;
+	size_t      chunk_size;
+
+	size_t      alloc_cnt;
+	size_t      chunk_cnt;
+//=============================================================================
+
+	void grow(const size_t size) {
+		size_t new_size = chunk_size ? chunk_size : ARENA_CHUNK_SIZE;
+		if (new_size < size + sizeof(ArenaChunk)) {
+			new_size = size + sizeof(ArenaChunk);
+		}
+
+		ArenaChunk *chunk = (ArenaChunk*) malloc(new_size);
+		if (!chunk) {
+			throw std::length_error("[ERR]<arena>: chunk alloc fail");
+		}
+
+		chunk->next = chunks;
+		chunk->size = new_size;
+		chunks = chunk;
+		++chunk_cnt;
+
+		cur = (char*) (chunk + 1);
+		end = (char*) chunk + new_size;
+	}
+
+	static char *align_up(char *ptr, const size_t align) {
+		return (char*) (((uintptr_t) ptr + align - 1) & ~(uintptr_t) (align - 1));
+	}
+
+public:
+	Arena            (const Arena&) = delete;
+	Arena &operator= (const Arena&) = delete;
+
+	Arena() :
+	chunks(nullptr),
+	cur(nullptr),
+	end(nullptr),
+	chunk_size(0),
+	alloc_cnt(0),
+	chunk_cnt(0)
+	{}
+
+	~Arena() {}
+
+	void ctor(const size_t chunk_size_ = ARENA_CHUNK_SIZE) {
+		chunks     = nullptr;
+		cur        = nullptr;
+		end        = nullptr;
+		chunk_size = chunk_size_;
+		alloc_cnt  = 0;
+		chunk_cnt  = 0;
+	}
+
+	static Arena *NEW(const size_t chunk_size_ = ARENA_CHUNK_SIZE) {
+		Arena *cake = (Arena*) calloc(1, sizeof(Arena));
+		if (!cake) {
+			return nullptr;
+		}
+
+		cake->ctor(chunk_size_);
+		return cake;
+	}
+
+	void dtor() {
+		while (chunks) {
+			ArenaChunk *next = chunks->next;
+			free(chunks);
+			chunks = next;
+		}
+
+		cur       = nullptr;
+		end       = nullptr;
+		alloc_cnt = 0;
+		chunk_cnt = 0;
+	}
+
+	static void DELETE(Arena *arena) {
+		if (!arena) {
+			return;
+		}
+
+		arena->dtor();
+		free(arena);
+	}
+
+//=============================================================================
+
+	void *alloc(const size_t size, const size_t align = alignof(std::max_align_t)) {
+		char *ptr = cur ? align_up(cur, align) : nullptr;
+		if (!ptr || ptr + size > end) {
+			grow(size + align);
+			ptr = align_up(cur, align);
+		}
+
+		cur = ptr + size;
+		++alloc_cnt;
+		return ptr;
+	}
+
+	void release() {
+		if (!chunks) {
+			return;
+		}
+
+		ArenaChunk *kept = chunks;
+		chunks = chunks->next;
+		dtor();
+
+		kept->next = nullptr;
+		chunks     = kept;
+		chunk_cnt  = 1;
+		cur = (char*) (kept + 1);
+		end = (char*) kept + kept->size;
+	}
+
+	// takes over the chunks of other and leaves it empty, its allocations stay valid
+	void adopt(Arena *other) {
+		if (!other->chunks) {
+			return;
+		}
+
+		ArenaChunk *last = other->chunks;
+		while (last->next) {
+			last = last->next;
+		}
+
+		if (chunks) { // the newest chunk stays first, bumping goes on in it
+			last->next   = chunks->next;
+			chunks->next = other->chunks;
+		} else {
+			chunks = other->chunks;
+			cur    = other->cur;
+			end    = other->end;
+		}
+
+		alloc_cnt += other->alloc_cnt;
+		chunk_cnt += other->chunk_cnt;
+
+		other->chunks    = nullptr;
+		other->cur       = nullptr;
+		other->end       = nullptr;
+		other->alloc_cnt = 0;
+		other->chunk_cnt = 0;
+	}
+
+	size_t allocations() const {
+		return alloc_cnt;
+	}
+
+	size_t chunk_count() const {
+		return chunk_cnt;
+	}
+};
+
+#endif // GENERAL_ARENA
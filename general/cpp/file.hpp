@@ -2,26 +2,108 @@
 #define CPP_FILE_H
 
 #include <cstdlib>
+#include <cstdio>
+#include <cstring>
 #include <cctype>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+const size_t FILE_STREAM_CHUNK = 1 << 16;
+
+enum FILE_LOAD_MODE {
+	FILE_READ = 0, // copy into a heap buffer
+	FILE_MAP  = 1, // map regular files, fall back to FILE_READ for pipes and stdin
+};
 
 //=============================================================================
 // File =======================================================================
+// data[length] and data[length + 1] are always '\0', whatever the load mode,
+// so NUL-terminated readers keep working on mapped files.
+// The name "-" reads stdin.
 
 class File {
 public:
 // data =======================================================================
 	char *data;
+	size_t length;
+	size_t mapped; // size of the mapping, 0 if data is on the heap
 	const char *name;
 	FILE *fileptr;
 	struct stat info;
 //=============================================================================
 
+private:
+	bool map_file() {
+		const size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+		const size_t file_size = (size_t) info.st_size;
+		const size_t map_size  = (file_size / page_size + 2) * page_size; // at least one zero page after the file
+
+		void *region = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (region == MAP_FAILED) {
+			return false;
+		}
+
+		void *view = mmap(region, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fileno(fileptr), 0);
+		if (view == MAP_FAILED) {
+			munmap(region, map_size);
+			return false;
+		}
+
+		madvise(view, file_size, MADV_SEQUENTIAL);
+
+		data   = (char*) view;
+		length = file_size;
+		mapped = map_size;
+		return true;
+	}
+
+	void read_file() {
+		data = (char*) calloc((size_t) info.st_size + 2, sizeof(char));
+	    if (!data) {
+	        return;
+	    }
+
+		length = fread(data, sizeof(char), (size_t) info.st_size, fileptr);
+	}
+
+	void read_stream(FILE *stream) {
+		size_t capacity = FILE_STREAM_CHUNK;
+		data = (char*) calloc(capacity, sizeof(char));
+		if (!data) {
+			return;
+		}
+
+		size_t read = 0;
+		while ((read = fread(data + length, sizeof(char), capacity - length - 2, stream)) > 0) {
+			length += read;
+			if (capacity - length - 2 == 0) {
+				char *new_data = (char*) realloc(data, capacity * 2);
+				if (!new_data) {
+					free(data);
+					data   = nullptr;
+					length = 0;
+					return;
+				}
+
+				data = new_data;
+				capacity *= 2;
+			}
+		}
+
+		data[length]     = '\0';
+		data[length + 1] = '\0';
+	}
+
+public:
+
 	File            (const File&) = delete;
 	File &operator= (const File&) = delete;
 
 	File():
 	data(nullptr),
+	length(0),
+	mapped(0),
 	name(nullptr),
 	fileptr(nullptr),
 	info()
@@ -31,6 +113,8 @@ public:
 
 	void ctor() {
 		data = nullptr;
+		length = 0;
+		mapped = 0;
 		name = nullptr;
 		fileptr = nullptr;
 	}
@@ -45,12 +129,18 @@ public:
 		return cake;
 	}
 
-	void ctor(const char *name_) {
+	void ctor(const char *name_, const FILE_LOAD_MODE mode = FILE_READ) {
+		ctor();
 		name = name_;
 		if (!name) {
 			return;
 		}
 
+		if (!strcmp(name, "-")) {
+			read_stream(stdin);
+			return;
+		}
+
 		fileptr = fopen(name, "rb");
 		if (!fileptr) {
 			return;
@@ -58,22 +148,30 @@ public:
 
 		fstat(fileno(fileptr), &(info));
 
-		data = (char*) calloc((size_t) info.st_size + 2, sizeof(char));
-	    if (!data) {
-	    	fclose(fileptr);
-	        return;
-	    }
+		const bool sized = S_ISREG(info.st_mode) && info.st_size > 0;
+		if (mode == FILE_MAP && sized && map_file()) {
+			return;
+		}
 
-		fread(data, (size_t) info.st_size, 1, fileptr);
+		if (sized) {
+			read_file();
+		} else {
+			read_stream(fileptr);
+		}
+
+		if (!data) {
+			fclose(fileptr);
+			fileptr = nullptr;
+		}
 	}
 
-	static File *NEW(const char *name_) {
+	static File *NEW(const char *name_, const FILE_LOAD_MODE mode = FILE_READ) {
 		File *cake = (File*) calloc(1, sizeof(File));
 		if (!cake) {
 			return nullptr;
 		}
 
-		cake->ctor(name_);
+		cake->ctor(name_, mode);
 		return cake;
 	}
 
@@ -83,9 +181,15 @@ public:
 		}
 
 		if (data) {
-			free(data);
+			if (mapped) {
+				munmap(data, mapped);
+			} else {
+				free(data);
+			}
 			data = nullptr;
 		}
+		length = 0;
+		mapped = 0;
 
 		if (fileptr) {
 			fclose(fileptr);
@@ -0,0 +1,135 @@
+#ifndef GENERAL_POOL
+#define GENERAL_POOL
+
+#include "arena.hpp"
+
+//=============================================================================
+// Pool =======================================================================
+// Fixed-size slots for one type, carved from an Arena. put() links a slot into
+// the free list for the next get(); nothing goes back to malloc before
+// release() or dtor(), which drop every slot at once. get() returns raw memory,
+// the caller ctor()s it. A zeroed Pool is ready to use.
+
+template <typename T>
+class Pool {
+private:
+	union Slot {
+		Slot *next;
+		alignas(T) char item[sizeof(T)];
+	};
+
+// data =======================================================================
+	Arena  arena;
+	Slot  *free_slots;
+
+	size_t get_cnt;
+	size_t reuse_cnt;
+//=============================================================================
+
+public:
+	Pool            (const Pool&) = delete;
+	Pool &operator= (const Pool&) = delete;
+
+	Pool() :
+	arena(),
+	free_slots(nullptr),
+	get_cnt(0),
+	reuse_cnt(0)
+	{}
+
+	~Pool() {}
+
+	void ctor(const size_t chunk_size = ARENA_CHUNK_SIZE) {
+		arena.ctor(chunk_size);
+		free_slots = nullptr;
+		get_cnt    = 0;
+		reuse_cnt  = 0;
+	}
+
+	static Pool<T> *NEW(const size_t chunk_size = ARENA_CHUNK_SIZE) {
+		Pool<T> *cake = (Pool<T>*) calloc(1, sizeof(Pool<T>));
+		if (!cake) {
+			return nullptr;
+		}
+
+		cake->ctor(chunk_size);
+		return cake;
+	}
+
+	void dtor() {
+		arena.dtor();
+		free_slots = nullptr;
+		get_cnt    = 0;
+		reuse_cnt  = 0;
+	}
+
+	static void DELETE(Pool<T> *pool) {
+		if (!pool) {
+			return;
+		}
+
+		pool->dtor();
+		free(pool);
+	}
+
+//=============================================================================
+
+	T *get() {
+		++get_cnt;
+		if (free_slots) {
+			Slot *slot = free_slots;
+			free_slots = slot->next;
+			++reuse_cnt;
+			return (T*) slot;
+		}
+
+		return (T*) arena.alloc(sizeof(Slot), alignof(Slot));
+	}
+
+	void put(T *item) {
+		Slot *slot = (Slot*) item;
+		slot->next = free_slots;
+		free_slots = slot;
+	}
+
+	void release() {
+		arena.release();
+		free_slots = nullptr;
+	}
+
+	// takes over the slots and free list of other and leaves it empty
+	void adopt(Pool<T> *other) {
+		arena.adopt(&other->arena);
+
+		if (other->free_slots) {
+			Slot *last = other->free_slots;
+			while (last->next) {
+				last = last->next;
+			}
+
+			last->next = free_slots;
+			free_slots = other->free_slots;
+		}
+
+		get_cnt   += other->get_cnt;
+		reuse_cnt += other->reuse_cnt;
+
+		other->free_slots = nullptr;
+		other->get_cnt    = 0;
+		other->reuse_cnt  = 0;
+	}
+
+	size_t gets() const {
+		return get_cnt;
+	}
+
+	size_t reuses() const {
+		return reuse_cnt;
+	}
+
+	size_t chunk_count() const {
+		return arena.chunk_count();
+	}
+};
+
+#endif // GENERAL_POOL
@@ -89,22 +89,21 @@ public:
 			return false;
 		}
 
-		size_t len_1 = strlen(first);
 		size_t len_2 = strlen(second);
-		return len_1 < len_2 || (!len_2) ? false : memcmp(first, second, len_2) == 0;
+		return (!len_2) ? false : strncmp(first, second, len_2) == 0; // first may be huge, don't strlen it
 	}
 
 	bool is_null() const {
 		return buffer == nullptr;
 	}
 
-	bool starts_with(const StringView &other) {
+	bool starts_with(const StringView &other) const {
 		size_t len_1 = size;
 		size_t len_2 = other.length();
 		return len_1 < len_2 ? false : memcmp(buffer, other.get_buffer(), len_2) == 0;
 	}
 
-	bool starts_with(const char *other) {
+	bool starts_with(const char *other) const {
 		if (!other) {
 			return false;
 		}
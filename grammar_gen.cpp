@@ -0,0 +1,419 @@
+// grammar_gen - reads grammar.gr and writes the FIRST sets of the parser rules
+// usage: grammar_gen grammar.gr grammar_first.h
+//
+// Every rule from parse_rules.h must be defined in the grammar, every name the
+// grammar uses must be defined and every quoted token must be a known operator,
+// otherwise the build stops here instead of the parser silently drifting away.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+
+const int MAX_SYMBOLS   = 128;
+const int MAX_NODES     = 4096;
+const int MAX_NAME      = 64;
+const int MAX_TEXT      = 1 << 16;
+
+enum GRAMMAR_NODE_KIND {
+	G_TERMINAL = 0,
+	G_RULE     = 1,
+	G_SEQ      = 2,
+	G_ALT      = 3,
+	G_GROUP    = 4,
+	G_NOTHING  = 5,
+};
+
+struct GrammarNode {
+	int kind;
+	int value;  // terminal or rule index
+	char suffix; // of a group: '*', '+', '?' or 0
+	int child;
+	int next;
+};
+
+struct Terminal {
+	char type[MAX_NAME]; // T_OP, T_ID, T_NUMBER, T_END
+	char op  [MAX_NAME]; // op code name or char literal, "0" for non-ops
+};
+
+#define OPDEF(name, code, str, key_1, key_2) {#name, str},
+
+struct OpSpelling {
+	const char *name;
+	const char *str;
+};
+
+static const OpSpelling OP_SPELLINGS[] = {
+	#include "opcodes.h"
+};
+
+#undef OPDEF
+
+#define PARSE_RULE(name, memoized) #name,
+
+static const char *const PARSER_RULES[] = {
+	#include "parse_rules.h"
+};
+
+#undef PARSE_RULE
+
+// data =======================================================================
+static GrammarNode nodes[MAX_NODES];
+static int         node_cnt;
+
+static Terminal    terms[MAX_SYMBOLS];
+static int         term_cnt;
+
+static char        rule_names[MAX_SYMBOLS][MAX_NAME];
+static int         rule_body [MAX_SYMBOLS];
+static int         rule_cnt;
+
+static bool        first   [MAX_SYMBOLS][MAX_SYMBOLS];
+static bool        nullable[MAX_SYMBOLS];
+
+static const char *cur;
+static int         cur_line;
+//=============================================================================
+
+static void fail(const char *message, const char *detail) {
+	fprintf(stderr, "[ERR]<grammar_gen>: grammar.gr line [%d]: %s [%s]\n", cur_line, message, detail);
+	exit(EXIT_FAILURE);
+}
+
+static int new_node(const int kind, const int value) {
+	if (node_cnt == MAX_NODES) {
+		fail("too many grammar nodes", "");
+	}
+
+	nodes[node_cnt] = {kind, value, 0, -1, -1};
+	return node_cnt++;
+}
+
+static int rule_index(const char *name) {
+	for (int i = 0; i < rule_cnt; ++i) {
+		if (!strcmp(rule_names[i], name)) {
+			return i;
+		}
+	}
+
+	if (rule_cnt == MAX_SYMBOLS) {
+		fail("too many rules", name);
+	}
+
+	strcpy(rule_names[rule_cnt], name);
+	rule_body[rule_cnt] = -1;
+	return rule_cnt++;
+}
+
+static int term_index(const char *type, const char *op) {
+	for (int i = 0; i < term_cnt; ++i) {
+		if (!strcmp(terms[i].type, type) && !strcmp(terms[i].op, op)) {
+			return i;
+		}
+	}
+
+	if (term_cnt == MAX_SYMBOLS) {
+		fail("too many terminals", op);
+	}
+
+	strcpy(terms[term_cnt].type, type);
+	strcpy(terms[term_cnt].op,   op);
+	return term_cnt++;
+}
+
+static int op_terminal(const char *spelling) {
+	for (const OpSpelling &op : OP_SPELLINGS) {
+		if (op.str[0] && !strcmp(op.str, spelling)) {
+			return term_index("T_OP", op.name);
+		}
+	}
+
+	if (strlen(spelling) != 1) {
+		fail("unknown token", spelling);
+	}
+
+	char literal[8] = {};
+	if (spelling[0] == '\'' || spelling[0] == '\\') {
+		sprintf(literal, "'\\%c'", spelling[0]);
+	} else {
+		sprintf(literal, "'%c'", spelling[0]);
+	}
+	return term_index("T_OP", literal);
+}
+
+// Rule text ==================================================================
+
+static void skip_blanks() {
+	while (*cur == ' ' || *cur == '\t') {
+		++cur;
+	}
+}
+
+static int parse_alt();
+
+static int parse_item() {
+	skip_blanks();
+
+	if (*cur == '\'') {
+		const char *end = strchr(cur + 1, '\'');
+		if (!end || end == cur + 1 || end - cur > MAX_NAME) {
+			fail("bad quoted token", cur);
+		}
+
+		char spelling[MAX_NAME] = {};
+		strncpy(spelling, cur + 1, (size_t) (end - cur - 1));
+		cur = end + 1;
+		return new_node(G_TERMINAL, op_terminal(spelling));
+	}
+
+	if (*cur == '%') {
+		int term = -1;
+		if      (!strncmp(cur, "%id",     3)) { term = term_index("T_ID",     "0"); cur += 3; }
+		else if (!strncmp(cur, "%number", 7)) { term = term_index("T_NUMBER", "0"); cur += 7; }
+		else if (!strncmp(cur, "%end",    4)) { term = term_index("T_END",    "0"); cur += 4; }
+		else {
+			fail("unknown lexer token", cur);
+		}
+		return new_node(G_TERMINAL, term);
+	}
+
+	if (!strncmp(cur, "\\nothing", 8)) {
+		cur += 8;
+		return new_node(G_NOTHING, 0);
+	}
+
+	if (*cur == '{') {
+		++cur;
+		int group = new_node(G_GROUP, 0);
+		nodes[group].child = parse_alt();
+
+		skip_blanks();
+		if (*cur != '}') {
+			fail("expected '}'", cur);
+		}
+		++cur;
+
+		if (*cur == '*' || *cur == '+' || *cur == '?') {
+			nodes[group].suffix = *cur++;
+		}
+		return group;
+	}
+
+	if (isupper(*cur) || *cur == '_') {
+		char name[MAX_NAME] = {};
+		int len = 0;
+		while ((isupper(*cur) || *cur == '_') && len < MAX_NAME - 1) {
+			name[len++] = *cur++;
+		}
+		return new_node(G_RULE, rule_index(name));
+	}
+
+	fail("unexpected text", cur);
+	return -1;
+}
+
+static int parse_seq() {
+	int seq  = new_node(G_SEQ, 0);
+	int last = -1;
+
+	skip_blanks();
+	while (*cur && *cur != '|' && *cur != '}') {
+		int item = parse_item();
+		if (last < 0) {
+			nodes[seq].child = item;
+		} else {
+			nodes[last].next = item;
+		}
+		last = item;
+		skip_blanks();
+	}
+
+	return seq;
+}
+
+static int parse_alt() {
+	int alt  = new_node(G_ALT, 0);
+	int last = parse_seq();
+	nodes[alt].child = last;
+
+	while (*cur == '|') {
+		++cur;
+		int seq = parse_seq();
+		nodes[last].next = seq;
+		last = seq;
+	}
+
+	return alt;
+}
+
+// FIRST sets =================================================================
+
+// adds FIRST(node) to set, returns whether node derives nothing
+static bool collect(const int node, bool *set, bool *changed) {
+	const GrammarNode &n = nodes[node];
+	switch (n.kind) {
+		case G_NOTHING:
+			return true;
+
+		case G_TERMINAL:
+			if (!set[n.value]) {
+				set[n.value] = true;
+				*changed = true;
+			}
+			return false;
+
+		case G_RULE:
+			for (int i = 0; i < term_cnt; ++i) {
+				if (first[n.value][i] && !set[i]) {
+					set[i] = true;
+					*changed = true;
+				}
+			}
+			return nullable[n.value];
+
+		case G_SEQ:
+			for (int item = n.child; item >= 0; item = nodes[item].next) {
+				if (!collect(item, set, changed)) {
+					return false;
+				}
+			}
+			return true;
+
+		case G_ALT: {
+			bool empty = false;
+			for (int seq = n.child; seq >= 0; seq = nodes[seq].next) {
+				empty |= collect(seq, set, changed);
+			}
+			return empty;
+		}
+
+		case G_GROUP:
+			return collect(n.child, set, changed) || n.suffix == '*' || n.suffix == '?';
+	}
+
+	return false;
+}
+
+static void compute_first() {
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (int rule = 0; rule < rule_cnt; ++rule) {
+			bool empty = collect(rule_body[rule], first[rule], &changed);
+			if (empty && !nullable[rule]) {
+				nullable[rule] = true;
+				changed = true;
+			}
+		}
+	}
+}
+
+// Main =======================================================================
+
+static void read_grammar(char *text) {
+	int rule = -1;
+	char *line = text;
+	for (cur_line = 1; line; ++cur_line) {
+		char *line_end = strchr(line, '\n');
+		if (line_end) {
+			*line_end = '\0';
+		}
+
+		const char *rule_sep = strstr(line, "::=");
+		if (rule_sep && (isupper(*line) || *line == '_')) {
+			char name[MAX_NAME] = {};
+			sscanf(line, "%63[A-Z_]", name);
+			rule = rule_index(name);
+			if (rule_body[rule] >= 0) {
+				fail("rule defined twice", name);
+			}
+
+			cur = rule_sep + 3;
+			rule_body[rule] = parse_alt();
+		} else if ((*line == ' ' || *line == '\t') && rule >= 0) {
+			cur = line;
+			skip_blanks();
+			if (*cur == '|') {
+				int last = nodes[rule_body[rule]].child;
+				while (nodes[last].next >= 0) {
+					last = nodes[last].next;
+				}
+
+				++cur;
+				nodes[last].next = parse_seq();
+			} else if (*cur) {
+				fail("continuation line must start with '|'", cur);
+			}
+		} else {
+			rule = -1;
+		}
+
+		if (rule >= 0 && *cur) {
+			fail("unexpected text", cur);
+		}
+
+		line = line_end ? line_end + 1 : nullptr;
+	}
+}
+
+int main(const int argc, const char **argv) {
+	if (argc != 3) {
+		fprintf(stderr, "usage: %s grammar.gr grammar_first.h\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	FILE *in = fopen(argv[1], "r");
+	if (!in) {
+		fprintf(stderr, "[ERR]<grammar_gen>: can't open [%s]\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	static char text[MAX_TEXT];
+	size_t length = fread(text, 1, MAX_TEXT - 1, in);
+	fclose(in);
+	text[length] = '\0';
+
+	read_grammar(text);
+
+	for (int i = 0; i < rule_cnt; ++i) {
+		if (rule_body[i] < 0) {
+			fail("rule is used but never defined", rule_names[i]);
+		}
+	}
+
+	for (const char *name : PARSER_RULES) {
+		bool defined = false;
+		for (int i = 0; i < rule_cnt; ++i) {
+			defined |= !strcmp(rule_names[i], name);
+		}
+		if (!defined) {
+			fail("parser rule from parse_rules.h is not in the grammar", name);
+		}
+	}
+
+	compute_first();
+
+	FILE *out = fopen(argv[2], "w");
+	if (!out) {
+		fprintf(stderr, "[ERR]<grammar_gen>: can't open [%s]\n", argv[2]);
+		return EXIT_FAILURE;
+	}
+
+	fprintf(out, "// generated by grammar_gen from %s, do not edit\n", argv[1]);
+	fprintf(out, "// GRAMMAR_RULE(name, nullable)\n");
+	fprintf(out, "// GRAMMAR_FIRST(name, token_type, op) - a token the rule can start with\n");
+
+	for (const char *name : PARSER_RULES) {
+		int rule = rule_index(name);
+		fprintf(out, "\nGRAMMAR_RULE(%s, %d)\n", name, nullable[rule]);
+		for (int i = 0; i < term_cnt; ++i) {
+			if (first[rule][i]) {
+				fprintf(out, "GRAMMAR_FIRST(%s, %s, %s)\n", name, terms[i].type, terms[i].op);
+			}
+		}
+	}
+
+	fclose(out);
+	return 0;
+}
@@ -1,22 +1,161 @@
 #include "id_table.h"
 
+const int ID_TABLE_INIT_HEADS = 256;
+
 void IdTable::add_scope(const int offset, const int functive) {
-	IdTableScope *scope = IdTableScope::NEW(offset, functive);
+	IdTableScope *scope = scope_pool.get();
+	scope->ctor(offset, functive);
+	scope->first_entry = (int) undo_log.size();
+	if (data.size()) {
+		const IdTableScope *below = data[data.size() - 1];
+		scope->base = below->base + below->offset;
+	}
+
 	data.push_back(scope);
+	if (functive == FUNC_SCOPE) {
+		functives.push_back((int) data.size() - 1);
+	}
+}
+
+int IdTable::head(const int id) const {
+	return (id >= 0 && id < head_cnt) ? heads[id] : NO_BINDING;
+}
+
+int IdTable::find_binding(const int type, const int id, const int scope) const {
+	for (int b = head(id); b != NO_BINDING; b = bindings[(size_t) b].prev) {
+		if (bindings[(size_t) b].scope <= scope && bindings[(size_t) b].type == type) {
+			return b;
+		}
+	}
+
+	return NO_BINDING;
+}
+
+int IdTable::new_binding(const IdData &idat) {
+	if (free_binding == NO_BINDING) {
+		bindings.push_back(idat);
+		return (int) bindings.size() - 1;
+	}
+
+	int binding = free_binding;
+	free_binding = bindings[(size_t) binding].prev;
+	bindings[(size_t) binding] = idat;
+	return binding;
+}
+
+// the chain stays sorted by scope, innermost first, so the bindings of the top
+// scope are always the heads remove_scope() takes off
+void IdTable::link(const int binding) {
+	IdData &idat = bindings[(size_t) binding];
+	if (idat.id == NO_SYMBOL) {
+		return;
+	}
+
+	if (idat.id >= head_cnt) {
+		int new_cnt = head_cnt ? head_cnt : ID_TABLE_INIT_HEADS;
+		while (new_cnt <= idat.id) {
+			new_cnt *= 2;
+		}
+
+		int *new_heads = (int*) realloc(heads, (size_t) new_cnt * sizeof(int));
+		if (!new_heads) {
+			throw std::length_error("[ERR]<id_table>: heads alloc fail");
+		}
+
+		for (int i = head_cnt; i < new_cnt; ++i) {
+			new_heads[i] = NO_BINDING;
+		}
+		heads    = new_heads;
+		head_cnt = new_cnt;
+	}
+
+	int *place = &heads[idat.id];
+	while (*place != NO_BINDING && bindings[(size_t) *place].scope > idat.scope) {
+		place = &bindings[(size_t) *place].prev;
+	}
+
+	idat.prev = *place;
+	*place = binding;
+}
+
+void IdTable::unlink(const int binding) {
+	const IdData &idat = bindings[(size_t) binding];
+	if (idat.id != NO_SYMBOL) {
+		int *place = &heads[idat.id];
+		while (*place != binding) {
+			place = &bindings[(size_t) *place].prev;
+		}
+		*place = idat.prev;
+	}
+
+	bindings[(size_t) binding].prev = free_binding;
+	free_binding = binding;
+}
+
+void IdTable::log_entry(const int scope, const int binding) {
+	undo_log.push_back(binding);
+
+	const int scope_cnt = (int) data.size();
+	if (scope == scope_cnt - 1) {
+		return;
+	}
+
+	// a declaration below the top scope goes to the end of its scope's slice
+	const int place = data[(size_t) scope + 1]->first_entry;
+	for (int i = (int) undo_log.size() - 1; i > place; --i) {
+		undo_log[(size_t) i] = undo_log[(size_t) i - 1];
+	}
+	undo_log[(size_t) place] = binding;
+
+	for (int i = scope + 1; i < scope_cnt; ++i) {
+		++data[(size_t) i]->first_entry;
+	}
+}
+
+void IdTable::grow_scope(const int scope, const int size) {
+	data[(size_t) scope]->offset += size;
+
+	const int scope_cnt = (int) data.size();
+	for (int i = scope + 1; i < scope_cnt; ++i) {
+		data[(size_t) i]->base += size;
+	}
+}
+
+int IdTable::var_cnt_between(const int from, const int to) const {
+	if (from > to) {
+		return 0;
+	}
+
+	return data[(size_t) to]->base + data[(size_t) to]->offset - data[(size_t) from]->base;
 }
 
 IdTable::IdTable():
 data(),
+scope_pool(),
 cur_scope(0),
-var_cnt(0)
+var_cnt(0),
+bindings(),
+free_binding(NO_BINDING),
+heads(nullptr),
+head_cnt(0),
+undo_log(),
+functives()
 {}
 
 IdTable::~IdTable() {}
 
 void IdTable::ctor() {
 	data.ctor();
+	scope_pool.ctor();
 	cur_scope = 0;
 	var_cnt = 0;
+
+	bindings.ctor();
+	free_binding = NO_BINDING;
+	heads        = nullptr;
+	head_cnt     = 0;
+	undo_log.ctor();
+	functives.ctor();
 }
 
 IdTable *IdTable::NEW() {
@@ -31,10 +170,18 @@ IdTable *IdTable::NEW() {
 
 void IdTable::dtor() {
 	for (int i = (int) data.size() - 1; i >= 0; --i) {
-		IdTableScope::DELETE(data[i]);
+		data[i]->dtor();
 		data.pop_back();
 	}
 	data.dtor();
+	scope_pool.dtor();
+
+	bindings.dtor();
+	free(heads);
+	heads    = nullptr;
+	head_cnt = 0;
+	undo_log.dtor();
+	functives.dtor();
 }
 
 void IdTable::DELETE(IdTable *table) {
@@ -49,61 +196,45 @@ void IdTable::DELETE(IdTable *table) {
 //=============================================================================
 
 int IdTable::find_first_functive() const {
-	const int data_size = (int) data.size();
-	for (int i = 0; i < data_size; ++i) {
-		if (data[i]->is_functive() == FUNC_SCOPE) {
-			return i;
-		}
-	}
-
-	return data_size;
+	return functives.size() ? functives[0] : (int) data.size();
 }
 
 int IdTable::find_last_functive() const {
-	const int data_size = (int) data.size();
-	for (int i = data_size - 1; i >= 0; --i) {
-		if (data[i]->is_functive() == FUNC_SCOPE) {
-			return i;
-		}
-	}
-
-	return 0;
+	return functives.size() ? functives[functives.size() - 1] : 0;
 }
 
-int IdTable::find_var(const StringView *id, int *res) const {
+int IdTable::find_var(const int id, int *res, AstNode *value) const {
 	if (!data.size()) {
 		return NOT_FOUND;
 	}
 
-	int offset = NOT_FOUND;
-	int found_index = -1;
-	int first_functive = find_first_functive();
-	int last_functive  = find_last_functive();
+	const int first_functive = find_first_functive();
+	const int last_functive  = find_last_functive();
 
-	for (int i = cur_scope; i >= 0; --i) {
-		offset = data[i]->find(ID_TYPE_VAR, id);
-		if (offset != NOT_FOUND && (i < first_functive || i >= last_functive)) {
-			found_index = i;
+	// the innermost var visible from cur_scope that is not in a function between the outermost and the current one
+	int found = NO_BINDING;
+	for (int b = head(id); b != NO_BINDING; b = bindings[(size_t) b].prev) {
+		const IdData &idat = bindings[(size_t) b];
+		if (idat.scope <= cur_scope && idat.type == ID_TYPE_VAR && (idat.scope < first_functive || idat.scope >= last_functive)) {
+			found = b;
 			break;
 		}
 	}
 
-	if (offset == NOT_FOUND) {
+	if (found == NO_BINDING) {
 		return NOT_FOUND;
 	}
 
-	if (data[found_index]->is_functive() == ARG_SCOPE) {
-		bool to_add_offset = false;
-		for (int i = found_index - 1; i >= 0; --i) {
-			if (data[i]->is_functive() == FUNC_SCOPE) {
-				to_add_offset = true;
-			}
-		}
+	if (value) {
+		*value = bindings[(size_t) found].arglist;
+	}
 
-		if (found_index > last_functive && to_add_offset) {
-			for (int i = found_index - 1; i >= last_functive; --i) {
-				offset += data[i]->get_var_cnt();
-			}
+	int offset = bindings[(size_t) found].slot;
+	const int found_index = bindings[(size_t) found].scope;
+
+	if (data[(size_t) found_index]->is_functive() == ARG_SCOPE) {
+		if (found_index > last_functive && first_functive < found_index) {
+			offset += var_cnt_between(last_functive, found_index - 1);
 		}
 
 		*res = offset;
@@ -115,84 +246,99 @@ int IdTable::find_var(const StringView *id, int *res) const {
 		return ID_TYPE_GLOBAL;
 	}
 
-	for (int i = found_index - 1; i >= last_functive; --i) {
-		offset += data[i]->get_var_cnt();
-	}
-
-	*res = offset;
+	*res = offset + var_cnt_between(last_functive, found_index - 1);
 	return ID_TYPE_FOUND;
 }
 
-int IdTable::find_func(const StringView *id) const {
-	for (int i = cur_scope; i >= 0; --i) {
-		int offset = data[i]->find(ID_TYPE_FUNC, id);
-		if (offset != NOT_FOUND) {
-			return offset;
-		}
-	}
-
-	return NOT_FOUND;
+int IdTable::find_func(const int id) const {
+	const int binding = find_binding(ID_TYPE_FUNC, id, cur_scope);
+	return binding == NO_BINDING ? NOT_FOUND : bindings[(size_t) binding].offset;
 }
 
-int IdTable::find_in_upper_scope(const int type, const StringView *id) const {
+int IdTable::find_in_upper_scope(const int type, const int id) const {
 	if (!data.size()) {
 		return NOT_FOUND;
 	}
 
-	return data[cur_scope]->find(type, id);
-}
-
-int IdTable::find_from_prev(const int type, const StringView *id) const {
-	for (int i = cur_scope - 1; i >= 0; --i) {
-		int offset = data[i]->find(type, id);
-		if (offset != NOT_FOUND) {
-			return offset;
+	for (int b = head(id); b != NO_BINDING && bindings[(size_t) b].scope >= cur_scope; b = bindings[(size_t) b].prev) {
+		const IdData &idat = bindings[(size_t) b];
+		if (idat.scope == cur_scope && idat.type == type) {
+			return idat.found_offset();
 		}
 	}
 
 	return NOT_FOUND;
 }
 
+int IdTable::find_from_prev(const int type, const int id) const {
+	const int binding = find_binding(type, id, cur_scope - 1);
+	return binding == NO_BINDING ? NOT_FOUND : bindings[(size_t) binding].found_offset();
+}
+
 int IdTable::get_func_offset() const {
-	int offset = 0;
-	for (int i = cur_scope; i >= 0; --i) {
-		offset += data[i]->get_var_cnt();
-		if (data[i]->is_functive() == FUNC_SCOPE) {
-			return offset;
+	for (int i = (int) functives.size() - 1; i >= 0; --i) {
+		if (functives[(size_t) i] <= cur_scope) {
+			return var_cnt_between(functives[(size_t) i], cur_scope);
 		}
 	}
 
 	return 0;
 }
 
-const CodeNode *IdTable::get_arglist(const StringView *id) {
-	for (int i = cur_scope; i >= 0; --i) {
-		if (const CodeNode *arglist = data[i]->get_arglist(id)) {
-			return arglist;
+AstNode IdTable::get_arglist(const int id) const {
+	for (int b = head(id); b != NO_BINDING; b = bindings[(size_t) b].prev) {
+		const IdData &idat = bindings[(size_t) b];
+		if (idat.scope <= cur_scope && idat.type == ID_TYPE_FUNC && idat.arglist) {
+			return idat.arglist;
 		}
 	}
 
 	return nullptr;
 }
 
-bool IdTable::declare(const int type, const StringView *id, const int size, const CodeNode *arglist) {
+bool IdTable::declare(const int type, const int id, const int size, AstNode arglist) {
 	if (!data.size()) {
 		RAISE_ERROR("no scope to declare a variable in\n");
 		return false;
 	}
 
-	return data[cur_scope]->declare(type, id, size, arglist);
+	for (int b = head(id); b != NO_BINDING && bindings[(size_t) b].scope >= cur_scope; b = bindings[(size_t) b].prev) {
+		if (bindings[(size_t) b].scope == cur_scope) {
+			return false;
+		}
+	}
+
+	IdTableScope *scope = data[(size_t) cur_scope];
+
+	IdData idat = {};
+	idat.ctor(type, id, size, arglist);
+	idat.slot  = scope->entry_sum;
+	idat.scope = cur_scope;
+
+	const int binding = new_binding(idat);
+	link(binding);
+	log_entry(cur_scope, binding);
+
+	scope->entry_sum += size;
+	if (type != ID_TYPE_FUNC) {
+		grow_scope(cur_scope, size);
+	}
+	return true;
 }
 
-bool IdTable::declare_func(const StringView *id, const CodeNode *arglist, const int offset) {
+bool IdTable::declare_func(const int id, AstNode arglist, const int offset) {
 	return declare(ID_TYPE_FUNC, id, offset, arglist);
 }
 
-bool IdTable::declare_var(const StringView *id, const int size, const CodeNode *fields) {
+bool IdTable::declare_var(const int id, const int size, AstNode fields) {
 	return declare(ID_TYPE_VAR, id, size, fields);
 }
 
-bool IdTable::declare_struct(const StringView *id, const CodeNode *fields) {
+bool IdTable::declare_const(const int id, AstNode value) {
+	return declare(ID_TYPE_VAR, id, 0, value);
+}
+
+bool IdTable::declare_struct(const int id, AstNode fields) {
 	return declare(ID_TYPE_STRUCT, id, 0, fields);
 }
 
@@ -201,7 +347,11 @@ bool IdTable::add_buffer_zone(const int zone_size) {
 		RAISE_ERROR("adding buffer zone with on scopes alive\n");
 		return false;
 	}
-	return data[cur_scope]->add_buffer_zone(zone_size);
+
+	log_entry(cur_scope, NO_BINDING);
+	data[(size_t) cur_scope]->entry_sum += zone_size;
+	grow_scope(cur_scope, zone_size);
+	return true;
 }
 
 void IdTable::add_scope(int functive) {
@@ -214,7 +364,20 @@ void IdTable::remove_scope() {
 		RAISE_ERROR("removing unexistant scope\n");
 		return;
 	} else {
-		IdTableScope::DELETE(data[data.size() - 1]);
+		IdTableScope *scope = data[data.size() - 1];
+		while ((int) undo_log.size() > scope->first_entry) {
+			const int binding = undo_log.pop_back();
+			if (binding != NO_BINDING) {
+				unlink(binding);
+			}
+		}
+
+		if (scope->is_functive() == FUNC_SCOPE) {
+			functives.pop_back();
+		}
+
+		scope->dtor();
+		scope_pool.put(scope);
 		data.pop_back();
 	}
 	cur_scope = (int)data.size() - 1;
@@ -238,13 +401,23 @@ bool IdTable::shift_forward() {
 	}
 }
 
-int IdTable::size() {
+int IdTable::size() const {
 	return (int) data.size();
 }
 
 void IdTable::dump() const {
 	for (size_t i = 0; i < data.size(); ++i) {
 		printf("-----[%lu]\n", i);
-		data[i]->dump();
+
+		const int first = data[i]->first_entry;
+		const int last  = i + 1 < data.size() ? data[i + 1]->first_entry : (int) undo_log.size();
+		for (int j = first; j < last; ++j) {
+			printf("[%d] ", j - first);
+			const int binding = undo_log[(size_t) j];
+			if (binding != NO_BINDING && bindings[(size_t) binding].id != NO_SYMBOL) {
+				SYMBOL_POOL.get(bindings[(size_t) binding].id)->print();
+			}
+			printf("\n");
+		}
 	}
 }
@@ -5,21 +5,49 @@
 
 #include "general/c/announcement.h"
 #include "general/cpp/vector.hpp"
+#include "general/cpp/pool.hpp"
 
 //=============================================================================
 // IdTable ===================================================================
 
+// Every declaration is a binding in one table. The bindings of a symbol are
+// chained innermost scope first from heads[symbol], so a lookup looks only at
+// the declarations of its own name. Symbols are dense SYMBOL_POOL ids, so heads
+// is indexed by them directly. A scope's declarations are its slice of the undo
+// log, and remove_scope() unlinks them from there.
+
 class IdTable {
 private:
 // data =======================================================================
 	Vector<IdTableScope*> data;
+	Pool<IdTableScope>    scope_pool; // scopes come and go with every block
 	int cur_scope;
 	int var_cnt;
+
+	Vector<IdData> bindings;
+	int            free_binding; // unused bindings, chained through prev
+	int           *heads;        // symbol -> its innermost binding
+	int            head_cnt;
+	Vector<int>    undo_log;     // bindings in the order of their scopes, NO_BINDING for buffer zones
+	Vector<int>    functives;    // FUNC_SCOPE scopes, innermost last
 //=============================================================================
 
 	void add_scope(const int offset, const int functive);
 
+	int  head(const int id) const;
+	int  find_binding(const int type, const int id, const int scope) const; // the innermost one at or below scope
+	int  new_binding(const IdData &idat);
+	void link(const int binding);
+	void unlink(const int binding);
+	void log_entry(const int scope, const int binding);
+	void grow_scope(const int scope, const int size);
+
+	int  var_cnt_between(const int from, const int to) const; // of the scopes [from, to]
+
 public:
+	IdTable            (const IdTable&) = delete;
+	IdTable &operator= (const IdTable&) = delete;
+
 	IdTable ();
 	~IdTable();
 
@@ -33,20 +61,21 @@ public:
 	int find_first_functive() const;
 	int find_last_functive () const;
 
-	int find_var	(const StringView *id, int *res) const;
-	int find_func 	(const StringView *id) const;
+	int find_var	(const int id, int *res, AstNode *value = nullptr) const; // value is the one of a const, null for a var
+	int find_func 	(const int id) const;
 
-	int find_in_upper_scope(const int type, const StringView *id) const;
-	int find_from_prev	   (const int type, const StringView *id) const;
+	int find_in_upper_scope(const int type, const int id) const;
+	int find_from_prev	   (const int type, const int id) const;
 
 	int get_func_offset() const;
 
-	const CodeNode *get_arglist(const StringView *id);
+	AstNode get_arglist(const int id) const;
 
-	bool declare 		(const int type, const StringView *id, const int size, const CodeNode *arglist = nullptr);
-	bool declare_func	(const StringView *id, const CodeNode *arglist, const int offset = 0);
-	bool declare_var	(const StringView *id, const int size, const CodeNode *fields = nullptr);
-	bool declare_struct	(const StringView *id, const CodeNode *fields);
+	bool declare 		(const int type, const int id, const int size, AstNode arglist = nullptr);
+	bool declare_func	(const int id, AstNode arglist, const int offset = 0);
+	bool declare_var	(const int id, const int size, AstNode fields = nullptr);
+	bool declare_const	(const int id, AstNode value); // a var that takes no slot, its uses are value
+	bool declare_struct	(const int id, AstNode fields);
 
 	bool add_buffer_zone(const int zone_size);
 	void add_scope(int functive = 0);
@@ -55,7 +84,7 @@ public:
 	bool shift_backward();
 	bool shift_forward();
 
-	int size();
+	int size() const;
 	void dump() const;
 };
 
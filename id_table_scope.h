@@ -4,7 +4,7 @@
 #include "general/cpp/stringview.hpp"
 #include "general/cpp/vector.hpp"
 
-#include "code_node.h"
+#include "flat_ast.h"
 
 enum ID_TYPE {
 	ID_TYPE_NONE   = 0,
@@ -21,33 +21,43 @@ enum SCOPE_TYPE {
 	FUNC_SCOPE = 2,
 };
 
+const int NO_BINDING = -1;
+
+// one declaration of a name, IdTable chains the ones of a symbol innermost first
 struct IdData {
 	int type;
-	const StringView *id;
-	int offset;
-	const CodeNode *arglist;
+	int id; // symbol
+	int offset; // size of a var, label of a func
+	int slot;   // sum of the offsets declared before it in its scope
+	int scope;
+	int prev;   // binding of the same symbol in a scope below, NO_BINDING at the bottom
+	AstNode arglist;
 
 	IdData();
 
 	IdData& operator=(const IdData& other);
-	void ctor(int type_, const StringView *id_, const int offset_, const CodeNode *arglist_ = nullptr);
-	bool equal(const IdData &other);
+	void ctor(int type_, const int id_, const int offset_, AstNode arglist_ = nullptr);
+
+	int found_offset() const; // what a lookup of this binding gives
 };
 
 //=============================================================================
 // IdTableScope ==============================================================
+// The bookkeeping of one scope. Its bindings live in IdTable, and the ones it
+// declared are its slice of IdTable's undo log, from first_entry on.
 
 class IdTableScope {
 private:
 // data =======================================================================
-	Vector<IdData> data;
-	int var_cnt;
 	int functive;
 //=============================================================================
 
 
 public:
-	int offset;
+	int offset;      // var slots the scope takes
+	int entry_sum;   // slot of the next declaration
+	int base;        // var slots of the scopes below it
+	int first_entry; // in the undo log
 
 	IdTableScope ();
 	~IdTableScope();
@@ -59,21 +69,8 @@ public:
 	static void DELETE(IdTableScope *scope);
 //=============================================================================
 
-	bool find_id(const StringView *id) const;
-	
-	int find(const int type, const StringView *id) const;
-
 	int get_var_cnt() const;
-
-	bool declare(const int type, const StringView *id, const int size, const CodeNode *arglist_ = nullptr);
-
-	bool add_buffer_zone(const int zone_size);
-
-	const CodeNode *get_arglist(const StringView *id);
-
-	int size();
-	int is_functive();
-	void dump();
+	int is_functive() const;
 };
 
 #endif // ID_TABLE_SCOPE
@@ -0,0 +1,334 @@
+#include "ir.h"
+
+#include <climits>
+
+static const char *IR_MNEMONIC[IR_OPCODE_CNT] = {
+	nullptr,
+	"push",  "pop",
+	"add",   "sub",   "mul",   "div",   "pow",
+	"lt",    "gt",    "le",    "ge",    "eq",    "neq",
+	"l_or",  "l_and",
+	"jmp",   "je",    "jne",   "call",  "ret",
+	"swp",   "dup",   "out",   "out_c", "in",    "halt",
+	"bin_op",
+	"g_init", "g_draw", "g_fill",
+	nullptr, nullptr, nullptr
+};
+
+static const char *IR_REGISTER_NAME[] = {
+	"", "rax", "rbx", "rcx", "rvx", "rmx", "rzx"
+};
+
+int ir_stack_op(const int op) {
+	switch (op) {
+		case '+'         : return IR_ADD;
+		case '-'         : return IR_SUB;
+		case '*'         : return IR_MUL;
+		case '/'         : return IR_DIV;
+		case '^'         : return IR_POW;
+		case '<'         : return IR_LT;
+		case '>'         : return IR_GT;
+		case OPCODE_LE   : return IR_LE;
+		case OPCODE_GE   : return IR_GE;
+		case OPCODE_EQ   : return IR_EQ;
+		case OPCODE_NEQ  : return IR_NEQ;
+		case OPCODE_OR   : return IR_L_OR;
+		case OPCODE_AND  : return IR_L_AND;
+		default          : return IR_NONE;
+	}
+}
+
+bool ir_is_jump(const int op) {
+	return op == IR_JMP || op == IR_JE || op == IR_JNE || op == IR_CALL;
+}
+
+bool ir_ends_block(const int op) {
+	return op == IR_JMP || op == IR_RET || op == IR_HALT;
+}
+
+bool ir_reads(const Instruction &instr, const int r) {
+	if (instr.op == IR_G_INIT) { // the size is in rax and rbx
+		return r == REG_RAX || r == REG_RBX;
+	}
+
+	const Operand &operand = instr.operand;
+	if (operand.reg != r) {
+		return false;
+	}
+
+	switch (operand.kind) {
+		case OPND_REG : return instr.op == IR_PUSH;
+		case OPND_REG_PLUS :
+		case OPND_MEM :
+		case OPND_MEM_PLUS :
+		case OPND_PIXEL : return true;
+		default : return false;
+	}
+}
+
+bool ir_same_operand(const Operand &a, const Operand &b) {
+	if (a.kind != b.kind || a.reg != b.reg) {
+		return false;
+	}
+
+	switch (a.kind) {
+		case OPND_NONE :
+		case OPND_REG :
+		case OPND_MEM :
+		case OPND_PIXEL : return true;
+		case OPND_NUM   : return a.num == b.num;
+		case OPND_LABEL : return a.label == b.label && a.value == b.value && a.sym == b.sym;
+		default         : return a.value == b.value;
+	}
+}
+
+bool ir_const(const Operand &operand, double *value) {
+	if (operand.kind == OPND_INT) {
+		*value = operand.value;
+		return true;
+	} else if (operand.kind == OPND_NUM) {
+		*value = operand.num;
+		return true;
+	}
+
+	return false;
+}
+
+bool ir_fold(const int op, const double a, const double b, double *result) {
+	switch (op) {
+		case IR_ADD   : *result = a + b; break;
+		case IR_SUB   : *result = a - b; break;
+		case IR_MUL   : *result = a * b; break;
+		case IR_DIV   : *result = a / b; break;
+		case IR_POW   : *result = pow(a, b); break;
+		case IR_LT    : *result = a <  b; break;
+		case IR_GT    : *result = a >  b; break;
+		case IR_LE    : *result = a <= b; break;
+		case IR_GE    : *result = a >= b; break;
+		case IR_EQ    : *result = a == b; break;
+		case IR_NEQ   : *result = a != b; break;
+		case IR_L_OR  : *result = a || b; break;
+		case IR_L_AND : *result = a && b; break;
+		default : return false;
+	}
+
+	return std::isfinite(*result);
+}
+
+// the text has no negative numbers
+bool ir_literal(const double value, Operand *operand) {
+	if (!(value >= 0) || std::signbit(value) || !std::isfinite(value)) {
+		return false;
+	}
+
+	if (value <= INT_MAX && value == (int) value) {
+		*operand = imm((int) value);
+		return true;
+	}
+
+	*operand = num_exact(value);
+	return true;
+}
+
+Operand num_exact(const double value) {
+	Operand operand = num(value);
+
+	char printed[32];
+	for (int digits = IR_NUM_DIGITS; digits < IR_EXACT_DIGITS; ++digits) {
+		snprintf(printed, sizeof(printed), "%.*g", digits, value);
+		if (strtod(printed, nullptr) == value) {
+			operand.digits = (char) (digits == IR_NUM_DIGITS ? 0 : digits);
+			return operand;
+		}
+	}
+
+	operand.digits = (char) IR_EXACT_DIGITS;
+	return operand;
+}
+
+//=============================================================================
+// IrProgram ==================================================================
+
+IrProgram::IrProgram():
+code(nullptr),
+cur_size(0),
+capacity(0)
+{}
+
+IrProgram::~IrProgram() {}
+
+void IrProgram::ctor() {
+	code     = nullptr;
+	cur_size = 0;
+	capacity = 0;
+}
+
+IrProgram *IrProgram::NEW() {
+	IrProgram *cake = (IrProgram*) calloc(1, sizeof(IrProgram));
+	if (!cake) {
+		return nullptr;
+	}
+
+	cake->ctor();
+	return cake;
+}
+
+void IrProgram::dtor() {
+	free(code);
+	code     = nullptr;
+	cur_size = 0;
+	capacity = 0;
+}
+
+void IrProgram::DELETE(IrProgram *program) {
+	if (!program) {
+		return;
+	}
+
+	program->dtor();
+	free(program);
+}
+
+//=============================================================================
+
+void IrProgram::grow() {
+	const int new_cap = capacity ? capacity * 2 : IR_INIT_CAPACITY;
+
+	Instruction *new_code = (Instruction*) realloc(code, (size_t) new_cap * sizeof(Instruction));
+	if (!new_code) {
+		throw std::length_error("[ERR]<ir>: code realloc fail");
+	}
+
+	code     = new_code;
+	capacity = new_cap;
+}
+
+void IrProgram::add_label(const Operand &name) {
+	add(IR_LABEL, name);
+}
+
+void IrProgram::add_blank() {
+	add(IR_BLANK);
+}
+
+void IrProgram::add_comment(const AstNode node) {
+	Operand operand = {};
+	operand.kind  = OPND_NODE;
+	operand.value = node.get_index();
+	add(IR_COMMENT, operand);
+}
+
+void IrProgram::clear() {
+	cur_size = 0;
+}
+
+int IrProgram::size() const {
+	return cur_size;
+}
+
+Instruction &IrProgram::operator[](const int i) {
+	return code[i];
+}
+
+const Instruction &IrProgram::operator[](const int i) const {
+	return code[i];
+}
+
+void IrProgram::compact() {
+	int kept = 0;
+	for (int i = 0; i < cur_size; ++i) {
+		if (code[i].op != IR_NONE) {
+			code[kept++] = code[i];
+		}
+	}
+
+	cur_size = kept;
+}
+
+//=============================================================================
+
+void IrProgram::print_operand(Emitter *out, const FlatAst *ast, const Operand &operand) const {
+	const char *reg_name = IR_REGISTER_NAME[(int) operand.reg];
+
+	switch (operand.kind) {
+		case OPND_INT      : out->put(operand.value); break;
+		case OPND_NUM      : out->put_double(operand.num, operand.digits ? operand.digits : IR_NUM_DIGITS); break;
+		case OPND_REG      : out->put(reg_name); break;
+		case OPND_REG_PLUS : out->put(reg_name, " + ", operand.value); break;
+		case OPND_MEM      : out->put('[', reg_name, ']'); break;
+		case OPND_MEM_PLUS : out->put('[', reg_name, " + ", operand.value, ']'); break;
+		case OPND_MEM_ABS  : out->put('[', operand.value, ']'); break;
+		case OPND_PIXEL    : out->put('(', reg_name, ')'); break;
+		case OPND_CHAR     : out->put((char) operand.value); break;
+		case OPND_NODE     : AstNode(ast, operand.value).space_dump(out); break;
+
+		case OPND_LABEL : {
+			const StringView *name = operand.sym != NO_SYMBOL ? SYMBOL_POOL.get(operand.sym) : nullptr;
+			const int         n    = operand.value;
+
+			switch (operand.label) {
+				case LABEL_WHILE_COND     : out->put("while_", n, "_cond"); break;
+				case LABEL_WHILE_END      : out->put("while_", n, "_end"); break;
+				case LABEL_IF_COND        : out->put("if_", n, "_cond"); break;
+				case LABEL_IF_TRUE        : out->put("if_", n, "_true"); break;
+				case LABEL_IF_FALSE       : out->put("if_", n, "_false"); break;
+				case LABEL_IF_END         : out->put("if_", n, "_end"); break;
+				case LABEL_FOR_INIT_BLOCK : out->put("for_", n, "_init_block"); break;
+				case LABEL_FOR_START      : out->put("for_", n, "_start"); break;
+				case LABEL_FOR_COND       : out->put("for_", n, "_cond"); break;
+				case LABEL_FOR_ACTION     : out->put("for_", n, "_action"); break;
+				case LABEL_FOR_END        : out->put("for_", n, "_end"); break;
+				case LABEL_LOGIC_SKIP     : out->put("logic_", n, "_skip"); break;
+				case LABEL_LOGIC_SHORT    : out->put("logic_", n, "_short"); break;
+				case LABEL_LOGIC_END      : out->put("logic_", n, "_end"); break;
+				case LABEL_FUNC           : out->put(name, '_', n); break;
+				case LABEL_FUNC_BEGIN     : out->put("_func_", name, '_', n, "_BEGIN"); break;
+				case LABEL_FUNC_END       : out->put("_func_", name, '_', n, "_END"); break;
+				default                   : break;
+			}
+			break;
+		}
+
+		default : break;
+	}
+}
+
+void IrProgram::print(Emitter *out, const FlatAst *ast) const {
+	for (int i = 0; i < cur_size; ++i) {
+		const Instruction &instr = code[i];
+
+		switch (instr.op) {
+			case IR_LABEL : {
+				print_operand(out, ast, instr.operand);
+				out->put(":\n");
+				break;
+			}
+
+			case IR_BLANK : {
+				out->put('\n');
+				break;
+			}
+
+			case IR_NONE : {
+				break;
+			}
+
+			case IR_COMMENT : {
+				out->put("\n; ");
+				print_operand(out, ast, instr.operand);
+				out->put('\n');
+				break;
+			}
+
+			default : {
+				out->put(IR_MNEMONIC[instr.op]);
+				if (instr.operand.kind != OPND_NONE) {
+					out->put(' ');
+					print_operand(out, ast, instr.operand);
+				}
+				out->put('\n');
+				break;
+			}
+		}
+	}
+}
@@ -0,0 +1,203 @@
+#ifndef IR_H
+#define IR_H
+
+#include <cstdlib>
+#include <stdexcept>
+
+#include "compiler_options.h"
+#include "symbol_pool.h"
+#include "flat_ast.h"
+#include "emitter.h"
+
+const int IR_INIT_CAPACITY = 1 << 12;
+const int IR_NUM_DIGITS    = 7;  // a number of the source prints with these
+const int IR_EXACT_DIGITS  = 17; // enough for any double to read back the same
+
+// SPU instructions and the pseudo ones that only shape the text
+enum IR_OPCODE {
+	IR_NONE = 0, // a removed instruction, dropped by compact()
+
+	IR_PUSH,
+	IR_POP,
+	IR_ADD,
+	IR_SUB,
+	IR_MUL,
+	IR_DIV,
+	IR_POW,
+	IR_LT,
+	IR_GT,
+	IR_LE,
+	IR_GE,
+	IR_EQ,
+	IR_NEQ,
+	IR_L_OR,
+	IR_L_AND,
+	IR_JMP,
+	IR_JE,
+	IR_JNE,
+	IR_CALL,
+	IR_RET,
+	IR_SWP,
+	IR_DUP,
+	IR_OUT,
+	IR_OUT_C,
+	IR_IN,
+	IR_HALT,
+	IR_BIN_OP,
+	IR_G_INIT,
+	IR_G_DRAW,
+	IR_G_FILL,
+
+	IR_LABEL,   // a label of its own: "label:"
+	IR_BLANK,   // an empty line
+	IR_COMMENT, // "; " and the source of an AST node, after an empty line
+
+	IR_OPCODE_CNT
+};
+
+enum IR_OPERAND {
+	OPND_NONE = 0,
+	OPND_INT,       // 42
+	OPND_NUM,       // a source value, 2.5
+	OPND_REG,       // rax
+	OPND_REG_PLUS,  // rvx + k, an address
+	OPND_MEM,       // [rax]
+	OPND_MEM_PLUS,  // [rvx + k]
+	OPND_MEM_ABS,   // [k]
+	OPND_PIXEL,     // (rax), the video memory at rax
+	OPND_CHAR,      // $
+	OPND_LABEL,
+	OPND_NODE,      // of a comment
+};
+
+enum IR_REGISTER {
+	REG_NONE = 0,
+	REG_RAX,
+	REG_RBX,
+	REG_RCX,
+	REG_RVX,
+	REG_RMX,
+	REG_RZX,
+};
+
+enum IR_LABEL_KIND {
+	LABEL_WHILE_COND = 0,
+	LABEL_WHILE_END,
+	LABEL_IF_COND,
+	LABEL_IF_TRUE,
+	LABEL_IF_FALSE,
+	LABEL_IF_END,
+	LABEL_FOR_INIT_BLOCK,
+	LABEL_FOR_START,
+	LABEL_FOR_COND,
+	LABEL_FOR_ACTION,
+	LABEL_FOR_END,
+	LABEL_LOGIC_SKIP,  // past the rest of a && or || chain
+	LABEL_LOGIC_SHORT, // where a && or || value is decided by an operand before the last
+	LABEL_LOGIC_END,
+	LABEL_FUNC,       // <name>_<n>, what a call jumps to
+	LABEL_FUNC_BEGIN, // _func_<name>_<n>_BEGIN
+	LABEL_FUNC_END,   // _func_<name>_<n>_END
+};
+
+// what an instruction works on; a label is its kind, number and, for funcs, name
+struct Operand {
+	char kind;  // IR_OPERAND
+	char reg;   // IR_REGISTER
+	char label; // IR_LABEL_KIND
+	char digits; // of a number, 0 for IR_NUM_DIGITS
+	int  sym;   // the func of a func label
+	union {
+		int    value; // int, offset, char, label number, node index
+		double num;
+	};
+};
+
+struct Instruction {
+	int     op; // IR_OPCODE
+	Operand operand;
+};
+
+inline Operand no_operand()                          { Operand o = {}; return o; }
+inline Operand imm     (const int value)             { Operand o = {}; o.kind = OPND_INT;      o.value = value; return o; }
+inline Operand num     (const double value)          { Operand o = {}; o.kind = OPND_NUM;      o.num   = value; return o; }
+inline Operand reg     (const int r)                 { Operand o = {}; o.kind = OPND_REG;      o.reg = (char) r; return o; }
+inline Operand reg_plus(const int r, const int k)    { Operand o = {}; o.kind = OPND_REG_PLUS; o.reg = (char) r; o.value = k; return o; }
+inline Operand mem     (const int r)                 { Operand o = {}; o.kind = OPND_MEM;      o.reg = (char) r; return o; }
+inline Operand mem_plus(const int r, const int k)    { Operand o = {}; o.kind = OPND_MEM_PLUS; o.reg = (char) r; o.value = k; return o; }
+inline Operand mem_abs (const int k)                 { Operand o = {}; o.kind = OPND_MEM_ABS;  o.value = k; return o; }
+inline Operand pixel   (const int r)                 { Operand o = {}; o.kind = OPND_PIXEL;    o.reg = (char) r; return o; }
+inline Operand chr     (const char c)                { Operand o = {}; o.kind = OPND_CHAR;     o.value = c; return o; }
+Operand num_exact(const double value); // a number in as few digits as read back as value
+
+inline Operand label   (const int kind, const int number, const int sym = NO_SYMBOL) {
+	Operand o = {}; o.kind = OPND_LABEL; o.label = (char) kind; o.value = number; o.sym = sym; return o;
+}
+
+int ir_stack_op(const int op); // the instruction of an AST op that runs on the stack, operands first; IR_NONE for the rest
+
+bool ir_is_jump     (const int op); // jmp, je, jne and call, the ones with a label operand
+bool ir_ends_block  (const int op); // nothing after it runs unless jumped to
+bool ir_reads       (const Instruction &instr, const int r);
+bool ir_same_operand(const Operand &a, const Operand &b);
+
+bool ir_const  (const Operand &operand, double *value); // a pushed constant
+bool ir_fold   (const int op, const double a, const double b, double *result); // a op b for a stack op
+bool ir_literal(const double value, Operand *operand); // the operand that prints value exactly, if there is one
+
+//=============================================================================
+// IrProgram ==================================================================
+// What codegen produces: instructions in order, each an opcode and a typed
+// operand. print() turns them into the SPU assembly text.
+
+class IrProgram {
+private:
+// data =======================================================================
+	Instruction *code;
+	int          cur_size;
+	int          capacity;
+//=============================================================================
+
+	void grow();
+	void print_operand(Emitter *out, const FlatAst *ast, const Operand &operand) const;
+
+public:
+	IrProgram            (const IrProgram&) = delete;
+	IrProgram &operator= (const IrProgram&) = delete;
+
+	IrProgram ();
+	~IrProgram();
+
+	void ctor();
+	static IrProgram *NEW();
+
+	void dtor();
+	static void DELETE(IrProgram *program);
+
+//=============================================================================
+
+	inline void add(const int op, const Operand &operand = no_operand());
+
+	void add_label  (const Operand &name);
+	void add_blank  ();
+	void add_comment(const AstNode node);
+
+	void clear();
+	int  size() const;
+	Instruction       &operator[](const int i);
+	const Instruction &operator[](const int i) const;
+
+	void compact(); // drops the instructions rewritten to IR_NONE
+
+	void print(Emitter *out, const FlatAst *ast) const; // comments dump their nodes from ast
+};
+
+inline void IrProgram::add(const int op, const Operand &operand) {
+	if (cur_size == capacity) {
+		grow();
+	}
+
+	code[cur_size++] = {op, operand};
+}
+
+#endif // IR_H
@@ -0,0 +1,222 @@
+#include "lex_scan.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+	#define LEX_SCAN_X86
+	#include <immintrin.h>
+#endif
+
+static inline bool is_space_char(const char c) {
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+//=============================================================================
+// Scalar =====================================================================
+
+static const char *scalar_scan_spaces(const char *cur, const char *end) {
+	while (cur < end && is_space_char(*cur)) {
+		++cur;
+	}
+	return cur;
+}
+
+static const char *scalar_scan_char(const char *cur, const char *end, const char c) {
+	if (cur >= end) {
+		return end;
+	}
+
+	const char *ret = (const char*) memchr(cur, c, (size_t) (end - cur));
+	return ret ? ret : end;
+}
+
+static const char *scalar_scan_pair(const char *cur, const char *end, const char first, const char second) {
+	for (; cur + 1 < end; ++cur) {
+		if (cur[0] == first && cur[1] == second) {
+			return cur;
+		}
+	}
+	return end;
+}
+
+static int scalar_count_char(const char *cur, const char *end, const char c) {
+	int cnt = 0;
+	for (; cur < end; ++cur) {
+		cnt += *cur == c;
+	}
+	return cnt;
+}
+
+#ifdef LEX_SCAN_X86
+
+//=============================================================================
+// SSE2 =======================================================================
+
+__attribute__((target("sse2")))
+static inline __m128i sse2_space_mask(const __m128i v) {
+	const __m128i shifted = _mm_sub_epi8(v, _mm_set1_epi8('\t'));                      // \t..\r -> 0..4
+	const __m128i ctrl    = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(4)), shifted);
+	return _mm_or_si128(ctrl, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+}
+
+__attribute__((target("sse2")))
+static const char *sse2_scan_spaces(const char *cur, const char *end) {
+	for (; cur + 16 <= end; cur += 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i*) cur);
+		const unsigned mask = ~(unsigned) _mm_movemask_epi8(sse2_space_mask(v)) & 0xFFFF;
+		if (mask) {
+			return cur + __builtin_ctz(mask);
+		}
+	}
+	return scalar_scan_spaces(cur, end);
+}
+
+__attribute__((target("sse2")))
+static const char *sse2_scan_char(const char *cur, const char *end, const char c) {
+	const __m128i pattern = _mm_set1_epi8(c);
+	for (; cur + 16 <= end; cur += 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i*) cur);
+		const unsigned mask = (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(v, pattern));
+		if (mask) {
+			return cur + __builtin_ctz(mask);
+		}
+	}
+	return scalar_scan_char(cur, end, c);
+}
+
+__attribute__((target("sse2")))
+static const char *sse2_scan_pair(const char *cur, const char *end, const char first, const char second) {
+	const __m128i pattern_1 = _mm_set1_epi8(first);
+	const __m128i pattern_2 = _mm_set1_epi8(second);
+	for (; cur + 17 <= end; cur += 16) {
+		const __m128i v1 = _mm_loadu_si128((const __m128i*) cur);
+		const __m128i v2 = _mm_loadu_si128((const __m128i*) (cur + 1));
+		const __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(v1, pattern_1), _mm_cmpeq_epi8(v2, pattern_2));
+		const unsigned mask = (unsigned) _mm_movemask_epi8(eq);
+		if (mask) {
+			return cur + __builtin_ctz(mask);
+		}
+	}
+	return scalar_scan_pair(cur, end, first, second);
+}
+
+__attribute__((target("sse2,popcnt")))
+static int sse2_count_char(const char *cur, const char *end, const char c) {
+	const __m128i pattern = _mm_set1_epi8(c);
+	int cnt = 0;
+	for (; cur + 16 <= end; cur += 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i*) cur);
+		cnt += __builtin_popcount((unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(v, pattern)));
+	}
+	return cnt + scalar_count_char(cur, end, c);
+}
+
+//=============================================================================
+// AVX2 =======================================================================
+
+__attribute__((target("avx2")))
+static inline __m256i avx2_space_mask(const __m256i v) {
+	const __m256i shifted = _mm256_sub_epi8(v, _mm256_set1_epi8('\t'));
+	const __m256i ctrl    = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8(4)), shifted);
+	return _mm256_or_si256(ctrl, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+}
+
+__attribute__((target("avx2")))
+static const char *avx2_scan_spaces(const char *cur, const char *end) {
+	for (; cur + 32 <= end; cur += 32) {
+		const __m256i v = _mm256_loadu_si256((const __m256i*) cur);
+		const unsigned mask = ~(unsigned) _mm256_movemask_epi8(avx2_space_mask(v));
+		if (mask) {
+			return cur + __builtin_ctz(mask);
+		}
+	}
+	return sse2_scan_spaces(cur, end);
+}
+
+__attribute__((target("avx2")))
+static const char *avx2_scan_char(const char *cur, const char *end, const char c) {
+	const __m256i pattern = _mm256_set1_epi8(c);
+	for (; cur + 32 <= end; cur += 32) {
+		const __m256i v = _mm256_loadu_si256((const __m256i*) cur);
+		const unsigned mask = (unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, pattern));
+		if (mask) {
+			return cur + __builtin_ctz(mask);
+		}
+	}
+	return sse2_scan_char(cur, end, c);
+}
+
+__attribute__((target("avx2")))
+static const char *avx2_scan_pair(const char *cur, const char *end, const char first, const char second) {
+	const __m256i pattern_1 = _mm256_set1_epi8(first);
+	const __m256i pattern_2 = _mm256_set1_epi8(second);
+	for (; cur + 33 <= end; cur += 32) {
+		const __m256i v1 = _mm256_loadu_si256((const __m256i*) cur);
+		const __m256i v2 = _mm256_loadu_si256((const __m256i*) (cur + 1));
+		const __m256i eq = _mm256_and_si256(_mm256_cmpeq_epi8(v1, pattern_1), _mm256_cmpeq_epi8(v2, pattern_2));
+		const unsigned mask = (unsigned) _mm256_movemask_epi8(eq);
+		if (mask) {
+			return cur + __builtin_ctz(mask);
+		}
+	}
+	return sse2_scan_pair(cur, end, first, second);
+}
+
+__attribute__((target("avx2,popcnt")))
+static int avx2_count_char(const char *cur, const char *end, const char c) {
+	const __m256i pattern = _mm256_set1_epi8(c);
+	int cnt = 0;
+	for (; cur + 32 <= end; cur += 32) {
+		const __m256i v = _mm256_loadu_si256((const __m256i*) cur);
+		cnt += __builtin_popcount((unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, pattern)));
+	}
+	return cnt + sse2_count_char(cur, end, c);
+}
+
+#endif // LEX_SCAN_X86
+
+//=============================================================================
+// Dispatch ===================================================================
+
+struct LexScanImpl {
+	const char *(*spaces)(const char *cur, const char *end);
+	const char *(*chr)   (const char *cur, const char *end, const char c);
+	const char *(*pair)  (const char *cur, const char *end, const char first, const char second);
+	int         (*count) (const char *cur, const char *end, const char c);
+};
+
+static LexScanImpl choose_impl() {
+	#ifdef LEX_SCAN_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+		return {avx2_scan_spaces, avx2_scan_char, avx2_scan_pair, avx2_count_char};
+	}
+
+	if (__builtin_cpu_supports("sse2") && __builtin_cpu_supports("popcnt")) {
+		return {sse2_scan_spaces, sse2_scan_char, sse2_scan_pair, sse2_count_char};
+	}
+	#endif
+
+	return {scalar_scan_spaces, scalar_scan_char, scalar_scan_pair, scalar_count_char};
+}
+
+static const LexScanImpl &impl() {
+	static const LexScanImpl chosen = choose_impl();
+	return chosen;
+}
+
+const char *scan_spaces(const char *cur, const char *end) {
+	return impl().spaces(cur, end);
+}
+
+const char *scan_char(const char *cur, const char *end, const char c) {
+	return impl().chr(cur, end, c);
+}
+
+const char *scan_pair(const char *cur, const char *end, const char first, const char second) {
+	return impl().pair(cur, end, first, second);
+}
+
+int count_char(const char *cur, const char *end, const char c) {
+	return impl().count(cur, end, c);
+}
@@ -0,0 +1,18 @@
+#ifndef LEX_SCAN
+#define LEX_SCAN
+
+#include <cstddef>
+
+//=============================================================================
+// LexScan ====================================================================
+// Bulk scanning primitives for the lexer. Every function looks only at
+// [cur, end) and returns end if nothing is found. The implementation
+// (AVX2, SSE2 or plain scalar) is picked once, on the first call.
+
+const char *scan_spaces(const char *cur, const char *end); // first non-space char
+const char *scan_char  (const char *cur, const char *end, const char c);
+const char *scan_pair  (const char *cur, const char *end, const char first, const char second);
+
+int count_char(const char *cur, const char *end, const char c);
+
+#endif // LEX_SCAN
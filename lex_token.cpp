@@ -24,9 +24,13 @@ void Token::ctor(int type_, int line_, int pos_) {
 	pos = pos_;
 }
 
-void Token::ctor(int type_, int op_, int line_, int pos_) {
+void Token::ctor(int type_, int op_or_id, int line_, int pos_) {
 	type = type_;
-	data.op = op_;
+	if (type == T_ID) {
+		data.id = op_or_id;
+	} else {
+		data.op = op_or_id;
+	}
 	line = line_;
 	pos = pos_;
 }
@@ -38,13 +42,6 @@ void Token::ctor(int type_, double num_, int line_, int pos_) {
 	pos = pos_;
 }
 
-void Token::ctor(int type_, StringView *id_, int line_, int pos_) {
-	type = type_;
-	data.id = id_;
-	line = line_;
-	pos = pos_;
-}
-
 Token *Token::NEW() {
 	Token *cake = (Token*) calloc(1, sizeof(Token));
 	if (!cake) {
@@ -65,13 +62,13 @@ Token *Token::NEW(int type_, int line_, int pos_) {
 	return cake;
 }
 
-Token *Token::NEW(int type_, int op_, int line_, int pos_) {
+Token *Token::NEW(int type_, int op_or_id, int line_, int pos_) {
 	Token *cake = (Token*) calloc(1, sizeof(Token));
 	if (!cake) {
 		return nullptr;
 	}
 
-	cake->ctor(type_, op_, line_, pos_);
+	cake->ctor(type_, op_or_id, line_, pos_);
 	return cake;
 }
 
@@ -85,30 +82,14 @@ Token *Token::NEW(int type_, double num_, int line_, int pos_) {
 	return cake;
 }
 
-Token *Token::NEW(int type_, StringView *id_, int line_, int pos_) {
-	Token *cake = (Token*) calloc(1, sizeof(Token));
-	if (!cake) {
-		return nullptr;
-	}
-
-	cake->ctor(type_, id_, line_, pos_);
-	return cake;
-}
-
-void Token::dtor(bool to_delete_id) {
-	if (type == T_ID) {
-		if (to_delete_id) {
-			StringView::DELETE(data.id);
-		}
-	}
-}
+void Token::dtor() {}
 
-void Token::DELETE(Token *classname, bool to_delete_id) {
+void Token::DELETE(Token *classname) {
 	if (!classname) {
 		return;
 	}
 
-	classname->dtor(to_delete_id);
+	classname->dtor();
 	free(classname);
 }
 
@@ -116,10 +97,14 @@ int Token::get_op() const {
 	return data.op;
 }
 
-StringView *Token::get_id() const {
+int Token::get_sym() const {
 	return data.id;
 }
 
+const StringView *Token::get_id() const {
+	return SYMBOL_POOL.get(data.id);
+}
+
 bool Token::is_op() const {
 	return type == T_OP;
 }
@@ -155,7 +140,7 @@ void Token::dump(FILE *file, bool bracked) const {
 			fprintf(file, "[op_%d]", data.op);
 		}
 	} else {
-		data.id->print();
+		get_id()->print(file);
 	}
 	if (bracked) {
 		fprintf(file, "]");
@@ -3,6 +3,7 @@
 
 #include "general/cpp/stringview.hpp"
 #include "compiler_options.h"
+#include "symbol_pool.h"
 
 //=============================================================================
 // Token ======================================================================
@@ -17,7 +18,7 @@ enum TOKEN_TYPE {
 union TokenData {
 	int         op;
 	double      num;
-	StringView *id;
+	int         id; // symbol from SYMBOL_POOL
 };
 
 struct Token {
@@ -36,22 +37,22 @@ struct Token {
 
 	void ctor();
 	void ctor(int type_, int line_, int pos_);
-	void ctor(int type_, int op_, int line_, int pos_);
+	void ctor(int type_, int op_or_id, int line_, int pos_);
 	void ctor(int type_, double num_, int line_, int pos_);
-	void ctor(int type_, StringView *id_, int line_, int pos_);
 
 	static Token *NEW();
 	static Token *NEW(int type_, int line_, int pos_);
-	static Token *NEW(int type_, int op_, int line_, int pos_);
+	static Token *NEW(int type_, int op_or_id, int line_, int pos_);
 	static Token *NEW(int type_, double num_, int line_, int pos_);
-	static Token *NEW(int type_, StringView *id_, int line_, int pos_);
 
-	void dtor(bool to_delete_id = false);
+	void dtor();
 
-	static void DELETE(Token *classname, bool to_delete_id = false);
+	static void DELETE(Token *classname);
 
-	int 		get_op() const;
-	StringView *get_id() const;
+	int get_op () const;
+	int get_sym() const;
+
+	const StringView *get_id() const;
 
 	bool is_op		() const;
 	bool is_op		(const int op) const;
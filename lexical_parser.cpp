@@ -1,7 +1,10 @@
 #include "lexical_parser.h"
 
-#define CUR_POS (int)(cur - cur_line)
-#define ADD_TOKEN(type, data) Token token = {}; token.ctor(type, data, line, CUR_POS); tokens->push_back(token)
+#include <thread>
+
+#define CUR_POS    (int)(cur - cur_line)
+#define LINE_START (int)(cur_line - cur_expr)
+#define ADD_TOKEN(type, data) Token token = {}; token.ctor(type, data, line, CUR_POS); tokens->push_back(token, LINE_START)
 
 bool LexicalParser::is_id_char(const char c) {
 	return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || c == '_';
@@ -27,102 +30,65 @@ void LexicalParser::collect_number() {
 	Token token = {};
 	token.ctor(T_NUMBER, 0, line, CUR_POS);
 
-	char sign = '+';
-	if (is_sign(*cur)) {
-		sign = *cur;
-		++cur;
-	}
-
-	double val = 0;
-	while (isdigit(*cur)) {
-		val = val * 10 + (*cur - '0');
-		++cur;
-	}
-
-	if (two_available() && *cur == '.' && isdigit(*(cur + 1))) {
-		++cur;
-
-		double frac = 0;
-		double len_frac = 1;
-		while (isdigit(*cur)) {
-			len_frac *= 10;
-			frac = frac * 10 + (*cur - '0');
-			++cur;
-		}
-
-		val = val + frac / (len_frac);
-	}
-
-	if (two_available() && (*cur == 'e' || *cur == 'E') && (isdigit(*(cur + 1)) || (three_available() && is_sign(*(cur + 1)) && isdigit(*(cur + 2))))) {
-		++cur;
-
-		char exp_sign = '+';
-		if (is_sign(*cur)) {
-			exp_sign = *cur;
-			++cur;
-		}
-
-		double ten_pow = 0;
-		while (isdigit(*cur)) {
-			ten_pow = ten_pow * 10 + (*cur - '0');
-			++cur;
-		}
-
-		if (exp_sign == '-') {
-			ten_pow *= -1;
-		}
-
-		val = val * pow(10, ten_pow);
-	}
-
-	if (sign == '-') {
-		val *= -1;
-	}
-
-	token.data.num = val;
-	tokens->push_back(token);
+	cur = parse_number(cur, &token.data.num);
+	tokens->push_back(token, LINE_START);
 }
 
 void LexicalParser::collect_id() {
-	StringView *id = StringView::NEW(cur);
-	size_t len = 0;
+	const char *id_start = cur;
 	while (is_id_char(*cur) || isdigit(*cur)) {
-		++len;
 		++cur;
 	}
-	id->set_length(len);
 
-	ADD_TOKEN(T_ID, id);
+	ADD_TOKEN(T_ID, symbols->intern(id_start, (size_t) (cur - id_start)));
 }
 
-#define OPDEF(name, code, str, key_1, key_2)                                               \
-	else if (StringView::starts_with(cur, key_1) || StringView::starts_with(cur, key_2)) { \
-		ADD_TOKEN(T_OP, name);                                                             \
-		cur += strlen(str);                                                                \
-		return true;                                                                       \
-	}
-
 bool LexicalParser::try_collect_long_op() {
 	if (*cur == '\'' && three_available() && (*(cur + 2) == '\'')) {
 		ADD_TOKEN(T_NUMBER, (double) *(cur + 1));
 		cur += 3;
 		return true;
-	} else if (StringView::starts_with(cur, "~")) {
+	} else if (*cur == '~') {
 		cur += 1; // I am ignoring it with purpose!
 		return true;
-	} 
+	}
+
+	int op  = 0;
+	int len = 0;
+	if (OP_TRIE.match(cur, &op, &len)) {
+		ADD_TOKEN(T_OP, op);
+		cur += len;
+		return true;
+	}
 
-	#include "opcodes.h"
+	return false;
+}
 
-	else {
-		return false;
+void LexicalParser::skip_to(const char *pos) {
+	const int newlines = count_char(cur, pos, '\n');
+	if (newlines) {
+		line += newlines;
+		cur_line = (const char*) memrchr(cur, '\n', (size_t) (pos - cur)) + 1;
 	}
+	cur = pos;
 }
 
-#undef OPDEF
+void LexicalParser::lex(const size_t limit) {
+	while (cur < end && tokens->size() < limit) {
+		if (skip_mode) { // jump straight to the first possible end of the comment
+			if (skip_mode == 1) {
+				skip_to(scan_char(cur, end, '\n'));
+			} else if (skip_mode == 2) {
+				skip_to(scan_pair(cur, end, '*', '/'));
+			} else if (skip_mode == 3) {
+				skip_to(scan_pair(cur, end, '<', '/'));
+			}
+
+			if (cur == end) {
+				break;
+			}
+		}
 
-void LexicalParser::parse() {
-	while(*cur) {
 		if (*cur == '\n') {
 			++line;
 			cur_line = cur + 1;
@@ -155,6 +121,7 @@ void LexicalParser::parse() {
 
 		if (isspace(*cur)) { // skip spaces
 			++cur;
+			skip_to(scan_spaces(cur, end));
 			continue;
 		}
 
@@ -201,7 +168,9 @@ LexicalParser::LexicalParser():
 cur_expr(nullptr),
 cur_line(nullptr),
 cur(nullptr),
+end(nullptr),
 tokens(nullptr),
+symbols(nullptr),
 skip_mode(0),
 line(0)
 {}
@@ -212,7 +181,9 @@ void LexicalParser::ctor() {
 	cur_expr  = nullptr;
 	cur_line  = nullptr;
 	cur       = nullptr;
+	end       = nullptr;
 	tokens    = nullptr;
+	symbols   = &SYMBOL_POOL;
 	skip_mode = 0;
 	line      = 1;
 }
@@ -240,22 +211,269 @@ void LexicalParser::DELETE(LexicalParser *parser) {
 
 //=============================================================================
 
-Vector<Token> *LexicalParser::parse(const char *expression) {
+TokenStream *LexicalParser::parse(const char *expression) {
+	return parse(expression, strlen(expression));
+}
+
+TokenStream *LexicalParser::parse(const char *expression, const size_t length) {
+	cur_expr = expression;
+	cur_line = expression;
+	cur      = expression;
+	end      = expression + length;
+
+	TokenStream *ret = TokenStream::NEW(TokenStream::estimate_capacity(length));
+	tokens = ret;
+	lex_until(SIZE_MAX);
+	ret->shrink_to_fit();
+
+	return ret;
+}
+
+void LexicalParser::lex_chunk(const char *expression, const char *start, const char *end_) {
+	cur_expr  = expression;
+	cur_line  = start;
+	cur       = start;
+	end       = end_;
+	skip_mode = 0;
+	line      = 1;
+
+	tokens = TokenStream::NEW(TokenStream::estimate_capacity((size_t) (end_ - start)));
+	lex(SIZE_MAX);
+}
+
+void LexicalParser::take_chunk(LexicalParser *chunk, const char *end_) {
+	const TokenStream *spec = chunk->tokens;
+	const size_t spec_cnt = spec->size();
+
+	int *id_map = (int*) calloc((size_t) chunk->symbols->size() + 1, sizeof(int));
+	if (!id_map) {
+		throw std::length_error("[ERR]<lexical_parser>: id map alloc fail");
+	}
+	for (int i = 0; i < chunk->symbols->size(); ++i) {
+		id_map[i] = NO_SYMBOL;
+	}
+
+	end = end_;
+
+	size_t spec_hint = 0;
+	size_t hint      = 0;
+	size_t k         = 0;
+	size_t spec_off  = spec_cnt ? spec->offset(0, &spec_hint, chunk->symbols) : SIZE_MAX;
+	while (true) { // the chunk's real start state is known, lex until it meets the speculation
+		const size_t last = tokens->size();
+		lex(last + 1);
+		if (tokens->size() == last) { // the whole chunk is relexed
+			free(id_map);
+			return;
+		}
+
+		const size_t off = tokens->offset(last, &hint);
+		while (spec_off < off) {
+			spec_off = ++k < spec_cnt ? spec->offset(k, &spec_hint, chunk->symbols) : SIZE_MAX;
+		}
+
+		if (spec_off == off) {
+			const int spec_line  = spec->line(k, &spec_hint);
+			const int line_delta = tokens->line(last, &hint) - spec_line;
+			const int pos_delta  = (int) spec->line_start(k, &spec_hint) - (int) tokens->line_start(last, &hint);
+			tokens->append(spec, k + 1, line_delta, pos_delta, chunk->symbols, id_map);
+
+			if (chunk->line != spec_line) { // the speculation has moved on to another line
+				cur_line = chunk->cur_line;
+			}
+			line      = chunk->line + line_delta;
+			cur       = chunk->cur;
+			skip_mode = chunk->skip_mode;
+
+			free(id_map);
+			return;
+		}
+	}
+}
+
+TokenStream *LexicalParser::parse(const char *expression, const size_t length, const int threads) {
+	size_t chunk_cnt = length / LEX_CHUNK_MIN_SIZE;
+	chunk_cnt = threads < (int) chunk_cnt ? (size_t) threads : chunk_cnt;
+	if (chunk_cnt < 2) {
+		return parse(expression, length);
+	}
+
+	const char **bounds = (const char**) calloc(chunk_cnt + 1, sizeof(const char*));
+	LexicalParser **chunks = (LexicalParser**) calloc(chunk_cnt, sizeof(LexicalParser*));
+	std::thread    *workers = new std::thread[chunk_cnt];
+	if (!bounds || !chunks) {
+		free(bounds);
+		free(chunks);
+		delete[] workers;
+		throw std::length_error("[ERR]<lexical_parser>: chunks alloc fail");
+	}
+
+	const char *expr_end = expression + length;
+	bounds[0]         = expression;
+	bounds[chunk_cnt] = expr_end;
+	for (size_t i = 1; i < chunk_cnt; ++i) { // cut after a newline, so no comment end or token start is split
+		const char *cut = expression + length / chunk_cnt * i;
+		cut = cut < bounds[i - 1] ? bounds[i - 1] : cut;
+		cut = (const char*) memchr(cut, '\n', (size_t) (expr_end - cut));
+		bounds[i] = cut ? cut + 1 : expr_end;
+	}
+
+	for (size_t i = 1; i < chunk_cnt; ++i) {
+		chunks[i] = LexicalParser::NEW();
+		chunks[i]->symbols = SymbolPool::NEW();
+		workers[i] = std::thread(&LexicalParser::lex_chunk, chunks[i], expression, bounds[i], bounds[i + 1]);
+	}
+
+	cur_expr = expression;
+	cur_line = expression;
+	cur      = expression;
+	end      = bounds[1];
+
+	TokenStream *ret = TokenStream::NEW(TokenStream::estimate_capacity(length));
+	tokens = ret;
+	lex(SIZE_MAX);
+
+	size_t total = ret->size() + 1;
+	for (size_t i = 1; i < chunk_cnt; ++i) {
+		workers[i].join();
+		total += chunks[i]->tokens->size();
+	}
+	ret->reserve(total); // relexed chunks can differ a bit, but they rarely do
+
+	for (size_t i = 1; i < chunk_cnt; ++i) {
+		take_chunk(chunks[i], bounds[i + 1]);
+
+		TokenStream::DELETE(chunks[i]->tokens);
+		SymbolPool::DELETE(chunks[i]->symbols);
+		LexicalParser::DELETE(chunks[i]);
+	}
+
+	free(bounds);
+	free(chunks);
+	delete[] workers;
+
+	end = expr_end;
+	lex_until(SIZE_MAX);
+	ret->shrink_to_fit();
+
+	return ret;
+}
+
+TokenStream *LexicalParser::stream(const char *expression, const size_t length) {
 	cur_expr = expression;
 	cur_line = expression;
 	cur      = expression;
+	end      = expression + length;
+
+	tokens = TokenStream::NEW(TOKEN_STREAM_BATCH * 4, this);
+	return tokens;
+}
+
+void LexicalParser::lex_until(const size_t limit) {
+	if (!tokens) {
+		return;
+	}
+
+	lex(limit);
+	if (cur < end) {
+		return;
+	}
 
-	tokens = Vector<Token>::NEW();
-	parse();
 	ADD_TOKEN(T_END, 0);
+	tokens->finish();
+
+	cur    = nullptr;
+	end    = nullptr;
+	tokens = nullptr;
+}
+
+size_t LexicalParser::relex(TokenStream *stream, const char *expression, const size_t length, const TextEdit &edit) {
+	if (!stream || !stream->whole()) {
+		throw std::length_error("[ERR]<lexical_parser>: relex needs a fully lexed stream");
+	}
+
+	// Everything lexed before the restart token peeked at most LOOKAHEAD chars past
+	// its own start, so the lexer state there is the same for the edited text.
+	const size_t LOOKAHEAD = (size_t) OP_TRIE.max_length() + 3;
+	const long   delta     = (long) edit.new_length - (long) edit.old_length;
+
+	size_t hint = 0;
+	size_t from = 0;
+	bool   from_token = false;
+	if (edit.start >= LOOKAHEAD) {
+		size_t l = 0;
+		size_t r = stream->size();
+		while (l < r) { // first token starting after the safe point
+			size_t m = (l + r) / 2;
+			if (stream->offset(m, &hint) <= edit.start - LOOKAHEAD) {
+				l = m + 1;
+			} else {
+				r = m;
+			}
+		}
+
+		if (l) {
+			from = l - 1;
+			from_token = true;
+		}
+	}
 
-	Vector<Token> *ret = tokens;
+	cur_expr  = expression;
+	end       = expression + length;
+	skip_mode = 0;
+	if (from_token) {
+		cur      = expression + stream->offset(from, &hint);
+		cur_line = expression + stream->line_start(from, &hint);
+		line     = stream->line(from, &hint);
+	} else {
+		cur      = expression;
+		cur_line = expression;
+		line     = 1;
+	}
+
+	TokenStream *fresh = TokenStream::NEW();
+	tokens = fresh;
+
+	const size_t suffix = edit.start + edit.new_length;
+	size_t fresh_hint = 0;
+	size_t old        = from;
+	size_t old_offset = stream->offset(old, &hint);
+	while (true) {
+		const size_t k = fresh->size();
+		lex(k + 1);
+		if (fresh->size() == k) {
+			ADD_TOKEN(T_END, 0);
+		}
+
+		const size_t new_offset = fresh->offset(k, &fresh_hint);
+		if (new_offset < suffix) {
+			continue;
+		}
+
+		const size_t target = (size_t) ((long) new_offset - delta);
+		while (old_offset < target) {
+			old_offset = stream->offset(++old, &hint);
+		}
+
+		if (old_offset == target) { // same state on the same char, the rest is unchanged
+			const int line_delta = fresh->line(k, &fresh_hint) - stream->line(old, &hint);
+			const int pos_delta  = (int) ((long) stream->line_start(old, &hint) + delta
+			                            - (long) fresh->line_start(k, &fresh_hint));
+			stream->splice(from, old, fresh, k, line_delta, (int) delta, pos_delta);
+			break;
+		}
+	}
 
+	const size_t lexed = fresh->size();
+
+	TokenStream::DELETE(fresh);
 	cur    = nullptr;
+	end    = nullptr;
 	tokens = nullptr;
-	return ret;
+
+	return lexed;
 }
 
 #undef ADD_TOKEN
+#undef LINE_START
 #undef CUR_POS
-#undef ADD_TOKEN
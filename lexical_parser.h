@@ -9,6 +9,20 @@
 
 #include "compiler_options.h"
 #include "lex_token.h"
+#include "token_stream.h"
+#include "op_trie.h"
+#include "lex_scan.h"
+#include "number_parser.h"
+#include "symbol_pool.h"
+
+const size_t LEX_CHUNK_MIN_SIZE = 1 << 18; // smaller sources are not worth a thread
+
+// A byte range of the source replaced by new text.
+struct TextEdit {
+	size_t start;
+	size_t old_length;
+	size_t new_length;
+};
 
 //=============================================================================
 // LexicalParser ==============================================================
@@ -19,7 +33,9 @@ private:
 	const char *cur_expr;
 	const char *cur_line;
 	const char *cur;
-	Vector<Token> *tokens;
+	const char *end;
+	TokenStream *tokens;
+	SymbolPool  *symbols;
 	char skip_mode;
 	int line;
 //=============================================================================
@@ -36,7 +52,12 @@ private:
 
 	bool try_collect_long_op();
 
-	void parse();
+	void skip_to(const char *pos);
+
+	void lex(const size_t limit);
+
+	void lex_chunk (const char *expression, const char *start, const char *end_);
+	void take_chunk(LexicalParser *chunk, const char *end_);
 
 public:
 	LexicalParser            (const LexicalParser&) = delete;
@@ -53,7 +74,26 @@ public:
 
 //=============================================================================
 
-	Vector<Token> *parse(const char *expression);
+	TokenStream *parse(const char *expression);
+	TokenStream *parse(const char *expression, const size_t length); // expression[length] must be '\0'
+
+	// Same tokens as parse(), lexed by up to threads threads. The source is cut into
+	// chunks at newlines, every chunk but the first is lexed speculatively as if it
+	// started outside a comment, and the chunks are stitched in order. A chunk whose
+	// real start state differs is relexed from it until it meets the speculation.
+	TokenStream *parse(const char *expression, const size_t length, const int threads);
+
+	// Lazy stream: tokens are lexed as the reader fetches them.
+	// expression must outlive the stream, the lexer serves one stream at a time.
+	TokenStream *stream(const char *expression, const size_t length);
+	void lex_until(const size_t limit); // lex until the stream holds limit tokens or ends
+
+	// Updates a fully lexed stream of the old text after edit, expression is the new text.
+	// Lexing restarts at the last token safely before the edit and stops at the first
+	// token that starts at the same unchanged char as an old one; the old tokens after
+	// it keep their payloads and only get their lines and positions shifted.
+	// Returns the number of tokens lexed.
+	size_t relex(TokenStream *stream, const char *expression, const size_t length, const TextEdit &edit);
 };
 
 #endif // LEXICAL_PARSER
\ No newline at end of file
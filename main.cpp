@@ -10,6 +10,14 @@ int main(const int argc, const char **argv) {
 	const char *input_file  = "prog.ctx";
 	const char *output_file = "out.kc";
 	int verbosity = 0;
+	int lex_threads = 1;
+	int parse_threads = 1;
+	bool parse_memo  = false;
+	bool parse_stats = false;
+	bool ast_cache   = false;
+	int  opt_level   = 0;
+	bool opt_stats   = false;
+	const char *ast_cache_dir = nullptr;
 	
 	if (argc > 1 && strcmp(argv[1], ".")) {
 		input_file = argv[1];
@@ -19,12 +27,31 @@ int main(const int argc, const char **argv) {
 		output_file = argv[2];
 	}
 
-	if (argc > 3 && !strcmp(argv[3], "-v")) {
-		verbosity = 1; 
+	for (int i = 3; i < argc; ++i) {
+		if (!strcmp(argv[i], "-v")) {
+			verbosity = 1; 
+		} else if (!strncmp(argv[i], "-j", 2)) { // -jN lexes with N threads
+			lex_threads = atoi(argv[i] + 2);
+		} else if (!strcmp(argv[i], "-memo")) { // packrat table for the parser
+			parse_memo = true;
+		} else if (!strcmp(argv[i], "-pstat")) { // per-rule reparse counts to stderr
+			parse_stats = true;
+		} else if (!strcmp(argv[i], "-cache")) { // parsed tree kept in <input>.kast
+			ast_cache = true;
+		} else if (!strncmp(argv[i], "-cache=", 7)) { // or in a cache dir
+			ast_cache = true;
+			ast_cache_dir = argv[i] + 7;
+		} else if (!strncmp(argv[i], "-O", 2)) { // -ON optimizes, -O1 simplifies the tree, propagates _constants and rewrites the asm with peephole rules
+			opt_level = atoi(argv[i] + 2);
+		} else if (!strcmp(argv[i], "-ostat")) { // per-rule simplifier and peephole counts to stderr
+			opt_stats = true;
+		} else if (!strncmp(argv[i], "-p", 2)) { // -pN parses top-level funcs with N threads
+			parse_threads = atoi(argv[i] + 2);
+		}
 	}
 
 	File file = {};
-	file.ctor(input_file);
+	file.ctor(input_file, FILE_MAP);
 	if (!file.data) {
 		ANNOUNCE("ERR", "kncc", "can't find input file [%s]", input_file);
 		return -1;
@@ -32,7 +59,10 @@ int main(const int argc, const char **argv) {
 
 	Compiler comp = {};
 	comp.ctor();
-	CodeNode *prog = comp.read_to_nodes(&file);
+	comp.set_parse_memo(parse_memo, parse_stats);
+	comp.set_ast_cache(ast_cache, ast_cache_dir);
+	comp.set_optimization(opt_level, opt_stats);
+	CodeNode *prog = comp.read_to_nodes(&file, lex_threads, parse_threads);
 
 	if (!prog) {
 		ANNOUNCE("ERR", "kncc", "can't parse input file [%s]", input_file);
@@ -41,19 +71,23 @@ int main(const int argc, const char **argv) {
 		return -1;
 	}
 
-	if (verbosity) prog->gv_dump();
+	if (verbosity) {
+		FlatAst ast = {};
+		ast.ctor();
+		ast.flatten(prog);
+		ast.gv_dump();
+		ast.dtor();
+	}
 
 	if (!comp.compile(prog, output_file)) {
 		ANNOUNCE("ERR", "kncc", "can't compile input file [%s]", input_file);
-		CodeNode::DELETE(prog, true, true);
 		file.dtor();
 		comp.dtor();
 		return -1;
 	}
 
-	CodeNode::DELETE(prog, true, true);
 	file.dtor();
-	comp.dtor();
+	comp.dtor(); // the tree goes with the compilation
 
 	// printf(".doned.\n");
 	return 0;
@@ -0,0 +1,355 @@
+#include "number_parser.h"
+
+#include <cstdlib>
+#include <cstring>
+
+const int NUMBER_SMALLEST_POW10 = -342; // below this every double rounds to zero
+const int NUMBER_LARGEST_POW10  =  308; // above this every double is infinite
+const int NUMBER_MAX_DIGITS     =   19; // always fit into uint64_t
+const int NUMBER_MAX_EXACT_POW  =   22; // 10^22 is the largest exact double power of ten
+
+const int NUMBER_MANTISSA_BITS  =   52;
+const int NUMBER_MIN_EXPONENT   = -1023;
+const int NUMBER_INFINITE_POWER = 0x7FF;
+
+const size_t NUMBER_BIG_LIMBS   =   64; // 2048 bits are enough for 2^1792 / 5^n
+
+static inline bool is_digit(const char c) {
+	return '0' <= c && c <= '9';
+}
+
+static inline bool is_sign(const char c) {
+	return c == '+' || c == '-';
+}
+
+//=============================================================================
+// Powers of five =============================================================
+// 128-bit normalized approximations of 5^q for q in [-342, 308], truncated
+// for q >= 0 and rounded up for q < 0, as Eisel-Lemire requires.
+// They are computed once with a small bigint instead of a 10 KB literal table.
+
+struct BigNum {
+	uint32_t limbs[NUMBER_BIG_LIMBS]; // little-endian
+
+	void set_pow2(const int pow) {
+		memset(limbs, 0, sizeof(limbs));
+		limbs[pow / 32] = 1u << (pow % 32);
+	}
+
+	void mul_small(const uint32_t x) {
+		uint64_t carry = 0;
+		for (size_t i = 0; i < NUMBER_BIG_LIMBS; ++i) {
+			const uint64_t cur = (uint64_t) limbs[i] * x + carry;
+			limbs[i] = (uint32_t) cur;
+			carry = cur >> 32;
+		}
+	}
+
+	void div_small(const uint32_t x) {
+		uint64_t rem = 0;
+		for (size_t i = NUMBER_BIG_LIMBS; i-- > 0;) {
+			const uint64_t cur = (rem << 32) | limbs[i];
+			limbs[i] = (uint32_t) (cur / x);
+			rem = cur % x;
+		}
+	}
+
+	void add_one() {
+		for (size_t i = 0; i < NUMBER_BIG_LIMBS && ++limbs[i] == 0; ++i) {}
+	}
+
+	void shift_right(const int bits) {
+		const size_t limb_shift = (size_t) bits / 32;
+		const int    bit_shift  = bits % 32;
+		for (size_t i = 0; i < NUMBER_BIG_LIMBS; ++i) {
+			const uint64_t lo = i + limb_shift     < NUMBER_BIG_LIMBS ? limbs[i + limb_shift]     : 0;
+			const uint64_t hi = i + limb_shift + 1 < NUMBER_BIG_LIMBS ? limbs[i + limb_shift + 1] : 0;
+			limbs[i] = (uint32_t) (((hi << 32) | lo) >> bit_shift);
+		}
+	}
+
+	bool bit(const int i) const {
+		return (limbs[i / 32] >> (i % 32)) & 1;
+	}
+
+	int bit_length() const {
+		for (int i = (int) NUMBER_BIG_LIMBS - 1; i >= 0; --i) {
+			if (limbs[i]) {
+				return i * 32 + 32 - __builtin_clz(limbs[i]);
+			}
+		}
+		return 0;
+	}
+
+	void top_128(uint64_t *hi, uint64_t *lo) const { // the highest 128 bits, the value is at least 2^127
+		const int len = bit_length();
+		uint64_t words[2] = {0, 0};
+		for (int i = 0; i < 128; ++i) {
+			if (bit(len - 128 + i)) {
+				words[i / 64] |= (uint64_t) 1 << (i % 64);
+			}
+		}
+		*lo = words[0];
+		*hi = words[1];
+	}
+};
+
+struct PowersOfFive {
+	uint64_t table[2 * (NUMBER_LARGEST_POW10 - NUMBER_SMALLEST_POW10 + 1)]; // {hi, lo} pairs
+
+	PowersOfFive() {
+		const int base_pow = 1792; // 2^base_pow / 5^342 still has more than 128 bits
+
+		BigNum scaled = {}; // floor(2^base_pow / 5^n)
+		scaled.set_pow2(base_pow);
+		BigNum pow5 = {};   // 5^n, only its bit length z is needed: 2^(z - 1) < 5^n < 2^z
+		pow5.set_pow2(0);
+		for (int n = 1; n <= -NUMBER_SMALLEST_POW10; ++n) {
+			scaled.div_small(5);
+			pow5.mul_small(5);
+			const int z = pow5.bit_length();
+
+			const int b = n <= 27 ? z + 127 : 2 * z + 128;
+			BigNum c = scaled; // floor(2^b / 5^n) + 1
+			c.shift_right(base_pow - b);
+			c.add_one();
+
+			const int q = -n;
+			c.top_128(&table[2 * (q - NUMBER_SMALLEST_POW10)], &table[2 * (q - NUMBER_SMALLEST_POW10) + 1]);
+		}
+
+		pow5.set_pow2(0);
+		for (int q = 0; q <= NUMBER_LARGEST_POW10; ++q) {
+			BigNum normalized = pow5;
+			while (normalized.bit_length() < 128) {
+				normalized.mul_small(2);
+			}
+			normalized.top_128(&table[2 * (q - NUMBER_SMALLEST_POW10)], &table[2 * (q - NUMBER_SMALLEST_POW10) + 1]);
+
+			pow5.mul_small(5);
+		}
+	}
+};
+
+static const uint64_t *powers_of_five() {
+	static const PowersOfFive powers;
+	return powers.table;
+}
+
+//=============================================================================
+// Eisel-Lemire ===============================================================
+
+static inline void mul_128(const uint64_t a, const uint64_t b, uint64_t *hi, uint64_t *lo) {
+	const unsigned __int128 res = (unsigned __int128) a * b;
+	*hi = (uint64_t) (res >> 64);
+	*lo = (uint64_t) res;
+}
+
+static inline int binary_power(const int q) { // floor(log2(10^q)) + 63
+	return (((152170 + 65536) * q) >> 16) + 63;
+}
+
+static bool eisel_lemire(const uint64_t w_, const int q, const bool negative, double *val) {
+	uint64_t mantissa = 0;
+	int power2 = 0;
+
+	if (w_ == 0 || q < NUMBER_SMALLEST_POW10) {
+		power2 = 0;
+	} else if (q > NUMBER_LARGEST_POW10) {
+		power2 = NUMBER_INFINITE_POWER;
+	} else {
+		const int lz = __builtin_clzll(w_);
+		const uint64_t w = w_ << lz;
+
+		const uint64_t *pow5 = powers_of_five() + 2 * (q - NUMBER_SMALLEST_POW10);
+		uint64_t hi = 0;
+		uint64_t lo = 0;
+		mul_128(w, pow5[0], &hi, &lo);
+
+		const uint64_t precision_mask = ~(uint64_t) 0 >> (NUMBER_MANTISSA_BITS + 3);
+		if ((hi & precision_mask) == precision_mask) {
+			uint64_t hi_2 = 0;
+			uint64_t lo_2 = 0;
+			mul_128(w, pow5[1], &hi_2, &lo_2);
+			lo += hi_2;
+			if (hi_2 > lo) {
+				++hi;
+			}
+
+			if (lo == ~(uint64_t) 0 && (q < -27 || q > 55)) { // the approximation can't decide
+				return false;
+			}
+		}
+
+		const int upper_bit = (int) (hi >> 63);
+		const int shift = upper_bit + 64 - NUMBER_MANTISSA_BITS - 3;
+		mantissa = hi >> shift;
+		power2 = binary_power(q) + upper_bit - lz - NUMBER_MIN_EXPONENT;
+
+		if (power2 <= 0) { // subnormal
+			if (-power2 + 1 >= 64) {
+				mantissa = 0;
+				power2 = 0;
+			} else {
+				mantissa >>= -power2 + 1;
+				mantissa += mantissa & 1;
+				mantissa >>= 1;
+				power2 = mantissa < ((uint64_t) 1 << NUMBER_MANTISSA_BITS) ? 0 : 1;
+			}
+		} else {
+			if (lo <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 && (mantissa << shift) == hi) {
+				mantissa &= ~(uint64_t) 1; // exactly halfway, round to even
+			}
+
+			mantissa += mantissa & 1;
+			mantissa >>= 1;
+			if (mantissa >= ((uint64_t) 2 << NUMBER_MANTISSA_BITS)) {
+				mantissa = (uint64_t) 1 << NUMBER_MANTISSA_BITS;
+				++power2;
+			}
+			mantissa &= ~((uint64_t) 1 << NUMBER_MANTISSA_BITS);
+
+			if (power2 >= NUMBER_INFINITE_POWER) {
+				power2 = NUMBER_INFINITE_POWER;
+				mantissa = 0;
+			}
+		}
+	}
+
+	const uint64_t bits = mantissa | ((uint64_t) power2 << NUMBER_MANTISSA_BITS) | ((uint64_t) negative << 63);
+	memcpy(val, &bits, sizeof(bits));
+	return true;
+}
+
+//=============================================================================
+
+static bool clinger(const uint64_t w, const int q, const bool negative, double *val) {
+	static const double exact_pow10[] = {
+		1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+	};
+
+	if (w > ((uint64_t) 1 << 53) || q < -NUMBER_MAX_EXACT_POW || q > NUMBER_MAX_EXACT_POW) {
+		return false;
+	}
+
+	double res = (double) w;
+	res = q < 0 ? res / exact_pow10[-q] : res * exact_pow10[q];
+	*val = negative ? -res : res;
+	return true;
+}
+
+static double slow_path(const char *start, const char *end) {
+	char buffer[128] = "";
+	const size_t length = (size_t) (end - start);
+	char *literal = length < sizeof(buffer) ? buffer : (char*) calloc(length + 1, sizeof(char));
+	if (!literal) {
+		return strtod(start, nullptr);
+	}
+
+	memcpy(literal, start, length);
+	literal[length] = '\0';
+	const double res = strtod(literal, nullptr);
+
+	if (literal != buffer) {
+		free(literal);
+	}
+	return res;
+}
+
+const char *parse_number(const char *cur, double *val) {
+	const char *start = cur;
+
+	bool negative = false;
+	if (is_sign(*cur)) {
+		negative = *cur == '-';
+		++cur;
+	}
+
+	uint64_t w = 0; // wraps around for long literals, recomputed below then
+
+	const char *int_begin = cur;
+	for (; is_digit(*cur); ++cur) {
+		w = w * 10 + (uint64_t) (*cur - '0');
+	}
+	const char *int_end = cur;
+
+	const char *frac_begin = cur;
+	const char *frac_end   = cur;
+	if (*cur == '.' && is_digit(*(cur + 1))) {
+		frac_begin = ++cur;
+		for (; is_digit(*cur); ++cur) {
+			w = w * 10 + (uint64_t) (*cur - '0');
+		}
+		frac_end = cur;
+	}
+
+	int exponent = 0;
+	if ((*cur == 'e' || *cur == 'E') && (is_digit(*(cur + 1)) || (is_sign(*(cur + 1)) && is_digit(*(cur + 2))))) {
+		++cur;
+
+		bool exp_negative = false;
+		if (is_sign(*cur)) {
+			exp_negative = *cur == '-';
+			++cur;
+		}
+
+		for (; is_digit(*cur); ++cur) {
+			if (exponent < 100000) {
+				exponent = exponent * 10 + (*cur - '0');
+			}
+		}
+
+		if (exp_negative) {
+			exponent = -exponent;
+		}
+	}
+
+	const int int_len  = (int) (int_end  - int_begin);
+	const int frac_len = (int) (frac_end - frac_begin);
+
+	int q = exponent - frac_len;
+	bool truncated = false;
+
+	if (int_len + frac_len > NUMBER_MAX_DIGITS) { // keep the first NUMBER_MAX_DIGITS significant digits
+		w = 0;
+		int digits = 0;
+		int used_frac = 0;
+		int dropped_int = 0;
+		for (const char *c = int_begin; c < int_end; ++c) {
+			if (digits < NUMBER_MAX_DIGITS) {
+				w = w * 10 + (uint64_t) (*c - '0');
+				digits += w != 0;
+			} else {
+				++dropped_int;
+				truncated |= *c != '0';
+			}
+		}
+		for (const char *c = frac_begin; c < frac_end; ++c) {
+			if (digits < NUMBER_MAX_DIGITS) {
+				w = w * 10 + (uint64_t) (*c - '0');
+				digits += w != 0;
+				++used_frac;
+			} else {
+				truncated |= *c != '0';
+			}
+		}
+		q = exponent + dropped_int - used_frac;
+	}
+
+	if (!truncated) {
+		if (clinger(w, q, negative, val) || eisel_lemire(w, q, negative, val)) {
+			return cur;
+		}
+	} else {
+		double lower = 0;
+		double upper = 0;
+		if (eisel_lemire(w, q, negative, &lower) && eisel_lemire(w + 1, q, negative, &upper) && lower == upper) {
+			*val = lower;
+			return cur;
+		}
+	}
+
+	*val = slow_path(start, cur);
+	return cur;
+}
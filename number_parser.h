@@ -0,0 +1,16 @@
+#ifndef NUMBER_PARSER
+#define NUMBER_PARSER
+
+#include <cstddef>
+#include <cstdint>
+
+//=============================================================================
+// NumberParser ===============================================================
+// Correctly rounded decimal literals: [+-]digits[.digits][(e|E)[+-]digits].
+// A '.' or an exponent is only taken when digits follow it, exactly as the
+// lexer always did. Clinger's exact path and Eisel-Lemire cover nearly all
+// literals; the rest go through strtod.
+
+const char *parse_number(const char *cur, double *val); // returns the end of the literal
+
+#endif // NUMBER_PARSER
@@ -0,0 +1,21 @@
+// OPPOWER(op, infix, prefix, right_assoc)
+// binding powers of the expression operators, higher binds tighter, 0 - not used that way
+// an operand of a prefix operator takes every infix operator at least as strong as it
+
+OPPOWER(OPCODE_OR , 1, 0, 0)
+OPPOWER(OPCODE_AND, 2, 0, 0)
+
+OPPOWER('<'       , 3, 0, 0)
+OPPOWER('>'       , 3, 0, 0)
+OPPOWER(OPCODE_LE , 3, 0, 0)
+OPPOWER(OPCODE_GE , 3, 0, 0)
+OPPOWER(OPCODE_EQ , 3, 0, 0)
+OPPOWER(OPCODE_NEQ, 3, 0, 0)
+
+OPPOWER('+'       , 4, 6, 0)
+OPPOWER('-'       , 4, 6, 0)
+
+OPPOWER('*'       , 5, 0, 0)
+OPPOWER('/'       , 5, 0, 0)
+
+OPPOWER('^'       , 6, 0, 1)
@@ -0,0 +1,186 @@
+#ifndef OP_TRIE_H
+#define OP_TRIE_H
+
+#include "compiler_options.h"
+
+//=============================================================================
+// OpTrie =====================================================================
+// Recognizes the longest operator/keyword from opcodes.h at the given position.
+// The whole automaton is built by the compiler from the OPDEF table, so the
+// lexer pays one table step per matched character and nothing at startup.
+
+const int OP_TRIE_ALPHABET = 128;
+
+struct OpTrieKey {
+	const char *key;
+	int op;
+	int len;
+};
+
+#define OPDEF(name, code, str, key_1, key_2) {key_1, name, sizeof(str) - 1}, {key_2, name, sizeof(str) - 1},
+
+constexpr OpTrieKey OP_TRIE_KEYS[] = {
+	#include "opcodes.h"
+};
+
+#undef OPDEF
+
+constexpr int OP_TRIE_KEY_CNT = (int) (sizeof(OP_TRIE_KEYS) / sizeof(OP_TRIE_KEYS[0]));
+
+constexpr int op_trie_key_len(const char *key) {
+	int len = 0;
+	while (key[len]) {
+		++len;
+	}
+	return len;
+}
+
+// the first len chars of keys a and b are the same
+constexpr bool op_trie_same_prefix(const char *a, const char *b, const int len) {
+	for (int i = 0; i < len; ++i) {
+		if (a[i] != b[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// a node per distinct prefix of the keys, the root is the empty one
+constexpr int op_trie_count_nodes() {
+	int cnt = 1;
+	for (int k = 0; k < OP_TRIE_KEY_CNT; ++k) {
+		const char *key = OP_TRIE_KEYS[k].key;
+		const int   len = op_trie_key_len(key);
+
+		for (int p = 1; p <= len; ++p) {
+			bool seen = false;
+			for (int j = 0; j < k && !seen; ++j) {
+				seen = op_trie_key_len(OP_TRIE_KEYS[j].key) >= p && op_trie_same_prefix(key, OP_TRIE_KEYS[j].key, p);
+			}
+			cnt += !seen;
+		}
+	}
+	return cnt;
+}
+
+// a class per distinct char of the keys, class 0 is every other char
+constexpr int op_trie_count_classes() {
+	bool seen[OP_TRIE_ALPHABET] = {};
+	int cnt = 1;
+	for (int k = 0; k < OP_TRIE_KEY_CNT; ++k) {
+		for (const char *c = OP_TRIE_KEYS[k].key; *c; ++c) {
+			cnt += !seen[(unsigned char) *c];
+			seen[(unsigned char) *c] = true;
+		}
+	}
+	return cnt;
+}
+
+// the table is exactly as big as opcodes.h needs
+constexpr int OP_TRIE_NODES   = op_trie_count_nodes();
+constexpr int OP_TRIE_CLASSES = op_trie_count_classes();
+
+static_assert(OP_TRIE_NODES <= 256, "opcodes.h is too big for OpTrie, node numbers are unsigned char");
+
+class OpTrie {
+private:
+// data =======================================================================
+	unsigned char char_class[OP_TRIE_ALPHABET];
+	unsigned char next[OP_TRIE_NODES][OP_TRIE_CLASSES];
+	int           accept_op [OP_TRIE_NODES];
+	int           accept_len[OP_TRIE_NODES];
+	int           node_cnt;
+	int           class_cnt;
+	int           max_len;
+//=============================================================================
+
+	constexpr int get_class(const char c) {
+		const int code = (unsigned char) c;
+		if (!char_class[code]) {
+			char_class[code] = (unsigned char) class_cnt++;
+		}
+		return char_class[code];
+	}
+
+	constexpr void insert(const OpTrieKey &key) {
+		if (!key.key[0]) {
+			return;
+		}
+
+		int node = 0;
+		int depth = 0;
+		for (const char *c = key.key; *c; ++c, ++depth) {
+			const int cls = get_class(*c);
+			if (!next[node][cls]) {
+				next[node][cls] = (unsigned char) node_cnt++;
+			}
+			node = next[node][cls];
+		}
+
+		max_len = depth   > max_len ? depth   : max_len;
+		max_len = key.len > max_len ? key.len : max_len;
+
+		if (!accept_len[node]) { // first definition wins, as in opcodes.h order
+			accept_op [node] = key.op;
+			accept_len[node] = key.len;
+		}
+	}
+
+public:
+	constexpr OpTrie():
+	char_class(),
+	next(),
+	accept_op(),
+	accept_len(),
+	node_cnt(1),
+	class_cnt(1),
+	max_len(0)
+	{
+		for (const OpTrieKey &key : OP_TRIE_KEYS) {
+			insert(key);
+		}
+	}
+
+	constexpr int size() const {
+		return node_cnt;
+	}
+
+	constexpr int classes() const {
+		return class_cnt;
+	}
+
+	constexpr int max_length() const { // chars match() may look at, or skip, from the start
+		return max_len;
+	}
+
+	// returns true and fills op and len (amount of chars to skip) on success
+	bool match(const char *str, int *op, int *len) const {
+		int node = 0;
+		int found = 0;
+		for (const char *c = str; (unsigned char) *c < OP_TRIE_ALPHABET; ++c) {
+			node = next[node][char_class[(unsigned char) *c]];
+			if (!node) {
+				break;
+			}
+
+			if (accept_len[node]) {
+				found = node;
+			}
+		}
+
+		if (!found) {
+			return false;
+		}
+
+		*op  = accept_op [found];
+		*len = accept_len[found];
+		return true;
+	}
+};
+
+inline constexpr OpTrie OP_TRIE{}; // one object for the whole program
+
+static_assert(OP_TRIE.size()    == OP_TRIE_NODES  , "OpTrie node count is off");
+static_assert(OP_TRIE.classes() == OP_TRIE_CLASSES, "OpTrie class count is off");
+
+#endif // OP_TRIE_H
@@ -0,0 +1,150 @@
+#include "parse_memo.h"
+
+size_t ParseMemo::hash(const int rule, const int start) {
+	return ((size_t) (unsigned) start * PARSE_MEMO_MAX_RULES + (size_t) rule) * 0x9E3779B97F4A7C15ull >> 16;
+}
+
+void ParseMemo::rehash(const size_t new_capacity) {
+	ParseMemoEntry *new_table = (ParseMemoEntry*) calloc(new_capacity, sizeof(ParseMemoEntry));
+	if (!new_table) {
+		throw std::length_error("[ERR]<parse_memo>: table alloc fail");
+	}
+
+	for (size_t i = 0; i < new_capacity; ++i) {
+		new_table[i].rule = -1;
+	}
+
+	const size_t mask = new_capacity - 1;
+	for (size_t i = 0; i < capacity; ++i) {
+		if (table[i].rule < 0) {
+			continue;
+		}
+
+		size_t j = hash(table[i].rule, table[i].start) & mask;
+		while (new_table[j].rule >= 0) {
+			j = (j + 1) & mask;
+		}
+		new_table[j] = table[i];
+	}
+
+	free(table);
+	table    = new_table;
+	capacity = new_capacity;
+}
+
+ParseMemo::ParseMemo():
+table(nullptr),
+capacity(0),
+size(0),
+stats(),
+caching(false),
+counting(false)
+{}
+
+ParseMemo::~ParseMemo() {}
+
+void ParseMemo::ctor(const bool caching_, const bool counting_) {
+	table    = nullptr;
+	capacity = 0;
+	size     = 0;
+	caching  = caching_;
+	counting = counting_;
+	memset(stats, 0, sizeof(stats));
+
+	rehash(PARSE_MEMO_INIT_CAPACITY);
+}
+
+ParseMemo *ParseMemo::NEW(const bool caching_, const bool counting_) {
+	ParseMemo *cake = (ParseMemo*) calloc(1, sizeof(ParseMemo));
+	if (!cake) {
+		return nullptr;
+	}
+
+	cake->ctor(caching_, counting_);
+	return cake;
+}
+
+void ParseMemo::dtor() {
+	free(table);
+	table    = nullptr;
+	capacity = 0;
+	size     = 0;
+}
+
+void ParseMemo::DELETE(ParseMemo *memo) {
+	if (!memo) {
+		return;
+	}
+
+	memo->dtor();
+	free(memo);
+}
+
+//=============================================================================
+
+void ParseMemo::clear() {
+	for (size_t i = 0; i < capacity; ++i) {
+		table[i].rule = -1;
+	}
+	size = 0;
+	memset(stats, 0, sizeof(stats));
+}
+
+const ParseMemoEntry *ParseMemo::find(const int rule, const int start) const {
+	const size_t mask = capacity - 1;
+	for (size_t i = hash(rule, start) & mask; table[i].rule >= 0; i = (i + 1) & mask) {
+		if (table[i].rule == rule && table[i].start == start) {
+			return &table[i];
+		}
+	}
+
+	return nullptr;
+}
+
+void ParseMemo::record(const int rule, const int start, const int end, const int error, const int errpos) {
+	ParseRuleStats &stat = stats[rule];
+	++stat.calls;
+
+	if (size * 2 >= capacity) {
+		rehash(capacity * 2);
+	}
+
+	const size_t mask = capacity - 1;
+	size_t i = hash(rule, start) & mask;
+	for (; table[i].rule >= 0; i = (i + 1) & mask) {
+		if (table[i].rule == rule && table[i].start == start) {
+			++stat.repeats;
+			stat.repeat_tokens += (size_t) (end > start ? end - start : 0);
+			break;
+		}
+	}
+
+	if (table[i].rule < 0) {
+		++size;
+	}
+
+	table[i].rule   = rule;
+	table[i].start  = start;
+	table[i].end    = end;
+	table[i].error  = error;
+	table[i].errpos = errpos;
+}
+
+void ParseMemo::count_hit(const int rule) {
+	ParseRuleStats &stat = stats[rule];
+	++stat.calls;
+	++stat.repeats;
+	++stat.hits;
+}
+
+void ParseMemo::dump_stats(FILE *file, const char *const *rule_names, const int rule_cnt) const {
+	fprintf(file, "%-16s %10s %10s %14s %10s\n", "rule", "calls", "repeats", "repeat tokens", "hits");
+	for (int i = 0; i < rule_cnt; ++i) {
+		const ParseRuleStats &stat = stats[i];
+		if (!stat.calls) {
+			continue;
+		}
+
+		fprintf(file, "%-16s %10zu %10zu %14zu %10zu\n", rule_names[i], stat.calls, stat.repeats, stat.repeat_tokens, stat.hits);
+	}
+}
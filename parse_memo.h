@@ -0,0 +1,76 @@
+#ifndef PARSE_MEMO_H
+#define PARSE_MEMO_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+const int    PARSE_MEMO_MAX_RULES     = 64;
+const size_t PARSE_MEMO_INIT_CAPACITY = 1024;
+
+//=============================================================================
+// ParseMemo ==================================================================
+// Results of parser rules keyed by (rule, token index), the packrat table.
+// Only the outcome is stored: where the rule left the parser and the error it
+// set. Subtrees belong to the caller that got them, so a success is reparsed
+// and only counted.
+
+struct ParseMemoEntry {
+	int rule; // -1 is empty
+	int start;
+	int end;
+	int error;
+	int errpos;
+};
+
+struct ParseRuleStats {
+	size_t calls;
+	size_t repeats;        // calls at an index the rule was already called at
+	size_t repeat_tokens;  // tokens covered by the repeats
+	size_t hits;           // repeats answered from the table
+};
+
+class ParseMemo {
+private:
+// data =======================================================================
+	ParseMemoEntry *table;
+	size_t          capacity;
+	size_t          size;
+
+	ParseRuleStats  stats[PARSE_MEMO_MAX_RULES];
+//=============================================================================
+
+	static size_t hash(const int rule, const int start);
+
+	void rehash(const size_t new_capacity);
+
+public:
+	bool caching;   // replay failures of memoized rules
+	bool counting;  // record every rule call for the stats
+
+	ParseMemo            (const ParseMemo&) = delete;
+	ParseMemo &operator= (const ParseMemo&) = delete;
+
+	ParseMemo ();
+	~ParseMemo();
+
+	void ctor(const bool caching_, const bool counting_);
+	static ParseMemo *NEW(const bool caching_, const bool counting_);
+
+	void dtor();
+	static void DELETE(ParseMemo *memo);
+
+//=============================================================================
+
+	void clear();
+
+	const ParseMemoEntry *find(const int rule, const int start) const;
+	void record(const int rule, const int start, const int end, const int error, const int errpos);
+
+	void count_hit(const int rule);
+
+	void dump_stats(FILE *file, const char *const *rule_names, const int rule_cnt) const;
+};
+
+#endif // PARSE_MEMO_H
@@ -0,0 +1,26 @@
+// PARSE_RULE(name, memoized)
+// memoized rules replay a failure at a token index instead of parsing it again
+
+PARSE_RULE(ID               , 0)
+PARSE_RULE(NUMB             , 0)
+PARSE_RULE(UNIT             , 0)
+PARSE_RULE(DEF_VAR          , 0)
+PARSE_RULE(DEF_ARR          , 0)
+PARSE_RULE(NEW_VAR_DEF      , 0)
+PARSE_RULE(LOGIC_EXPR       , 0)
+PARSE_RULE(EXPR             , 1)
+PARSE_RULE(IF               , 0)
+PARSE_RULE(WHILE            , 0)
+PARSE_RULE(FOR              , 0)
+PARSE_RULE(DELIMITED_STMT   , 0)
+PARSE_RULE(STATEMENT        , 0)
+PARSE_RULE(BLOCK_STATEMENT  , 0)
+PARSE_RULE(PROG             , 0)
+PARSE_RULE(G                , 0)
+PARSE_RULE(ELEM_FUNC        , 0)
+PARSE_RULE(ARG_DECL         , 0)
+PARSE_RULE(ARGLIST_DECL     , 0)
+PARSE_RULE(FUNC_DECL        , 0)
+PARSE_RULE(ARG_CALL         , 0)
+PARSE_RULE(ARGLIST_CALL     , 0)
+PARSE_RULE(FUNC_CALL        , 0)
@@ -0,0 +1,644 @@
+#include "peephole.h"
+
+// rbx, rcx and rzx only carry a value to the next few instructions, so they are
+// dead at a label or a jump; rax is too when the function returns
+static bool is_scratch(const int r, const int boundary_op) {
+	if (r == REG_RBX || r == REG_RCX || r == REG_RZX) {
+		return true;
+	}
+
+	return r == REG_RAX && (boundary_op == IR_RET || boundary_op == IR_HALT);
+}
+
+static bool is_pop_to(const Instruction &instr, const int r) {
+	return instr.op == IR_POP && instr.operand.kind == OPND_REG && instr.operand.reg == r;
+}
+
+static bool is_const(const Instruction &instr, const double value) {
+	double pushed = 0;
+	return instr.op == IR_PUSH && ir_const(instr.operand, &pushed) && pushed == value;
+}
+
+static double const_value(const Instruction &instr) {
+	double pushed = 0;
+	ir_const(instr.operand, &pushed);
+	return pushed;
+}
+
+static bool is_int_const(const Instruction &instr, int *value) {
+	double pushed = 0;
+	if (instr.op != IR_PUSH || !ir_const(instr.operand, &pushed) || pushed != (int) pushed) {
+		return false;
+	}
+
+	*value = (int) pushed;
+	return true;
+}
+
+static bool is_memory(const Operand &operand) {
+	return operand.kind == OPND_MEM || operand.kind == OPND_MEM_PLUS || operand.kind == OPND_MEM_ABS;
+}
+
+static void remove(IrProgram *ir, const int at) {
+	(*ir)[at].op = IR_NONE;
+}
+
+//=============================================================================
+// rules ======================================================================
+
+// pop [x] / push [x] / pop rzx: an assignment whose value nobody takes
+static int store_discard(Peephole *, IrProgram *ir, const int *at) {
+	const Instruction &store = (*ir)[at[0]];
+	if (!ir_same_operand(store.operand, (*ir)[at[1]].operand) || !is_pop_to((*ir)[at[2]], REG_RZX)) {
+		return -1;
+	}
+
+	remove(ir, at[1]);
+	remove(ir, at[2]);
+	return 2;
+}
+
+// push x / pop rzx: an expression statement
+static int push_discard(Peephole *, IrProgram *ir, const int *at) {
+	if (!is_pop_to((*ir)[at[1]], REG_RZX)) {
+		return -1;
+	}
+
+	remove(ir, at[0]);
+	remove(ir, at[1]);
+	return 2;
+}
+
+// pop r / push r, r never read: the value was only passing through
+static int dead_stash(Peephole *peep, IrProgram *ir, const int *at) {
+	const Instruction &store = (*ir)[at[0]];
+	if (store.operand.kind != OPND_REG || !ir_same_operand(store.operand, (*ir)[at[1]].operand)
+	    || !peep->dead_after(ir, at[1], store.operand.reg)) {
+		return -1;
+	}
+
+	remove(ir, at[0]);
+	remove(ir, at[1]);
+	return 2;
+}
+
+// pop [x] / push [x] -> dup / pop [x], the value is on the stack already; a
+// register is left to dead-stash and dead-store
+static int store_reload(Peephole *, IrProgram *ir, const int *at) {
+	Instruction &store = (*ir)[at[0]];
+	Instruction &load  = (*ir)[at[1]];
+	if (!is_memory(store.operand) || !ir_same_operand(store.operand, load.operand)) {
+		return -1;
+	}
+
+	load  = store;
+	store = {IR_DUP, no_operand()};
+	return 0;
+}
+
+// push x / pop r, r never read
+static int dead_store(Peephole *peep, IrProgram *ir, const int *at) {
+	const Instruction &store = (*ir)[at[1]];
+	if (store.operand.kind != OPND_REG || !peep->dead_after(ir, at[1], store.operand.reg)) {
+		return -1;
+	}
+
+	remove(ir, at[0]);
+	remove(ir, at[1]);
+	return 2;
+}
+
+// push rvx + k / pop rax / push [rax + j] -> push [rvx + k + j]
+static int indirect_load(Peephole *peep, IrProgram *ir, const int *at) {
+	const Operand &address = (*ir)[at[0]].operand;
+	const Instruction &base = (*ir)[at[1]];
+	Instruction &load = (*ir)[at[2]];
+
+	if (address.kind != OPND_REG_PLUS || base.operand.kind != OPND_REG || address.reg == base.operand.reg) {
+		return -1;
+	}
+
+	const int r = base.operand.reg;
+	if (load.operand.reg != r || (load.operand.kind != OPND_MEM && load.operand.kind != OPND_MEM_PLUS)
+	    || !peep->dead_after(ir, at[2], r)) {
+		return -1;
+	}
+
+	const int offset = address.value + (load.operand.kind == OPND_MEM_PLUS ? load.operand.value : 0);
+	load.operand = mem_plus(address.reg, offset);
+	remove(ir, at[0]);
+	remove(ir, at[1]);
+	return 2;
+}
+
+// The constant pushed at c and added to the address that goes to a register at
+// base is moved into the offset of the access through it.
+static bool shift_offset(Peephole *peep, IrProgram *ir, const int c, const int base, const int access_at) {
+	int shift = 0;
+	const Operand &r_operand = (*ir)[base].operand;
+	Instruction &access = (*ir)[access_at];
+
+	if (!is_int_const((*ir)[c], &shift) || r_operand.kind != OPND_REG) {
+		return false;
+	}
+
+	const int r = r_operand.reg;
+	if ((access.op != IR_PUSH && access.op != IR_POP) || access.operand.reg != r
+	    || (access.operand.kind != OPND_MEM && access.operand.kind != OPND_MEM_PLUS)
+	    || !peep->dead_after(ir, access_at, r)) {
+		return false;
+	}
+
+	const int offset = shift + (access.operand.kind == OPND_MEM_PLUS ? access.operand.value : 0);
+	if (offset < 0) {
+		return false;
+	}
+
+	access.operand = mem_plus(r, offset);
+	return true;
+}
+
+// push c / add / pop rax / push [rax + j] -> pop rax / push [rax + j + c]
+static int offset_address(Peephole *peep, IrProgram *ir, const int *at) {
+	if (!shift_offset(peep, ir, at[0], at[2], at[3])) {
+		return -1;
+	}
+
+	remove(ir, at[0]);
+	remove(ir, at[1]);
+	return 2;
+}
+
+// push c / add / add / pop rax / pop [rax] -> add / pop rax / pop [rax + c], an
+// array element is an index past the array
+static int offset_sum_address(Peephole *peep, IrProgram *ir, const int *at) {
+	if (!shift_offset(peep, ir, at[0], at[3], at[4])) {
+		return -1;
+	}
+
+	remove(ir, at[0]);
+	remove(ir, at[1]);
+	return 2;
+}
+
+// push a / push b / op -> push (a op b)
+static int fold_constants(Peephole *, IrProgram *ir, const int *at) {
+	double a = 0, b = 0, result = 0;
+	Operand folded = {};
+
+	if (!ir_const((*ir)[at[0]].operand, &a) || !ir_const((*ir)[at[1]].operand, &b)
+	    || !ir_fold((*ir)[at[2]].op, a, b, &result) || !ir_literal(result, &folded)) {
+		return -1;
+	}
+
+	(*ir)[at[0]].operand = folded;
+	remove(ir, at[1]);
+	remove(ir, at[2]);
+	return 2;
+}
+
+// push -0 / add, push 0 / sub, push 1 / mul and the like leave x as it is;
+// x + 0 is not x when x is -0
+static int identity(Peephole *, IrProgram *ir, const int *at) {
+	const int op = (*ir)[at[1]].op;
+	const bool neutral_zero = (op == IR_ADD || op == IR_SUB) && is_const((*ir)[at[0]], 0)
+	                          && (std::signbit(const_value((*ir)[at[0]])) == (op == IR_ADD));
+	const bool neutral_one  = (op == IR_MUL || op == IR_DIV || op == IR_POW) && is_const((*ir)[at[0]], 1);
+	if (!neutral_zero && !neutral_one) {
+		return -1;
+	}
+
+	remove(ir, at[0]);
+	remove(ir, at[1]);
+	return 2;
+}
+
+// push r / pop r
+static int self_move(Peephole *, IrProgram *ir, const int *at) {
+	const Operand &from = (*ir)[at[0]].operand;
+	if (from.kind != OPND_REG || !ir_same_operand(from, (*ir)[at[1]].operand)) {
+		return -1;
+	}
+
+	remove(ir, at[0]);
+	remove(ir, at[1]);
+	return 2;
+}
+
+// push 0 / push c / sub / add -> push c / sub, and / sub -> push c / add;
+// c is a constant but 0, as with c = 0 the signs of zero differ
+static int negate_into(Peephole *, IrProgram *ir, const int *at) {
+	Instruction &outer = (*ir)[at[3]];
+	double c = 0;
+	if (!is_const((*ir)[at[0]], 0) || !ir_const((*ir)[at[1]].operand, &c) || c == 0
+	    || (outer.op != IR_ADD && outer.op != IR_SUB)) {
+		return -1;
+	}
+
+	if (outer.op == IR_SUB) {
+		(*ir)[at[2]].op = IR_ADD;
+	}
+
+	remove(ir, at[0]);
+	remove(ir, at[3]);
+	return 2;
+}
+
+// eq / push 0 / je L -> jne L, the comparison is the branch
+static int compare_branch(Peephole *, IrProgram *ir, const int *at) {
+	const int cmp = (*ir)[at[0]].op;
+	Instruction &branch = (*ir)[at[2]];
+
+	if ((cmp != IR_EQ && cmp != IR_NEQ) || !is_const((*ir)[at[1]], 0) || (branch.op != IR_JE && branch.op != IR_JNE)) {
+		return -1;
+	}
+
+	if (cmp == IR_EQ) {
+		branch.op = branch.op == IR_JE ? IR_JNE : IR_JE;
+	}
+
+	remove(ir, at[0]);
+	remove(ir, at[1]);
+	return 2;
+}
+
+// push a / push b / je L, both known: a jmp or nothing
+static int constant_branch(Peephole *, IrProgram *ir, const int *at) {
+	double a = 0, b = 0;
+	Instruction &branch = (*ir)[at[2]];
+
+	if ((branch.op != IR_JE && branch.op != IR_JNE)
+	    || !ir_const((*ir)[at[0]].operand, &a) || !ir_const((*ir)[at[1]].operand, &b)) {
+		return -1;
+	}
+
+	remove(ir, at[0]);
+	remove(ir, at[1]);
+	if ((a == b) == (branch.op == IR_JE)) {
+		branch.op = IR_JMP;
+		return 2;
+	}
+
+	remove(ir, at[2]);
+	return 3;
+}
+
+// je A / jmp B / A: -> jne B / A:
+static int branch_over_jump(Peephole *peep, IrProgram *ir, const int *at) {
+	Instruction &branch = (*ir)[at[0]];
+	if ((branch.op != IR_JE && branch.op != IR_JNE) || !ir_same_operand(branch.operand, (*ir)[at[2]].operand)) {
+		return -1;
+	}
+
+	branch.op      = branch.op == IR_JE ? IR_JNE : IR_JE;
+	branch.operand = (*ir)[at[1]].operand;
+	peep->add_ref(branch.operand);
+	remove(ir, at[1]);
+	return 1;
+}
+
+// jmp L / L:
+static int jump_to_next(Peephole *peep, IrProgram *ir, const int *at) {
+	const int target = peep->label_position((*ir)[at[0]].operand);
+	if (target <= at[0]) {
+		return -1;
+	}
+
+	for (int i = at[0] + 1; i < target; ++i) {
+		const int op = (*ir)[i].op;
+		if (op != IR_NONE && op != IR_BLANK && op != IR_COMMENT && op != IR_LABEL) {
+			return -1;
+		}
+	}
+
+	remove(ir, at[0]);
+	return 1;
+}
+
+// jmp L / x: x never runs
+static int unreachable(Peephole *, IrProgram *ir, const int *at) {
+	if (!ir_ends_block((*ir)[at[0]].op)) {
+		return -1;
+	}
+
+	int removed = 0;
+	for (int i = at[1]; i < ir->size() && (*ir)[i].op != IR_LABEL; ++i) {
+		const int op = (*ir)[i].op;
+		if (op != IR_NONE && op != IR_BLANK && op != IR_COMMENT) {
+			remove(ir, i);
+			++removed;
+		}
+	}
+
+	return removed;
+}
+
+// a jump to a jmp goes where that one does, down the whole chain
+static int jump_thread(Peephole *peep, IrProgram *ir, const int *at) {
+	Instruction &jump = (*ir)[at[0]];
+	if (jump.op != IR_JMP && jump.op != IR_JE && jump.op != IR_JNE) {
+		return -1;
+	}
+
+	Operand dest = jump.operand;
+	for (int hop = 0; hop < PEEPHOLE_THREAD_HOPS; ++hop) {
+		const int target = peep->label_target(ir, dest);
+		if (target < 0 || (*ir)[target].op != IR_JMP || ir_same_operand((*ir)[target].operand, dest)) {
+			break;
+		}
+
+		dest = (*ir)[target].operand;
+	}
+
+	if (ir_same_operand(dest, jump.operand)) {
+		return -1;
+	}
+
+	jump.operand = dest;
+	peep->add_ref(jump.operand);
+	return 0;
+}
+
+// nothing jumps to it
+static int dead_label(Peephole *peep, IrProgram *ir, const int *at) {
+	if (peep->label_refs((*ir)[at[0]].operand)) {
+		return -1;
+	}
+
+	remove(ir, at[0]);
+	return 0;
+}
+
+// tried in order at every instruction, the first that fits is applied
+static const PeepholeRule PEEPHOLE_RULES[] = {
+	{"store-discard",    3, {IR_POP,  IR_PUSH, IR_POP},                    store_discard},
+	{"push-discard",     2, {IR_PUSH, IR_POP},                             push_discard},
+	{"dead-stash",       2, {IR_POP,  IR_PUSH},                            dead_stash},
+	{"store-reload",     2, {IR_POP,  IR_PUSH},                            store_reload},
+	{"dead-store",       2, {IR_PUSH, IR_POP},                             dead_store},
+	{"indirect-load",    3, {IR_PUSH, IR_POP,  IR_PUSH},                   indirect_load},
+	{"offset-address",   4, {IR_PUSH, IR_ADD,  IR_POP,  IR_NONE},          offset_address},
+	{"offset-sum",       5, {IR_PUSH, IR_ADD,  IR_ADD,  IR_POP,  IR_NONE}, offset_sum_address},
+	{"fold-constants",   3, {IR_PUSH, IR_PUSH, IR_NONE},                   fold_constants},
+	{"identity",         2, {IR_PUSH, IR_NONE},                            identity},
+	{"self-move",        2, {IR_PUSH, IR_POP},                             self_move},
+	{"negate-into",      4, {IR_PUSH, IR_PUSH, IR_SUB,  IR_NONE},          negate_into},
+	{"constant-branch",  3, {IR_PUSH, IR_PUSH, IR_NONE},                   constant_branch},
+	{"compare-branch",   3, {IR_NONE, IR_PUSH, IR_NONE},                   compare_branch},
+	{"branch-over-jump", 3, {IR_NONE, IR_JMP,  IR_LABEL},                  branch_over_jump},
+	{"jump-to-next",     1, {IR_JMP},                                      jump_to_next},
+	{"unreachable",      2, {IR_NONE, IR_NONE},                            unreachable},
+	{"jump-thread",      1, {IR_NONE},                                     jump_thread},
+	{"dead-label",       1, {IR_LABEL},                                    dead_label},
+};
+
+static const int PEEPHOLE_RULE_CNT = (int) (sizeof(PEEPHOLE_RULES) / sizeof(PEEPHOLE_RULES[0]));
+
+//=============================================================================
+// Peephole ===================================================================
+
+Peephole::Peephole():
+labels(nullptr),
+capacity(0),
+stats(nullptr)
+{}
+
+Peephole::~Peephole() {}
+
+void Peephole::ctor() {
+	capacity = PEEPHOLE_INIT_LABELS;
+	labels   = (PeepholeLabel*) calloc(capacity, sizeof(PeepholeLabel));
+	stats    = (PeepholeRuleStats*) calloc(PEEPHOLE_RULE_CNT, sizeof(PeepholeRuleStats));
+	if (!labels || !stats) {
+		throw std::length_error("[ERR]<peephole>: calloc fail");
+	}
+}
+
+Peephole *Peephole::NEW() {
+	Peephole *cake = (Peephole*) calloc(1, sizeof(Peephole));
+	if (!cake) {
+		return nullptr;
+	}
+
+	cake->ctor();
+	return cake;
+}
+
+void Peephole::dtor() {
+	free(labels);
+	free(stats);
+	labels   = nullptr;
+	stats    = nullptr;
+	capacity = 0;
+}
+
+void Peephole::DELETE(Peephole *peephole) {
+	if (!peephole) {
+		return;
+	}
+
+	peephole->dtor();
+	free(peephole);
+}
+
+//=============================================================================
+
+size_t Peephole::hash(const Operand &name) {
+	size_t h = ((size_t) name.label * 1000003u + (size_t) name.value) * 1000003u + (size_t) name.sym;
+	h *= 0x9E3779B97F4A7C15u;
+	return h ^ (h >> 32);
+}
+
+PeepholeLabel *Peephole::find_label(const Operand &name) const {
+	for (size_t i = hash(name) & (capacity - 1); ; i = (i + 1) & (capacity - 1)) {
+		if (labels[i].name.kind == OPND_NONE || ir_same_operand(labels[i].name, name)) {
+			return &labels[i];
+		}
+	}
+}
+
+void Peephole::index_labels(const IrProgram *ir) {
+	size_t needed = PEEPHOLE_INIT_LABELS;
+	for (int i = 0; i < ir->size(); ++i) {
+		if ((*ir)[i].op == IR_LABEL || ir_is_jump((*ir)[i].op)) {
+			++needed;
+		}
+	}
+
+	if (needed * 2 > capacity) {
+		while (needed * 2 > capacity) {
+			capacity *= 2;
+		}
+
+		free(labels);
+		labels = (PeepholeLabel*) calloc(capacity, sizeof(PeepholeLabel));
+		if (!labels) {
+			throw std::length_error("[ERR]<peephole>: labels calloc fail");
+		}
+	} else {
+		memset(labels, 0, capacity * sizeof(PeepholeLabel));
+	}
+
+	for (int i = 0; i < ir->size(); ++i) {
+		const Instruction &instr = (*ir)[i];
+		if (instr.op != IR_LABEL && !ir_is_jump(instr.op)) {
+			continue;
+		}
+
+		PeepholeLabel *label = find_label(instr.operand);
+		if (label->name.kind == OPND_NONE) {
+			label->name     = instr.operand;
+			label->position = -1;
+		}
+
+		if (instr.op == IR_LABEL) {
+			label->position = i;
+		} else {
+			++label->refs;
+		}
+	}
+}
+
+bool Peephole::match(const IrProgram *ir, const int start, const PeepholeRule &rule, int *at) const {
+	const Instruction *code = &(*ir)[0];
+	const int          size = ir->size();
+
+	int i = start;
+	for (int j = 0; j < rule.length; ++i, ++j) {
+		while (i < size && (code[i].op == IR_NONE || code[i].op == IR_BLANK || code[i].op == IR_COMMENT)) {
+			++i;
+		}
+
+		if (i >= size) {
+			return false;
+		}
+
+		const int op = code[i].op;
+		if (rule.pattern[j] == IR_NONE ? op == IR_LABEL : op != rule.pattern[j]) {
+			return false;
+		}
+
+		at[j] = i;
+	}
+
+	return true;
+}
+
+int Peephole::optimize(IrProgram *ir) {
+	int removed = 0;
+	int at[PEEPHOLE_MAX_WINDOW] = {};
+
+	for (int pass = 0; pass < PEEPHOLE_MAX_PASSES; ++pass) {
+		index_labels(ir);
+
+		bool changed = false;
+		for (int i = 0; i < ir->size(); ++i) {
+			const int op = (*ir)[i].op;
+			if (op == IR_NONE || op == IR_BLANK || op == IR_COMMENT) {
+				continue;
+			}
+
+			for (int r = 0; r < PEEPHOLE_RULE_CNT; ++r) {
+				const PeepholeRule &rule = PEEPHOLE_RULES[r];
+				if ((rule.pattern[0] != IR_NONE && rule.pattern[0] != op) || !match(ir, i, rule, at)) {
+					continue;
+				}
+
+				const int rule_removed = rule.rewrite(this, ir, at);
+				if (rule_removed < 0) {
+					continue;
+				}
+
+				stats[r].fired   += 1;
+				stats[r].removed += (size_t) rule_removed;
+				removed += rule_removed;
+				changed  = true;
+				break;
+			}
+		}
+
+		ir->compact();
+		if (!changed) {
+			break;
+		}
+	}
+
+	return removed;
+}
+
+//=============================================================================
+
+void Peephole::add_ref(const Operand &name) {
+	PeepholeLabel *label = find_label(name);
+	if (label->name.kind != OPND_NONE) {
+		++label->refs;
+	}
+}
+
+int Peephole::label_refs(const Operand &name) const {
+	const PeepholeLabel *label = find_label(name);
+	return label->name.kind == OPND_NONE ? 0 : label->refs;
+}
+
+int Peephole::label_position(const Operand &name) const {
+	const PeepholeLabel *label = find_label(name);
+	return label->name.kind == OPND_NONE ? -1 : label->position;
+}
+
+int Peephole::label_target(const IrProgram *ir, const Operand &name) const {
+	const int position = label_position(name);
+	if (position < 0) {
+		return -1;
+	}
+
+	for (int i = position + 1; i < ir->size(); ++i) {
+		const int op = (*ir)[i].op;
+		if (op != IR_NONE && op != IR_BLANK && op != IR_COMMENT && op != IR_LABEL) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+bool Peephole::dead_after(const IrProgram *ir, const int position, const int r) const {
+	int seen = 0;
+	for (int i = position + 1; i < ir->size() && seen < PEEPHOLE_LIVENESS_SCAN; ++i) {
+		const Instruction &instr = (*ir)[i];
+		if (instr.op == IR_NONE || instr.op == IR_BLANK || instr.op == IR_COMMENT) {
+			continue;
+		}
+		++seen;
+
+		if (ir_reads(instr, r)) {
+			return false;
+		}
+
+		if (is_pop_to(instr, r)) {
+			return true;
+		}
+
+		if (instr.op == IR_LABEL || ir_is_jump(instr.op) || ir_ends_block(instr.op)) {
+			return is_scratch(r, instr.op);
+		}
+	}
+
+	return seen < PEEPHOLE_LIVENESS_SCAN;
+}
+
+void Peephole::dump_stats(FILE *file) const {
+	size_t fired   = 0;
+	size_t removed = 0;
+
+	fprintf(file, "%-18s %10s %10s\n", "rule", "fired", "removed");
+	for (int i = 0; i < PEEPHOLE_RULE_CNT; ++i) {
+		if (!stats[i].fired) {
+			continue;
+		}
+
+		fprintf(file, "%-18s %10zu %10zu\n", PEEPHOLE_RULES[i].name, stats[i].fired, stats[i].removed);
+		fired   += stats[i].fired;
+		removed += stats[i].removed;
+	}
+	fprintf(file, "%-18s %10zu %10zu\n", "total", fired, removed);
+}
@@ -0,0 +1,88 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include "ir.h"
+
+const int    PEEPHOLE_MAX_WINDOW     = 5;
+const int    PEEPHOLE_MAX_PASSES     = 16;
+const int    PEEPHOLE_LIVENESS_SCAN  = 64;   // instructions looked ahead for a register read
+const int    PEEPHOLE_THREAD_HOPS    = 64;   // jumps followed to thread one jump
+const size_t PEEPHOLE_INIT_LABELS    = 1024;
+
+class Peephole;
+
+// A rule matches a window of instructions by opcodes (IR_NONE matches any
+// instruction but a label) and rewrites it in place: removed ones become
+// IR_NONE. rewrite() returns how many it removed, -1 if the operands do not
+// fit the rule.
+struct PeepholeRule {
+	const char *name;
+	int         length;
+	int         pattern[PEEPHOLE_MAX_WINDOW];
+	int       (*rewrite)(Peephole *peep, IrProgram *ir, const int *at);
+};
+
+struct PeepholeLabel {
+	Operand name; // kind is OPND_NONE in an empty slot
+	int     refs;
+	int     position;
+};
+
+struct PeepholeRuleStats {
+	size_t fired;
+	size_t removed;
+};
+
+//=============================================================================
+// Peephole ===================================================================
+// Rewrites the code of an IrProgram by the rules of PEEPHOLE_RULES, pass after
+// pass, until a pass changes nothing. Blank lines and comments are looked
+// through, labels end a window unless the rule asks for one.
+
+class Peephole {
+private:
+// data =======================================================================
+	PeepholeLabel     *labels;
+	size_t             capacity;
+	PeepholeRuleStats *stats;
+//=============================================================================
+
+	static size_t hash(const Operand &name);
+
+	PeepholeLabel *find_label(const Operand &name) const;
+	void index_labels(const IrProgram *ir);
+
+	bool match(const IrProgram *ir, const int start, const PeepholeRule &rule, int *at) const;
+
+public:
+	Peephole            (const Peephole&) = delete;
+	Peephole &operator= (const Peephole&) = delete;
+
+	Peephole ();
+	~Peephole();
+
+	void ctor();
+	static Peephole *NEW();
+
+	void dtor();
+	static void DELETE(Peephole *peephole);
+
+//=============================================================================
+
+	int optimize(IrProgram *ir); // returns the instructions removed
+
+	void add_ref       (const Operand &name); // a rule made one more jump to it
+	int  label_refs    (const Operand &name) const;
+	int  label_position(const Operand &name) const; // -1 if unknown
+	int  label_target  (const IrProgram *ir, const Operand &name) const; // the first instruction after the label, -1 if unknown
+	bool dead_after    (const IrProgram *ir, const int position, const int r) const; // r is written before it is read again
+
+	void dump_stats(FILE *file) const;
+};
+
+#endif // PEEPHOLE_H
@@ -1,19 +1,21 @@
 #include "recursive_parser.h"
 
-#define NEXT()  ++cur_index;       cur = &(*expr)[cur_index]
-#define PREV()  --cur_index;       cur = &(*expr)[cur_index]
-#define SETI(ind) cur_index = ind; cur = &(*expr)[cur_index]
+#include <thread>
 
-#define RESET_POINT int ENTER_INDEX
+#define NEXT()  ++cur_index;       expr->fetch(cur_index, cur)
+#define PREV()  --cur_index;       expr->fetch(cur_index, cur)
+#define SETI(ind) cur_index = ind; expr->fetch(cur_index, cur)
+
+#define RESET_POINT TokenPin ENTER_PIN(expr, (size_t) cur_index); int ENTER_INDEX
 #define RESET() SETI(ENTER_INDEX)
 
-#define NEW_NODE(type, data, l, r) ParseNode::NEW(type, data, l, r, cur->line, cur->pos)
+#define NEW_NODE(type, data, l, r) ParseNode::NEW(type, data, l, r, expr->line(cur_index, &line_hint), expr->pos(cur_index))
 
 #define REQUIRE_OP(op)                                  \
 	do {                                                \
 		if (cur->type != T_OP || cur->data.op != op) {  \
 			ERROR  = ERROR_SYNTAX;                      \
-			ERRPOS = cur;                               \
+			ERRPOS = cur_index;                         \
 			return nullptr;                             \
 		} else {                                        \
 			NEXT();                                     \
@@ -24,39 +26,171 @@
 	ParseNode *ret_name = (code);                 \
 	if (ERROR) {                                  \
 		cur_index = index;                        \
-		cur = &(*expr)[cur_index];                \
-		SET_ERR(0, &(*expr)[0]);                  \
+		expr->fetch(cur_index, cur);              \
+		SET_ERR(0, 0);                            \
 	} else
 
 #define SET_ERR(errcode, errpos) do {ERROR = errcode; ERRPOS = errpos;} while (0)
 
-bool RecursiveParser::is_id_char(const char c) {
-	return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || c == '_';
-}
+// op codes and single character ops are all below it
+const int OP_CODE_CNT = 512;
 
-bool RecursiveParser::is_digit(const char c) {
-	return ('0' <= c && c <= '9');
-}
+//=============================================================================
+// OpPowerTable ===============================================================
+// Binding powers from op_powers.h indexed by the token op code.
 
-bool RecursiveParser::is_sign(const char c) {
-	return c == '+' || c == '-';
-}
+struct OpPower {
+	int infix;
+	int prefix;
+	int right_assoc;
+};
+
+struct OpPowerDef {
+	int op;
+	OpPower power;
+};
+
+#define OPPOWER(op, infix, prefix, right_assoc) {op, {infix, prefix, right_assoc}},
+
+constexpr OpPowerDef OP_POWER_DEFS[] = {
+	#include "op_powers.h"
+};
+
+#undef OPPOWER
+
+struct OpPowerTable {
+	OpPower power[OP_CODE_CNT];
+
+	constexpr OpPowerTable() : power() {
+		for (OpPower &unused : power) {
+			unused = {0, 0, 0};
+		}
+		for (const OpPowerDef &def : OP_POWER_DEFS) {
+			power[def.op] = def.power;
+		}
+	}
+
+	constexpr const OpPower &of(const Token *t) const {
+		return (t->type == T_OP && (unsigned) t->data.op < (unsigned) OP_CODE_CNT) ? power[t->data.op] : power[0];
+	}
+};
+
+static constexpr OpPowerTable OP_POWERS;
+
+//=============================================================================
+// FirstTable =================================================================
+// Tokens every rule can start with, generated from grammar.gr by grammar_gen.
+// A rule that can't start with the current token fails without touching the
+// stream, so its wrapper fails right away instead of entering it.
+
+struct FirstTable {
+	bool nullable[RULE_CNT];
+	bool token   [RULE_CNT][T_OP];
+	bool op      [RULE_CNT][OP_CODE_CNT];
+
+	constexpr FirstTable() : nullable(), token(), op() {
+		for (int rule = 0; rule < RULE_CNT; ++rule) {
+			nullable[rule] = false;
+			for (bool &unused : token[rule]) {
+				unused = false;
+			}
+			for (bool &unused : op[rule]) {
+				unused = false;
+			}
+		}
+
+		#define GRAMMAR_RULE(name, can_be_empty) nullable[RULE_##name] = can_be_empty;
+		#define GRAMMAR_FIRST(name, type, code) add(RULE_##name, type, code);
 
-bool RecursiveParser::is_sign(const Token *t) {
-	return t->is_op('+') || t->is_op('-');
+		#include "grammar_first.h"
+
+		#undef GRAMMAR_RULE
+		#undef GRAMMAR_FIRST
+	}
+
+	constexpr void add(const int rule, const int type, const int code) {
+		if (type == T_OP) {
+			op[rule][code] = true;
+		} else {
+			token[rule][type] = true;
+		}
+	}
+
+	constexpr bool predicts(const int rule, const Token *t) const {
+		if (nullable[rule]) {
+			return true;
+		}
+
+		if (t->type == T_OP) {
+			return (unsigned) t->data.op < (unsigned) OP_CODE_CNT && op[rule][t->data.op];
+		}
+
+		return token[rule][t->type];
+	}
+};
+
+static constexpr FirstTable GRAMMAR_FIRST;
+
+#define PARSE_RULE(name, memoized)                                                  \
+	ParseNode *RecursiveParser::parse_##name() {                                    \
+		if (!GRAMMAR_FIRST.predicts(RULE_##name, cur)) {                            \
+			SET_ERR(ERROR_SYNTAX, cur_index);                                       \
+			return nullptr;                                                         \
+		}                                                                           \
+		if (memo && (memoized || memo->counting)) {                                 \
+			return memo_call(RULE_##name, memoized, &RecursiveParser::rule_##name); \
+		}                                                                           \
+		return rule_##name();                                                       \
+	}
+
+#include "parse_rules.h"
+
+#undef PARSE_RULE
+
+#define PARSE_RULE(name, memoized) #name,
+
+static const char *const PARSE_RULE_NAMES[] = {
+	#include "parse_rules.h"
+};
+
+#undef PARSE_RULE
+
+
+ParseNode *RecursiveParser::memo_call(const int rule, const bool memoized, ParseNode *(RecursiveParser::*rule_func)()) {
+	if (ERROR) { // rules are entered with no error set, this is not a state worth a key
+		return (this->*rule_func)();
+	}
+
+	const int start = cur_index;
+	if (memoized && memo->caching) {
+		const ParseMemoEntry *entry = memo->find(rule, start);
+		if (entry && entry->error && !expr->released((size_t) entry->end)) {
+			memo->count_hit(rule);
+			SETI(entry->end);
+			SET_ERR(entry->error, entry->errpos);
+			return nullptr;
+		}
+	}
+
+	ParseNode *ret = (this->*rule_func)();
+	if (memo->counting || (memoized && memo->caching && ERROR)) {
+		memo->record(rule, start, cur_index, ERROR, ERRPOS);
+	}
+
+	return ret;
 }
 
-bool RecursiveParser::is_multiplicative(const char c) {
-	return c == '*' || c == '/';
+bool RecursiveParser::is_id_char(const char c) {
+	return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || c == '_';
 }
 
-bool RecursiveParser::is_multiplicative(const Token *t) {
-	return t->is_op('*') || t->is_op('/');
+bool RecursiveParser::is_digit(const char c) {
+	return ('0' <= c && c <= '9');
 }
 
-ParseNode *RecursiveParser::parse_ID() {
+ParseNode *RecursiveParser::rule_ID() {
 	if (!cur->is_id()) {
-		SET_ERR(ERROR_SYNTAX, cur);
+		SET_ERR(ERROR_SYNTAX, cur_index);
 		return nullptr;
 	}
 
@@ -65,9 +199,9 @@ ParseNode *RecursiveParser::parse_ID() {
 	return ret;
 }
 
-ParseNode *RecursiveParser::parse_NUMB() {
+ParseNode *RecursiveParser::rule_NUMB() {
 	if (!cur->is_number()) {
-		SET_ERR(ERROR_SYNTAX, cur);
+		SET_ERR(ERROR_SYNTAX, cur_index);
 		return nullptr;
 	}
 	CodeNode *ret = NEW_NODE(VALUE, cur->data.num, nullptr, nullptr);
@@ -75,7 +209,7 @@ ParseNode *RecursiveParser::parse_NUMB() {
 	return ret;
 }
 
-ParseNode *RecursiveParser::parse_UNIT() {
+ParseNode *RecursiveParser::rule_UNIT() {
 	IF_PARSED (cur_index, unit_id, parse_ID()) {
 		if (cur->is_op('(')) {
 			NEXT();
@@ -88,7 +222,7 @@ ParseNode *RecursiveParser::parse_UNIT() {
 			}
 
 			NEXT();
-			SET_ERR(ERROR_SYNTAX, cur);
+			SET_ERR(ERROR_SYNTAX, cur_index);
 			ParseNode::DELETE(unit_id);
 			return nullptr;
 		} else if (cur->is_op('[')) {
@@ -100,7 +234,7 @@ ParseNode *RecursiveParser::parse_UNIT() {
 			}
 
 			ParseNode::DELETE(func_call, true);
-			SET_ERR(ERROR_SYNTAX, cur);
+			SET_ERR(ERROR_SYNTAX, cur_index);
 			return nullptr;
 		} else {
 			return unit_id;
@@ -118,7 +252,7 @@ ParseNode *RecursiveParser::parse_UNIT() {
 			}
 		}
 		NEXT();
-		SET_ERR(ERROR_SYNTAX, cur);
+		SET_ERR(ERROR_SYNTAX, cur_index);
 		return nullptr;
 	}
 
@@ -130,65 +264,13 @@ ParseNode *RecursiveParser::parse_UNIT() {
 		return number;
 	}
 
-	SET_ERR(ERROR_SYNTAX, cur);
+	SET_ERR(ERROR_SYNTAX, cur_index);
 	return nullptr;
 }
 
-ParseNode *RecursiveParser::parse_FACT() {
-	if (is_sign(cur)) {
-		int sign = cur->get_op();
-		NEXT();
-		IF_PARSED (cur_index, fact, parse_FACT()) {
-			return NEW_NODE(OPERATION, sign, nullptr, fact);
-		}
-		SET_ERR(ERROR_SYNTAX, cur);
-		return nullptr;
-	}
-
-	IF_PARSED (cur_index, unit, parse_UNIT()) {
-		if (cur->is_op('^')) {
-			NEXT();
-			IF_PARSED (cur_index, fact, parse_FACT()) {
-				return NEW_NODE(OPERATION, '^', unit, fact);
-			}
-			ParseNode::DELETE(unit);
-			SET_ERR(ERROR_SYNTAX, cur);
-			return nullptr;
-		} else {
-			return unit;
-		}
-	}
-	
-	SET_ERR(ERROR_SYNTAX, cur);
-	return nullptr;
-}
-
-ParseNode *RecursiveParser::parse_TERM() {
-	IF_PARSED (cur_index, fact, parse_FACT()) {
-		while (is_multiplicative(cur)) {
-			int op = cur->get_op();
-			NEXT();
-
-			IF_PARSED (cur_index, next_fact, parse_FACT()) {
-				fact = NEW_NODE(OPERATION, op, fact, next_fact);
-				continue;
-			}
-
-			ParseNode::DELETE(fact, true);
-			SET_ERR(ERROR_SYNTAX, cur);
-			return nullptr;
-		}
-
-		return fact;
-	}
-
-	SET_ERR(ERROR_SYNTAX, cur);
-	return nullptr;
-}
-
-ParseNode *RecursiveParser::parse_DEF_VAR() {
+ParseNode *RecursiveParser::rule_DEF_VAR() {
 	if (!cur->is_op(OPCODE_VAR)) {
-		SET_ERR(ERROR_SYNTAX, cur);
+		SET_ERR(ERROR_SYNTAX, cur_index);
 		return nullptr;
 	}
 
@@ -206,7 +288,7 @@ ParseNode *RecursiveParser::parse_DEF_VAR() {
 			PREV();
 			PREV();
 			ParseNode::DELETE(var_definition, true);
-			SET_ERR(ERROR_SYNTAX, cur);
+			SET_ERR(ERROR_SYNTAX, cur_index);
 			return nullptr;
 		} else {
 			return var_definition;
@@ -214,15 +296,15 @@ ParseNode *RecursiveParser::parse_DEF_VAR() {
 	}
 
 	PREV();
-	SET_ERR(ERROR_SYNTAX, cur);
+	SET_ERR(ERROR_SYNTAX, cur_index);
 	return nullptr;
 }
 
-ParseNode *RecursiveParser::parse_DEF_ARR() {
+ParseNode *RecursiveParser::rule_DEF_ARR() {
 	RESET_POINT = cur_index;
 
 	if (!cur->is_op(OPCODE_VAR)) {
-		SET_ERR(ERROR_SYNTAX, cur);
+		SET_ERR(ERROR_SYNTAX, cur_index);
 		return nullptr;
 	}
 
@@ -245,16 +327,16 @@ ParseNode *RecursiveParser::parse_DEF_ARR() {
 
 		RESET();
 		ParseNode::DELETE(arr_def, true);
-		SET_ERR(ERROR_SYNTAX, cur);
+		SET_ERR(ERROR_SYNTAX, cur_index);
 		return nullptr;
 	}
 
 	RESET();
-	SET_ERR(ERROR_SYNTAX, cur);
+	SET_ERR(ERROR_SYNTAX, cur_index);
 	return nullptr;
 }
 
-ParseNode *RecursiveParser::parse_NEW_VAR_DEF() {
+ParseNode *RecursiveParser::rule_NEW_VAR_DEF() {
 	IF_PARSED (cur_index, arr, parse_DEF_ARR()) {
 		return arr;
 	}
@@ -263,114 +345,142 @@ ParseNode *RecursiveParser::parse_NEW_VAR_DEF() {
 		return var;
 	}
 
-	SET_ERR(ERROR_SYNTAX, cur);
+	SET_ERR(ERROR_SYNTAX, cur_index);
 	return nullptr;
 }
 
-ParseNode *RecursiveParser::parse_MATH_EXPR() {
-	IF_PARSED (cur_index, term, parse_TERM()) {
-		while (is_sign(cur)) {
-			int op = cur->get_op();
-			NEXT();
-
-			IF_PARSED (cur_index, next_term, parse_TERM()) {
-				term = NEW_NODE(OPERATION, op, term, next_term);
-				continue;
-			}
-
-			ParseNode::DELETE(term, true);
-			SET_ERR(ERROR_SYNTAX, cur);
-			return nullptr;
-		}
+bool RecursiveParser::is_asgn_op(const Token *token) {
+	return token->is_op('=') || token->is_op(OPCODE_ASGN_ADD)
+	                         || token->is_op(OPCODE_ASGN_SUB)
+	                         || token->is_op(OPCODE_ASGN_MUL)
+	                         || token->is_op(OPCODE_ASGN_DIV)
+	                         || token->is_op(OPCODE_ASGN_POW);
+}
 
-		return term;
+// '(' with an EXPR in it that is not an assignment to an id, the only bracket
+// parse_operators() opens itself, anything else goes through parse_UNIT()
+bool RecursiveParser::is_plain_bracket() {
+	if (!cur->is_op('(')) {
+		return false;
 	}
 
-	SET_ERR(ERROR_SYNTAX, cur);
-	return nullptr;
-} 
+	NEXT();
+	bool plain = !cur->is_id();
+	if (!plain) {
+		NEXT();
+		plain = !is_asgn_op(cur);
+		PREV();
+	}
+	PREV();
 
-ParseNode *RecursiveParser::parse_COND() {
-	IF_PARSED (cur_index, cur_expr, parse_MATH_EXPR()) {
-		while (cur->is_op('>') || cur->is_op('<') ||
-			   cur->is_op(OPCODE_LE) || cur->is_op(OPCODE_GE ) ||
-			   cur->is_op(OPCODE_EQ) || cur->is_op(OPCODE_NEQ)) {
-			int op = cur->get_op();
-			NEXT();
+	return plain;
+}
 
-			IF_PARSED (cur_index, next_expr, parse_MATH_EXPR()) {
-				cur_expr = NEW_NODE(OPERATION, op, cur_expr, next_expr);
+// Precedence climbing with the pending operators on operator_stack instead of the
+// native one, so prefix chains, right-assoc chains and nested brackets take no
+// recursion. Frames above base wait for the operand being parsed: a prefix op, an
+// infix op with its left side, or a bracket whose LOGIC_EXPR it is. Nodes, their
+// positions and every error position are the ones the recursive rules produce.
+ParseNode *RecursiveParser::parse_operators(const int min_power) {
+	const size_t base = operator_stack.size();
+	int power = min_power;
+	ParseNode *left = nullptr;
+
+	while (true) {
+		if (!left) { // an operand: prefix ops and brackets open frames until a unit
+			const OpPower &prefix = OP_POWERS.of(cur);
+			if (prefix.prefix) {
+				operator_stack.push_back({OPERATOR_PREFIX, cur->get_op(), power, nullptr});
+				power = prefix.prefix;
+				NEXT();
 				continue;
 			}
 
-			ParseNode::DELETE(cur_expr, true);
-			SET_ERR(ERROR_SYNTAX, cur);
-			return nullptr;
-		}
-
-		return cur_expr;
-	}
-
-	SET_ERR(ERROR_SYNTAX, cur);
-	return nullptr;
-}
-
-ParseNode *RecursiveParser::parse_AND_EXPR() {
-	IF_PARSED (cur_index, cur_cond, parse_COND()) {
-		while (cur->is_op(OPCODE_AND)) {
-			int op = cur->get_op();
-			NEXT();
+			if (is_plain_bracket()) {
+				operator_stack.push_back({OPERATOR_BRACKET, '(', power, nullptr});
+				NEXT();
+				if (!GRAMMAR_FIRST.predicts(RULE_EXPR, cur) || !GRAMMAR_FIRST.predicts(RULE_LOGIC_EXPR, cur)) {
+					break;
+				}
 
-			IF_PARSED (cur_index, next_cond, parse_COND()) {
-				cur_cond = NEW_NODE(OPERATION, op, cur_cond, next_cond);
+				power = 1;
 				continue;
 			}
 
-			ParseNode::DELETE(cur_cond, true);
-			SET_ERR(ERROR_SYNTAX, cur);
-			return nullptr;
+			left = parse_UNIT();
+			if (ERROR) {
+				left = nullptr;
+				break;
+			}
 		}
 
-		return cur_cond;
-	}
+		const OpPower &infix = OP_POWERS.of(cur);
+		if (infix.infix >= power) {
+			operator_stack.push_back({OPERATOR_INFIX, cur->get_op(), power, left});
+			power = infix.right_assoc ? infix.infix : infix.infix + 1;
+			left  = nullptr;
+			NEXT();
+			continue;
+		}
 
-	SET_ERR(ERROR_SYNTAX, cur);
-	return nullptr;
-}
+		if (operator_stack.size() == base) {
+			return left;
+		}
 
-ParseNode *RecursiveParser::parse_LOGIC_EXPR() {
-	IF_PARSED (cur_index, cur_and_node, parse_AND_EXPR()) {
-		while (cur->is_op(OPCODE_OR)) {
-			int op = cur->get_op();
-			NEXT();
+		OperatorFrame frame = operator_stack.pop_back();
+		power = frame.power;
 
-			IF_PARSED (cur_index, next_and_node, parse_AND_EXPR()) {
-				cur_and_node = NEW_NODE(OPERATION, op, cur_and_node, next_and_node);
-				continue;
+		if (frame.kind == OPERATOR_PREFIX) {
+			left = NEW_NODE(OPERATION, frame.op, nullptr, left);
+		} else if (frame.kind == OPERATOR_INFIX) {
+			left = NEW_NODE(OPERATION, frame.op, frame.left, left);
+		} else { // the rest of EXPR, then of UNIT
+			if (is_asgn_op(cur)) {
+				int op = cur->get_op();
+				NEXT();
+
+				ParseNode *expr_node = parse_EXPR();
+				if (ERROR) {
+					SET_ERR(0, 0);
+					PREV();
+				} else {
+					left = NEW_NODE(OPERATION, op, left, expr_node);
+				}
 			}
 
-			ParseNode::DELETE(cur_and_node, true);
-			SET_ERR(ERROR_SYNTAX, cur);
-			return nullptr;
+			if (!cur->is_op(')')) {
+				ParseNode::DELETE(left);
+				left = nullptr;
+				NEXT();
+				break;
+			}
+			NEXT();
 		}
+	}
 
-		return cur_and_node;
+	while (operator_stack.size() > base) { // every pending frame fails the way its rule does
+		OperatorFrame frame = operator_stack.pop_back();
+		if (frame.kind == OPERATOR_INFIX) {
+			ParseNode::DELETE(frame.left, true);
+		} else if (frame.kind == OPERATOR_BRACKET) {
+			NEXT();
+		}
 	}
 
-	SET_ERR(ERROR_SYNTAX, cur);
+	SET_ERR(ERROR_SYNTAX, cur_index);
 	return nullptr;
 }
 
-ParseNode *RecursiveParser::parse_EXPR() {
+ParseNode *RecursiveParser::rule_LOGIC_EXPR() {
+	return parse_operators(1);
+}
+
+ParseNode *RecursiveParser::rule_EXPR() {
 	if (cur->is_id()) {
 		ParseNode *id = NEW_NODE(ID, cur->data.id, nullptr, nullptr);
 		NEXT();
 
-		if (cur->is_op('=') || cur->is_op(OPCODE_ASGN_ADD)
-							|| cur->is_op(OPCODE_ASGN_SUB)
-							|| cur->is_op(OPCODE_ASGN_MUL)
-							|| cur->is_op(OPCODE_ASGN_DIV)
-							|| cur->is_op(OPCODE_ASGN_POW)) {
+		if (is_asgn_op(cur)) {
 			int op = cur->get_op();
 			NEXT();
 
@@ -386,11 +496,7 @@ ParseNode *RecursiveParser::parse_EXPR() {
 	}
 
 	IF_PARSED (cur_index, logic_expr_node, parse_LOGIC_EXPR()) {
-		if (cur->is_op('=') || cur->is_op(OPCODE_ASGN_ADD)
-							|| cur->is_op(OPCODE_ASGN_SUB)
-							|| cur->is_op(OPCODE_ASGN_MUL)
-							|| cur->is_op(OPCODE_ASGN_DIV)
-							|| cur->is_op(OPCODE_ASGN_POW)) {
+		if (is_asgn_op(cur)) {
 			int op = cur->get_op();
 			NEXT();
 
@@ -404,73 +510,188 @@ ParseNode *RecursiveParser::parse_EXPR() {
 		return logic_expr_node;
 	}
 
-	SET_ERR(ERROR_SYNTAX, cur);
+	SET_ERR(ERROR_SYNTAX, cur_index);
 	return nullptr;
 }
 
-ParseNode *RecursiveParser::parse_IF() {
-	RESET_POINT = cur_index;
+ParseNode *RecursiveParser::rule_DELIMITED_STMT() {
+	if (cur->is_op(OPCODE_BREAK)) {
+		NEXT();
+		return NEW_NODE(OPERATION, OPCODE_BREAK, nullptr, nullptr);
+	}
+
+	if (cur->is_op(OPCODE_CONTINUE)) {
+		NEXT();
+		return NEW_NODE(OPERATION, OPCODE_CONTINUE, nullptr, nullptr);
+	}
+
+	IF_PARSED (cur_index, var_def, parse_NEW_VAR_DEF()) {
+		return var_def;
+	}
+
+	IF_PARSED (cur_index, expr_node, parse_EXPR()) {
+		return expr_node;
+	}
+
+	SET_ERR(ERROR_SYNTAX, cur_index);
+	return nullptr;
+}
+
+//=============================================================================
+// Statements =================================================================
+// A nested rule is entered by pushing its frame, the loop steps the top frame
+// with what the frame above it returned. Every step does what the recursive
+// rule did between two nested calls, so resets, errors and trees are the same.
+
+ParseNode *RecursiveParser::parse_statements(const int rule) {
+	const size_t base = block_stack.size();
+	block_stack.push_back({rule, 0, cur_index, false, nullptr, nullptr});
+
+	ParseNode *got = nullptr;
+	while (true) {
+		const size_t top   = block_stack.size() - 1;
+		BlockFrame  &frame = block_stack[top];
+
+		// what parse_X() checks before it enters rule_X(), parse_X() itself did it for the base
+		if (top > base && frame.stage == 0 && frame.rule != BLOCK_FRAME_OPEN && !GRAMMAR_FIRST.predicts(frame.rule, cur)) {
+			block_stack.pop_back();
+			SET_ERR(ERROR_SYNTAX, cur_index);
+			got = nullptr;
+			continue;
+		}
+
+		ParseNode *ret = nullptr;
+		switch (frame.rule) {
+			case BLOCK_FRAME_OPEN     : ret = step_open_block     (top, got); break;
+			case RULE_BLOCK_STATEMENT : ret = step_BLOCK_STATEMENT(top, got); break;
+			case RULE_STATEMENT       : ret = step_STATEMENT      (top, got); break;
+			case RULE_IF              : ret = step_IF             (top, got); break;
+			case RULE_WHILE           : ret = step_WHILE          (top, got); break;
+			case RULE_FOR             : ret = step_FOR            (top, got); break;
+			case RULE_FUNC_DECL       : ret = step_FUNC_DECL      (top, got); break;
+			default:
+				throw std::logic_error("[ERR]<recursive_parser>: not a statement rule on block_stack");
+		}
+
+		if (block_stack.size() > top + 1) { // it waits for a nested rule
+			got = nullptr;
+			continue;
+		}
+
+		const BlockFrame done = block_stack.pop_back();
+		if (done.pinned) {
+			expr->unpin();
+		}
+		if (top == base) {
+			return ret;
+		}
+		if (done.rule != BLOCK_FRAME_OPEN && memo && memo->counting) { // memo_call() of parse_X()
+			memo->record(done.rule, done.start, cur_index, ERROR, ERRPOS);
+		}
+
+		got = ret;
+	}
+}
+
+void RecursiveParser::enter_rule(const int rule) {
+	block_stack.push_back({rule, 0, cur_index, false, nullptr, nullptr});
+}
+
+ParseNode *RecursiveParser::step_IF(const size_t frame, ParseNode *got) {
+	BlockFrame &f = block_stack[frame];
+
+	if (f.stage == 1) { // the true block is back, f.node is the condition
+		if (ERROR) {
+			SET_ERR(0, 0);
+			ParseNode::DELETE(f.node, true);
+			SET_ERR(ERROR_SYNTAX, cur_index);
+			return nullptr;
+		}
+
+		ParseNode *dep = NEW_NODE(OPERATION, OPCODE_COND_DEPENDENT, nullptr, got);
+		f.node = NEW_NODE(OPERATION, OPCODE_IF, f.node, dep);
+		if (!cur->is_op(':')) {
+			return f.node;
+		}
+
+		NEXT();
+		f.stage = 2;
+		enter_rule(RULE_BLOCK_STATEMENT);
+		return nullptr;
+	}
+
+	if (f.stage == 2) { // the false block is back
+		if (ERROR) {
+			SET_ERR(0, 0);
+			ParseNode::DELETE(f.node, true);
+			SET_ERR(ERROR_SYNTAX, cur_index);
+			return nullptr;
+		}
+
+		f.node->R->L = got;
+		return f.node;
+	}
+
+	expr->pin((size_t) f.start);
+	f.pinned = true;
 
 	if (!cur->is_op(OPCODE_IF)) {
-		SET_ERR(ERROR_SYNTAX, cur);
+		SET_ERR(ERROR_SYNTAX, cur_index);
 		return nullptr;
 	}
 	NEXT();
 
 	if (!cur->is_op('(')) {
-		RESET();
-		SET_ERR(ERROR_SYNTAX, cur);
+		SETI(f.start);
+		SET_ERR(ERROR_SYNTAX, cur_index);
 		return nullptr;
 	}
 	NEXT();
 
 	IF_PARSED (cur_index, cond_block, parse_EXPR()) {
 		if (!cur->is_op(')')) {
-			SET_ERR(ERROR_SYNTAX, cur);
+			SET_ERR(ERROR_SYNTAX, cur_index);
 			return nullptr;
 		}
 		NEXT();
 
-		IF_PARSED (cur_index, true_block, parse_BLOCK_STATEMENT()) {
-			ParseNode *dep  = NEW_NODE(OPERATION, OPCODE_COND_DEPENDENT, nullptr,    true_block);
-			ParseNode *cond = NEW_NODE(OPERATION, OPCODE_IF,             cond_block, dep       );
-			if (!cur->is_op(':')) {
-				return cond;
-			}
+		f.node  = cond_block;
+		f.stage = 1;
+		enter_rule(RULE_BLOCK_STATEMENT);
+		return nullptr;
+	}
 
-			NEXT();
-			IF_PARSED (cur_index, false_block, parse_BLOCK_STATEMENT()) {
-				dep->L = false_block;
-				return cond;
-			}
+	SETI(f.start);
+	SET_ERR(ERROR_SYNTAX, cur_index);
+	return nullptr;
+}
 
-			ParseNode::DELETE(cond, true);
-			SET_ERR(ERROR_SYNTAX, cur);
+ParseNode *RecursiveParser::step_WHILE(const size_t frame, ParseNode *got) {
+	BlockFrame &f = block_stack[frame];
+
+	if (f.stage == 1) { // the body is back, f.node is the condition
+		if (ERROR) {
+			SET_ERR(0, 0);
+			ParseNode::DELETE(f.node, true);
+			SET_ERR(ERROR_SYNTAX, cur_index);
 			return nullptr;
 		}
 
-		ParseNode::DELETE(cond_block, true);
-		SET_ERR(ERROR_SYNTAX, cur);
-		return nullptr;
+		return NEW_NODE(OPERATION, OPCODE_WHILE, f.node, got);
 	}
 
-	RESET();
-	SET_ERR(ERROR_SYNTAX, cur);
-	return nullptr;
-}
-
-ParseNode *RecursiveParser::parse_WHILE() {
-	RESET_POINT = cur_index;
+	expr->pin((size_t) f.start);
+	f.pinned = true;
 
 	if (!cur->is_op(OPCODE_WHILE)) {
-		SET_ERR(ERROR_SYNTAX, cur);
+		SET_ERR(ERROR_SYNTAX, cur_index);
 		return nullptr;
 	}
 	NEXT();
 
 	if (!cur->is_op('(')) {
-		RESET();
-		SET_ERR(ERROR_SYNTAX, cur);
+		SETI(f.start);
+		SET_ERR(ERROR_SYNTAX, cur_index);
 		return nullptr;
 	}
 	NEXT();
@@ -478,38 +699,48 @@ ParseNode *RecursiveParser::parse_WHILE() {
 	IF_PARSED (cur_index, cond_block, parse_EXPR()) {
 		if (!cur->is_op(')')) {
 			ParseNode::DELETE(cond_block, true);
-			SET_ERR(ERROR_SYNTAX, cur);
+			SET_ERR(ERROR_SYNTAX, cur_index);
 			return nullptr;
 		}
 		NEXT();
 
-		IF_PARSED (cur_index, body_block, parse_BLOCK_STATEMENT()) {
-			ParseNode *whil  = NEW_NODE(OPERATION, OPCODE_WHILE, cond_block, body_block);
-			return whil;
-		}
-
-		ParseNode::DELETE(cond_block, true);
-		SET_ERR(ERROR_SYNTAX, cur);
+		f.node  = cond_block;
+		f.stage = 1;
+		enter_rule(RULE_BLOCK_STATEMENT);
 		return nullptr;
 	}
 
-	RESET();
-	SET_ERR(ERROR_SYNTAX, cur);
+	SETI(f.start);
+	SET_ERR(ERROR_SYNTAX, cur_index);
 	return nullptr;
 }
 
-ParseNode *RecursiveParser::parse_FOR() {
-	RESET_POINT = cur_index;
+ParseNode *RecursiveParser::step_FOR(const size_t frame, ParseNode *got) {
+	BlockFrame &f = block_stack[frame];
+
+	if (f.stage == 1) { // the body is back, f.node is the (init | cond | act) info
+		if (ERROR) {
+			SET_ERR(0, 0);
+			ParseNode::DELETE(f.node, true);
+			SET_ERR(ERROR_SYNTAX, cur_index);
+			return nullptr;
+		}
+
+		return NEW_NODE(OPERATION, OPCODE_FOR, f.node, got);
+	}
+
+	expr->pin((size_t) f.start);
+	f.pinned = true;
 
 	if (!cur->is_op(OPCODE_FOR)) {
-		SET_ERR(ERROR_SYNTAX, cur);
+		SET_ERR(ERROR_SYNTAX, cur_index);
 		return nullptr;
 	}
 	NEXT();
 
 	if (!cur->is_op('(')) {
-		RESET();
-		SET_ERR(ERROR_SYNTAX, cur);
+		SETI(f.start);
+		SET_ERR(ERROR_SYNTAX, cur_index);
 		return nullptr;
 	}
 	NEXT();
@@ -518,7 +749,7 @@ ParseNode *RecursiveParser::parse_FOR() {
 
 		if (!cur->is_op('|')) {
 			ParseNode::DELETE(init_block, true);
-			SET_ERR(ERROR_SYNTAX, cur);
+			SET_ERR(ERROR_SYNTAX, cur_index);
 			return nullptr;
 		}
 		NEXT();
@@ -528,7 +759,7 @@ ParseNode *RecursiveParser::parse_FOR() {
 
 			if (!cur->is_op('|')) {
 				ParseNode::DELETE(for_info, true);
-				SET_ERR(ERROR_SYNTAX, cur);
+				SET_ERR(ERROR_SYNTAX, cur_index);
 				return nullptr;
 			}
 			NEXT();
@@ -538,80 +769,55 @@ ParseNode *RecursiveParser::parse_FOR() {
 
 				if (!cur->is_op(')')) {
 					ParseNode::DELETE(for_upper_info, true);
-					SET_ERR(ERROR_SYNTAX, cur);
+					SET_ERR(ERROR_SYNTAX, cur_index);
 					return nullptr;
 				}
 				NEXT();
 
-				IF_PARSED (cur_index, body_block, parse_BLOCK_STATEMENT()) {
-					ParseNode *for_node = NEW_NODE(OPERATION, OPCODE_FOR, for_upper_info, body_block);
-					return for_node;
-				}
-
-				ParseNode::DELETE(for_upper_info, true);
-				SET_ERR(ERROR_SYNTAX, cur);
+				f.node  = for_upper_info;
+				f.stage = 1;
+				enter_rule(RULE_BLOCK_STATEMENT);
 				return nullptr;
 			}
 
 			ParseNode::DELETE(for_info, true);
-			SET_ERR(ERROR_SYNTAX, cur);
+			SET_ERR(ERROR_SYNTAX, cur_index);
 			return nullptr;
 		}
 
 		ParseNode::DELETE(init_block, true);
-		SET_ERR(ERROR_SYNTAX, cur);
+		SET_ERR(ERROR_SYNTAX, cur_index);
 		return nullptr;
 	}
 
-	RESET();
-	SET_ERR(ERROR_SYNTAX, cur);
+	SETI(f.start);
+	SET_ERR(ERROR_SYNTAX, cur_index);
 	return nullptr;
 }
 
-ParseNode *RecursiveParser::parse_DELIMITED_STMT() {
-	if (cur->is_op(OPCODE_BREAK)) {
-		NEXT();
-		return NEW_NODE(OPERATION, OPCODE_BREAK, nullptr, nullptr);
-	}
+// FUNC_DECL, IF, WHILE and FOR in turn, then a DELIMITED_STMT with its ';'
+ParseNode *RecursiveParser::step_STATEMENT(const size_t frame, ParseNode *got) {
+	static const int NESTED[] = {RULE_FUNC_DECL, RULE_IF, RULE_WHILE, RULE_FOR};
+	const int nested_cnt = (int) (sizeof(NESTED) / sizeof(NESTED[0]));
 
-	if (cur->is_op(OPCODE_CONTINUE)) {
-		NEXT();
-		return NEW_NODE(OPERATION, OPCODE_CONTINUE, nullptr, nullptr);
-	}
+	BlockFrame &f = block_stack[frame];
 
-	IF_PARSED (cur_index, var_def, parse_NEW_VAR_DEF()) {
-		return var_def;
-	}
-
-	IF_PARSED (cur_index, expr_node, parse_EXPR()) {
-		return expr_node;
-	}
-
-	SET_ERR(ERROR_SYNTAX, cur);
-	return nullptr;
-}
-
-ParseNode *RecursiveParser::parse_STATEMENT() {
-	IF_PARSED (cur_index, func_decl, parse_FUNC_DECL()) {
-		return NEW_NODE(OPERATION, ';', func_decl, nullptr);
-	}
-
-	IF_PARSED (cur_index, if_node, parse_IF()) {
-		return NEW_NODE(OPERATION, ';', if_node, nullptr);
-	}
-
-	IF_PARSED (cur_index, while_node, parse_WHILE()) {
-		return NEW_NODE(OPERATION, ';', while_node, nullptr);
+	if (f.stage > 0) { // NESTED[stage - 1] is back
+		if (!ERROR) {
+			return NEW_NODE(OPERATION, ';', got, nullptr);
+		}
+		SET_ERR(0, 0);
 	}
 
-	IF_PARSED (cur_index, for_node, parse_FOR()) {
-		return NEW_NODE(OPERATION, ';', for_node, nullptr);
+	if (f.stage < nested_cnt) {
+		enter_rule(NESTED[f.stage++]);
+		return nullptr;
 	}
 
 	IF_PARSED (cur_index, delim_stmt, parse_DELIMITED_STMT()) {
 		if (!cur->is_op(';')) {
 			ParseNode::DELETE(delim_stmt, true);
-			SET_ERR(ERROR_SYNTAX, cur);
+			SET_ERR(ERROR_SYNTAX, cur_index);
 			return nullptr;
 		} else {
 			NEXT();
@@ -624,50 +830,153 @@ ParseNode *RecursiveParser::parse_STATEMENT() {
 		}
 	}
 
-	SET_ERR(ERROR_SYNTAX, cur);
+	SET_ERR(ERROR_SYNTAX, cur_index);
+	return nullptr;
+}
+
+ParseNode *RecursiveParser::step_BLOCK_STATEMENT(const size_t frame, ParseNode *got) {
+	BlockFrame &f = block_stack[frame];
+
+	if (f.stage == 1) { // the statement is back
+		if (!ERROR) {
+			return got;
+		}
+
+		SET_ERR(ERROR_SYNTAX, cur_index);
+		return nullptr;
+	}
+
+	if (f.stage == 2) { // the block is back
+		if (ERROR) {
+			SET_ERR(ERROR_SYNTAX, cur_index);
+		}
+		return got;
+	}
+
+	if (!cur->is_op('{')) {
+		f.stage = 1;
+		enter_rule(RULE_STATEMENT);
+		return nullptr;
+	}
+
+	f.stage = 2;
+	NEXT();
+	block_stack.push_back({BLOCK_FRAME_OPEN, 0, cur_index, false, NEW_NODE(OPERATION, '{', nullptr, nullptr), nullptr});
 	return nullptr;
 }
 
-ParseNode *RecursiveParser::parse_BLOCK_STATEMENT() {
+// an open '{': statements and nested blocks are hung on it until its '}'
+ParseNode *RecursiveParser::step_open_block(const size_t frame, ParseNode *got) {
+	BlockFrame &f = block_stack[frame];
+
+	if (f.stage == 1) { // a statement or a nested block is back
+		if (ERROR) {
+			ParseNode::DELETE(f.node, true);
+			return nullptr;
+		}
+
+		if (f.last) {
+			f.last->R = got;
+		} else {
+			f.node->L = got;
+		}
+		f.last = got;
+
+		if (cur->is_op('}')) {
+			NEXT();
+			return f.node;
+		}
+	}
+
+	f.stage = 1;
 	if (cur->is_op('{')) {
 		NEXT();
-		ParseNode *block_node = NEW_NODE(OPERATION, '{', nullptr, nullptr);
-		IF_PARSED (cur_index, block_stmt, parse_BLOCK_STATEMENT()) {
-			block_node->L = block_stmt;
-			while (!cur->is_op('}')) {
-				IF_PARSED(cur_index, next_block, parse_BLOCK_STATEMENT()) {
-					block_stmt->R = next_block;
-					block_stmt = next_block;
-					continue;
-				}
+		block_stack.push_back({BLOCK_FRAME_OPEN, 0, cur_index, false, NEW_NODE(OPERATION, '{', nullptr, nullptr), nullptr});
+		return nullptr;
+	}
 
-				ParseNode::DELETE(block_node, true);
-				SET_ERR(ERROR_SYNTAX, cur);
-				return nullptr;
-			}
+	enter_rule(RULE_STATEMENT);
+	return nullptr;
+}
 
-			NEXT();
-			return block_node;
+ParseNode *RecursiveParser::step_FUNC_DECL(const size_t frame, ParseNode *got) {
+	BlockFrame &f = block_stack[frame];
+
+	if (f.stage == 1) { // the body is back, f.node is the func info
+		if (!ERROR) {
+			return NEW_NODE(OPERATION, OPCODE_FUNC_DECL, f.node, got);
 		}
 
-		ParseNode::DELETE(block_node, true);
-		SET_ERR(ERROR_SYNTAX, cur);
+		SET_ERR(0, 0);
+		SETI(f.start);
+		ParseNode::DELETE(f.node, true);
+		SET_ERR(ERROR_SYNTAX, cur_index);
 		return nullptr;
 	}
 
-	IF_PARSED (cur_index, statement, parse_STATEMENT()) {
-		return statement;
+	if (parsed_cnt) {
+		if (ParseNode *ready = take_parsed_func()) {
+			return ready;
+		}
 	}
 
-	SET_ERR(ERROR_SYNTAX, cur);
+	expr->pin((size_t) f.start);
+	f.pinned = true;
+
+	if (!cur->is_op(OPCODE_FUNC)) {
+		SET_ERR(ERROR_SYNTAX, cur_index);
+		return nullptr;
+	}
+	NEXT();
+
+	IF_PARSED (cur_index, func_name, parse_ID()) {
+		IF_PARSED (cur_index, arglist, parse_ARGLIST_DECL()) {
+			f.node  = NEW_NODE(OPERATION, OPCODE_FUNC_INFO, arglist, func_name);
+			f.stage = 1;
+			enter_rule(RULE_BLOCK_STATEMENT);
+			return nullptr;
+		}
+
+		SETI(f.start);
+		ParseNode::DELETE(func_name, true);
+		SET_ERR(ERROR_SYNTAX, cur_index);
+		return nullptr;
+	}
+
+	SETI(f.start);
+	SET_ERR(ERROR_SYNTAX, cur_index);
 	return nullptr;
 }
 
-ParseNode *RecursiveParser::parse_PROG() {
+ParseNode *RecursiveParser::rule_IF() {
+	return parse_statements(RULE_IF);
+}
+
+ParseNode *RecursiveParser::rule_WHILE() {
+	return parse_statements(RULE_WHILE);
+}
+
+ParseNode *RecursiveParser::rule_FOR() {
+	return parse_statements(RULE_FOR);
+}
+
+ParseNode *RecursiveParser::rule_STATEMENT() {
+	return parse_statements(RULE_STATEMENT);
+}
+
+ParseNode *RecursiveParser::rule_BLOCK_STATEMENT() {
+	return parse_statements(RULE_BLOCK_STATEMENT);
+}
+
+ParseNode *RecursiveParser::rule_FUNC_DECL() {
+	return parse_statements(RULE_FUNC_DECL);
+}
+
+ParseNode *RecursiveParser::rule_PROG() {
 	return parse_BLOCK_STATEMENT();
 }      
 
-ParseNode *RecursiveParser::parse_G() {
+ParseNode *RecursiveParser::rule_G() {
 	IF_PARSED (cur_index, prog, parse_PROG()) {
 		if (cur->type == T_END) {
 			return prog;
@@ -676,11 +985,11 @@ ParseNode *RecursiveParser::parse_G() {
 		}
 	}
 
-	SET_ERR(ERROR_SYNTAX, cur);
+	SET_ERR(ERROR_SYNTAX, cur_index);
 	return nullptr;
 }
 
-ParseNode *RecursiveParser::parse_ELEM_FUNC() {
+ParseNode *RecursiveParser::rule_ELEM_FUNC() {
 
 	// 0 args
 	if (cur->is_op(OPCODE_ELEM_INPUT) || cur->is_op(OPCODE_ELEM_EXIT) || cur->is_op(OPCODE_ELEM_G_DRAW_TICK)) {
@@ -725,11 +1034,11 @@ ParseNode *RecursiveParser::parse_ELEM_FUNC() {
 	// 	return ret;
 	// }
 
-	SET_ERR(ERROR_SYNTAX, cur);
+	SET_ERR(ERROR_SYNTAX, cur_index);
 	return nullptr;
 }
 
-ParseNode *RecursiveParser::parse_ARG_DECL() {
+ParseNode *RecursiveParser::rule_ARG_DECL() {
 	IF_PARSED (cur_index, var_def, parse_NEW_VAR_DEF()) {
 		return var_def;
 	}
@@ -738,11 +1047,11 @@ ParseNode *RecursiveParser::parse_ARG_DECL() {
 		return id;
 	}
 
-	SET_ERR(ERROR_SYNTAX, cur);
+	SET_ERR(ERROR_SYNTAX, cur_index);
 	return nullptr;
 }
 
-ParseNode *RecursiveParser::parse_ARGLIST_DECL() {
+ParseNode *RecursiveParser::rule_ARGLIST_DECL() {
 	ParseNode *arglist = NEW_NODE(OPERATION, OPCODE_FUNC_ARG_DECL, nullptr, nullptr);
 	ParseNode *cur_arg = arglist;
 
@@ -756,7 +1065,7 @@ ParseNode *RecursiveParser::parse_ARGLIST_DECL() {
 
 			if (!cur->is_op(']')) {
 				ParseNode::DELETE(arglist, true);
-				SET_ERR(ERROR_SYNTAX, cur);
+				SET_ERR(ERROR_SYNTAX, cur_index);
 				return nullptr;
 			} else {
 				NEXT();
@@ -766,49 +1075,14 @@ ParseNode *RecursiveParser::parse_ARGLIST_DECL() {
 
 		PREV();
 		ParseNode::DELETE(arglist, true);
-		SET_ERR(ERROR_SYNTAX, cur);
+		SET_ERR(ERROR_SYNTAX, cur_index);
 		return nullptr;
 	}
 
 	return arglist;
 }
 
-ParseNode *RecursiveParser::parse_FUNC_DECL() {
-	RESET_POINT = cur_index;
-
-	if (!cur->is_op(OPCODE_FUNC)) {
-		SET_ERR(ERROR_SYNTAX, cur);
-		return nullptr;
-	}
-	NEXT();
-
-	IF_PARSED (cur_index, func_name, parse_ID()) {
-		IF_PARSED (cur_index, arglist, parse_ARGLIST_DECL()) {
-			ParseNode *func_info = NEW_NODE(OPERATION, OPCODE_FUNC_INFO, arglist, func_name);
-
-			IF_PARSED (cur_index, func_body, parse_BLOCK_STATEMENT()) {
-				ParseNode *func_decl = NEW_NODE(OPERATION, OPCODE_FUNC_DECL, func_info, func_body);
-				return func_decl;
-			}
-
-			RESET();
-			ParseNode::DELETE(func_info, true);
-			SET_ERR(ERROR_SYNTAX, cur);
-			return nullptr;
-		}
-
-		RESET();
-		ParseNode::DELETE(func_name, true);
-		SET_ERR(ERROR_SYNTAX, cur);
-		return nullptr;
-	}
-
-	RESET();
-	SET_ERR(ERROR_SYNTAX, cur);
-	return nullptr;
-}
-
-ParseNode *RecursiveParser::parse_ARG_CALL() {
+ParseNode *RecursiveParser::rule_ARG_CALL() {
 	if (cur->is_op('.')) {
 		NEXT();
 		return NEW_NODE(OPERATION, OPCODE_CONTEXT_ARG, nullptr, nullptr);
@@ -822,11 +1096,11 @@ ParseNode *RecursiveParser::parse_ARG_CALL() {
 		return NEW_NODE(OPERATION, OPCODE_EXPR, expr_node, nullptr);
 	}
 
-	SET_ERR(ERROR_SYNTAX, cur);
+	SET_ERR(ERROR_SYNTAX, cur_index);
 	return nullptr;
 }
 
-ParseNode *RecursiveParser::parse_ARGLIST_CALL() {
+ParseNode *RecursiveParser::rule_ARGLIST_CALL() {
 	ParseNode *arglist = NEW_NODE(OPERATION, OPCODE_FUNC_ARG_CALL, nullptr, nullptr);
 	ParseNode *cur_arg = arglist;
 
@@ -840,7 +1114,7 @@ ParseNode *RecursiveParser::parse_ARGLIST_CALL() {
 
 			if (!cur->is_op(']')) {
 				ParseNode::DELETE(arglist, true);
-				SET_ERR(ERROR_SYNTAX, cur);
+				SET_ERR(ERROR_SYNTAX, cur_index);
 				return nullptr;
 			} else {
 				NEXT();
@@ -850,17 +1124,17 @@ ParseNode *RecursiveParser::parse_ARGLIST_CALL() {
 
 		PREV();
 		ParseNode::DELETE(arglist, true);
-		SET_ERR(ERROR_SYNTAX, cur);
+		SET_ERR(ERROR_SYNTAX, cur_index);
 		return nullptr;
 	}
 
 	return arglist;
 }
 
-ParseNode *RecursiveParser::parse_FUNC_CALL() {
+ParseNode *RecursiveParser::rule_FUNC_CALL() {
 	cur->dump();
 	printf("| ");
-	printf("%d %d\n", cur->line, cur->pos);
+	printf("%d %d\n", expr->line(cur_index), expr->pos(cur_index));
 	IF_PARSED (cur_index, id, parse_ID()) {
 		ParseNode *func_call = NEW_NODE(OPERATION, OPCODE_FUNC_CALL, nullptr, id);
 
@@ -871,20 +1145,28 @@ ParseNode *RecursiveParser::parse_FUNC_CALL() {
 
 		PREV();
 		ParseNode::DELETE(func_call, true);
-		SET_ERR(ERROR_SYNTAX, cur);
+		SET_ERR(ERROR_SYNTAX, cur_index);
 		return nullptr;
 	}
 
-	SET_ERR(ERROR_SYNTAX, cur);
+	SET_ERR(ERROR_SYNTAX, cur_index);
 	return nullptr;
 }
 
 RecursiveParser::RecursiveParser():
 expr(nullptr),
 cur_index(0),
+cur_token(),
 cur(nullptr),
+line_hint(0),
 ERROR(0),
-ERRPOS(nullptr)
+ERRPOS(0),
+memo(nullptr),
+threads(1),
+parsed_funcs(nullptr),
+parsed_cnt(0),
+operator_stack(),
+block_stack()
 {}
 
 RecursiveParser::~RecursiveParser() {}
@@ -892,9 +1174,18 @@ RecursiveParser::~RecursiveParser() {}
 void RecursiveParser::ctor() {
 	expr = nullptr;
 	cur_index = 0;
-	cur = nullptr;
+	cur = &cur_token;
+	line_hint = 0;
 	ERROR = 0;
-	ERRPOS = nullptr;
+	ERRPOS = 0;
+	memo = nullptr;
+
+	threads      = 1;
+	parsed_funcs = nullptr;
+	parsed_cnt   = 0;
+
+	operator_stack.ctor();
+	block_stack.ctor();
 }
 
 RecursiveParser *RecursiveParser::NEW() {
@@ -914,6 +1205,14 @@ void RecursiveParser::dtor() {
 
 	ERROR  = 0;
 	ERRPOS = 0;
+
+	ParseMemo::DELETE(memo);
+	memo = nullptr;
+
+	drop_parsed_funcs();
+
+	operator_stack.dtor();
+	block_stack.dtor();
 }
 
 void RecursiveParser::DELETE(RecursiveParser *classname) {
@@ -927,17 +1226,231 @@ void RecursiveParser::DELETE(RecursiveParser *classname) {
 
 //=============================================================================
 
-ParseNode *RecursiveParser::parse(Vector<Token> *expression) {
+void RecursiveParser::set_memo(const bool caching, const bool counting) {
+	ParseMemo::DELETE(memo);
+	memo = nullptr;
+
+	if (caching || counting) {
+		memo = ParseMemo::NEW(caching, counting);
+	}
+}
+
+void RecursiveParser::set_threads(const int threads_) {
+	threads = threads_ > 1 ? threads_ : 1;
+}
+
+//=============================================================================
+// Parallel top-level funcs ===================================================
+
+void RecursiveParser::find_top_funcs() {
+	const int token_cnt = (int) expr->size();
+	if (!token_cnt || expr->type(0) != T_OP || expr->data(0).op != '{') {
+		return;
+	}
+
+	int cap = 0;
+	int depth = 0;
+	for (int i = 0; i < token_cnt; ++i) {
+		if (expr->type(i) != T_OP) {
+			continue;
+		}
+
+		const int op = expr->data(i).op;
+		if (op == '{') {
+			++depth;
+		} else if (op == '}') {
+			--depth;
+		}
+
+		if (depth != 1 || op != OPCODE_FUNC) {
+			continue;
+		}
+
+		int body = i + 1; // a header has no braces, the body is the first block after it
+		while (body < token_cnt && !(expr->type(body) == T_OP && (expr->data(body).op == '{' || expr->data(body).op == '}' || expr->data(body).op == ';' || expr->data(body).op == OPCODE_FUNC))) {
+			++body;
+		}
+		if (body == token_cnt || expr->data(body).op != '{') {
+			continue; // no block body, the serial pass parses it
+		}
+
+		int end = body;
+		for (int body_depth = 0; end < token_cnt; ++end) {
+			if (expr->type(end) == T_OP && expr->data(end).op == '{') {
+				++body_depth;
+			} else if (expr->type(end) == T_OP && expr->data(end).op == '}' && !--body_depth) {
+				break;
+			}
+		}
+		if (end == token_cnt) {
+			return;
+		}
+
+		if (parsed_cnt == cap) {
+			cap = cap ? cap * 2 : 64;
+			ParsedFunc *new_funcs = (ParsedFunc*) realloc(parsed_funcs, (size_t) cap * sizeof(ParsedFunc));
+			if (!new_funcs) {
+				throw std::length_error("[ERR]<recursive_parser>: parsed funcs realloc fail");
+			}
+			parsed_funcs = new_funcs;
+		}
+
+		parsed_funcs[parsed_cnt++] = {i, end + 1, nullptr};
+		i = end;
+	}
+}
+
+void RecursiveParser::parse_funcs(TokenStream *stream, ParsedFunc *funcs, const int from, const int to, Pool<CodeNode> *pool) {
+	Pool<CodeNode> *thread_pool = THREAD_NODE_POOL;
+	THREAD_NODE_POOL = pool;
+
+	expr      = stream;
+	cur       = &cur_token;
+	line_hint = 0;
+	for (int i = from; i < to; ++i) {
+		SET_ERR(0, 0);
+		SETI(funcs[i].first);
+
+		ParseNode *func = parse_FUNC_DECL();
+		if (ERROR) {
+			ParseNode::DELETE(func, true);
+			func = nullptr;
+		}
+
+		funcs[i].end  = cur_index;
+		funcs[i].node = func;
+	}
+
+	SET_ERR(0, 0);
+	THREAD_NODE_POOL = thread_pool;
+}
+
+void RecursiveParser::parse_funcs_ahead() {
+	find_top_funcs();
+	if (parsed_cnt < 2) {
+		drop_parsed_funcs();
+		return;
+	}
+
+	const int worker_cnt = threads < parsed_cnt ? threads : parsed_cnt;
+
+	int              *bounds  = (int*) calloc((size_t) worker_cnt + 1, sizeof(int));
+	RecursiveParser **workers = (RecursiveParser**) calloc((size_t) worker_cnt, sizeof(RecursiveParser*));
+	Pool<CodeNode>   *pools   = (Pool<CodeNode>*) calloc((size_t) worker_cnt, sizeof(Pool<CodeNode>));
+	std::thread      *runs    = new std::thread[worker_cnt];
+	if (!bounds || !workers || !pools) {
+		free(bounds);
+		free(workers);
+		free(pools);
+		delete[] runs;
+		throw std::length_error("[ERR]<recursive_parser>: workers alloc fail");
+	}
+
+	long long total = 0;
+	for (int i = 0; i < parsed_cnt; ++i) {
+		total += parsed_funcs[i].end - parsed_funcs[i].first;
+	}
+
+	long long done = 0;
+	for (int i = 0, w = 1; i < parsed_cnt && w < worker_cnt; ++i) { // about the same number of tokens to each
+		done += parsed_funcs[i].end - parsed_funcs[i].first;
+		if (done * worker_cnt >= total * w) {
+			bounds[w++] = i + 1;
+		}
+	}
+	bounds[worker_cnt] = parsed_cnt;
+	for (int w = 1; w <= worker_cnt; ++w) {
+		if (bounds[w] < bounds[w - 1]) {
+			bounds[w] = bounds[w - 1];
+		}
+	}
+
+	for (int w = 0; w < worker_cnt; ++w) {
+		workers[w] = RecursiveParser::NEW();
+		workers[w]->set_memo(memo && memo->caching, false);
+		pools[w].ctor();
+	}
+
+	for (int w = 1; w < worker_cnt; ++w) {
+		runs[w] = std::thread(&RecursiveParser::parse_funcs, workers[w], expr, parsed_funcs, bounds[w], bounds[w + 1], &pools[w]);
+	}
+	workers[0]->parse_funcs(expr, parsed_funcs, bounds[0], bounds[1], &pools[0]);
+
+	for (int w = 0; w < worker_cnt; ++w) {
+		if (w) {
+			runs[w].join();
+		}
+
+		THREAD_NODE_POOL->adopt(&pools[w]);
+		RecursiveParser::DELETE(workers[w]);
+	}
+
+	free(bounds);
+	free(workers);
+	free(pools);
+	delete[] runs;
+}
+
+ParseNode *RecursiveParser::take_parsed_func() {
+	int l = 0;
+	int r = parsed_cnt;
+	while (r - l > 1) { // last func with first <= cur_index
+		int m = (l + r) / 2;
+		if (parsed_funcs[m].first <= cur_index) {
+			l = m;
+		} else {
+			r = m;
+		}
+	}
+
+	ParsedFunc &func = parsed_funcs[l];
+	if (func.first != cur_index || !func.node) {
+		return nullptr;
+	}
+
+	ParseNode *ret = func.node;
+	func.node = nullptr;
+	SETI(func.end);
+	return ret;
+}
+
+void RecursiveParser::drop_parsed_funcs() {
+	for (int i = 0; i < parsed_cnt; ++i) {
+		ParseNode::DELETE(parsed_funcs[i].node, true);
+	}
+
+	free(parsed_funcs);
+	parsed_funcs = nullptr;
+	parsed_cnt   = 0;
+}
+
+//=============================================================================
+
+ParseNode *RecursiveParser::parse(TokenStream *expression) {
 	expr      = expression;
 	cur_index = 0;
-	cur       = &(*expr)[cur_index];
+	cur       = &cur_token;
+	line_hint = 0;
+	expr->fetch(cur_index, cur);
+	if (memo) {
+		memo->clear();
+	}
+
+	if (threads > 1 && expr->whole()) {
+		parse_funcs_ahead();
+	}
 
 	ParseNode *res = parse_G();
+	drop_parsed_funcs();
+	if (memo && memo->counting) {
+		memo->dump_stats(stderr, PARSE_RULE_NAMES, RULE_CNT);
+	}
+
 	if (!ERROR) {
 		return res;
 	} else {
 		ANNOUNCE("ERR", "parser", "an error occured during grammar parsing");
-		ANNOUNCE("ERR", "parser", "line [%d] | pos [%d]", ERRPOS->line, ERRPOS->pos);
+		ANNOUNCE("ERR", "parser", "line [%d] | pos [%d]", expr->line(ERRPOS), expr->pos(ERRPOS));
 		//ERRPOS->dump();
 		return nullptr;
 	}
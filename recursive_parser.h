@@ -11,64 +11,120 @@
 
 #include "code_node.h"
 #include "lex_token.h"
+#include "token_stream.h"
+#include "parse_memo.h"
 
 typedef CodeNode ParseNode;
 
+#define PARSE_RULE(name, memoized) RULE_##name,
+
+enum PARSE_RULE_ID {
+	#include "parse_rules.h"
+
+	RULE_CNT
+};
+
+#undef PARSE_RULE
+
 enum PARSER_ERROR {
 	OK = 0,
 
 	ERROR_SYNTAX = 100,
 };
 
+// a top-level func parsed ahead on a worker, handed to the serial pass when it gets there
+struct ParsedFunc {
+	int        first; // token index of 'func'
+	int        end;   // where parse_FUNC_DECL stopped
+	ParseNode *node;  // nullptr if it failed or is taken, the serial pass parses it itself then
+};
+
+enum OPERATOR_FRAME_KIND {
+	OPERATOR_PREFIX  = 0,
+	OPERATOR_INFIX   = 1,
+	OPERATOR_BRACKET = 2,
+};
+
+// an operator of parse_operators() waiting for its operand
+struct OperatorFrame {
+	int        kind;
+	int        op;
+	int        power; // min power to go on with once the operand is there
+	ParseNode *left;  // of an infix op
+};
+
+const int BLOCK_FRAME_OPEN = -1; // an open '{' of rule_BLOCK_STATEMENT(), not a rule
+
+// a statement rule of parse_statements() waiting for a nested one, or an open '{'
+struct BlockFrame {
+	int        rule;   // RULE_X or BLOCK_FRAME_OPEN
+	int        stage;  // 0 on entry, then what the rule is waiting for
+	int        start;  // token index the rule was entered at, its reset point
+	bool       pinned; // start is pinned in the stream
+	ParseNode *node;   // what the rule has built so far, the block of an open '{'
+	ParseNode *last;   // statement of an open '{' to hang the next one on
+};
+
 //=============================================================================
 // RecursiveParser ============================================================
 
 class RecursiveParser {
 private:
 // data =======================================================================
-	Vector<Token> *expr;
+	TokenStream   *expr;
 	int            cur_index;
+	Token          cur_token; // type and data of expr[cur_index]
 	Token         *cur;
+	size_t         line_hint; // for expr->line()
 
 	int            ERROR;
-	const Token   *ERRPOS;
+	int            ERRPOS;    // token index
+
+	ParseMemo     *memo;      // nullptr parses without the table
+
+	int            threads;
+	ParsedFunc    *parsed_funcs; // sorted by first
+	int            parsed_cnt;
+
+	Vector<OperatorFrame> operator_stack;
+	Vector<BlockFrame>    block_stack;
 //=============================================================================
 	bool is_id_char	(const char c);
 	bool is_digit	(const char c);
-	bool is_sign	(const char c);
-	bool is_sign	(const Token *t);
-
-	bool is_multiplicative(const char c);
-	bool is_multiplicative(const Token *t);
-
-	ParseNode *parse_ID();
-	ParseNode *parse_NUMB();
-	ParseNode *parse_UNIT();
-	ParseNode *parse_FACT();
-	ParseNode *parse_TERM();
-	ParseNode *parse_DEF_VAR();
-	ParseNode *parse_DEF_ARR();
-	ParseNode *parse_NEW_VAR_DEF();
-	ParseNode *parse_MATH_EXPR();
-	ParseNode *parse_COND();
-	ParseNode *parse_AND_EXPR();
-	ParseNode *parse_LOGIC_EXPR();
-	ParseNode *parse_EXPR();
-	ParseNode *parse_IF();
-	ParseNode *parse_WHILE();
-	ParseNode *parse_FOR();
-	ParseNode *parse_DELIMITED_STMT();
-	ParseNode *parse_STATEMENT();
-	ParseNode *parse_BLOCK_STATEMENT();
-	ParseNode *parse_PROG();
-	ParseNode *parse_G();
-	ParseNode *parse_ELEM_FUNC();
-	ParseNode *parse_ARG_DECL();
-	ParseNode *parse_ARGLIST_DECL();
-	ParseNode *parse_FUNC_DECL();
-	ParseNode *parse_ARG_CALL();
-	ParseNode *parse_ARGLIST_CALL();
-	ParseNode *parse_FUNC_CALL();
+	bool is_asgn_op (const Token *token);
+	bool is_plain_bracket();
+
+	// parse_X() goes through the memo when there is one, rule_X() is the rule itself
+	#define PARSE_RULE(name, memoized) ParseNode *parse_##name(); ParseNode *rule_##name();
+	#include "parse_rules.h"
+	#undef PARSE_RULE
+
+	// precedence climbing over op_powers.h: an operand, then infix operators of at least min_power
+	ParseNode *parse_operators(const int min_power);
+
+	ParseNode *memo_call(const int rule, const bool memoized, ParseNode *(RecursiveParser::*rule_func)());
+
+	// Statements nest as deep as the source does, so BLOCK_STATEMENT, STATEMENT, IF,
+	// WHILE, FOR and FUNC_DECL run as frames on block_stack. A step gets what the
+	// nested rule it waited for returned, and either enters another one or is done.
+	ParseNode *parse_statements(const int rule);
+	void       enter_rule(const int rule);
+	ParseNode *step_BLOCK_STATEMENT(const size_t frame, ParseNode *got);
+	ParseNode *step_open_block     (const size_t frame, ParseNode *got);
+	ParseNode *step_STATEMENT      (const size_t frame, ParseNode *got);
+	ParseNode *step_IF             (const size_t frame, ParseNode *got);
+	ParseNode *step_WHILE          (const size_t frame, ParseNode *got);
+	ParseNode *step_FOR            (const size_t frame, ParseNode *got);
+	ParseNode *step_FUNC_DECL      (const size_t frame, ParseNode *got);
+
+	// Top-level funcs of the outer block are found by brace matching and parsed on
+	// up to threads workers before the serial pass, which takes them by token index.
+	// A rule's tree depends only on where it starts, so the tree is the same either way.
+	void find_top_funcs();
+	void parse_funcs_ahead();
+	void parse_funcs(TokenStream *stream, ParsedFunc *funcs, const int from, const int to, Pool<CodeNode> *pool);
+	ParseNode *take_parsed_func();
+	void drop_parsed_funcs();
 
 public:
 	RecursiveParser            (const RecursiveParser&) = delete;
@@ -80,7 +136,13 @@ public:
 	static RecursiveParser *NEW();
 	void dtor();
 	static void DELETE(RecursiveParser *classname);
-	ParseNode *parse(Vector<Token> *expression);
+	ParseNode *parse(TokenStream *expression);
+
+	// caching replays failed memoized rules, counting prints per-rule reparse stats after parse()
+	void set_memo(const bool caching, const bool counting);
+
+	// threads > 1 parses top-level funcs ahead in parallel, the stream must be lexed whole
+	void set_threads(const int threads_);
 
 };
 
@@ -0,0 +1,595 @@
+#include "resolver.h"
+
+#define LOG_ERROR_LINE_POS(node) RAISE_ERROR("line [%d] | pos [%d]\n", node->line(), node->pos());
+#define NAME_ERROR(...) do { ++error_cnt; RAISE_ERROR(__VA_ARGS__); } while (0)
+
+#define RESOLVE_L() if (node->L()) resolve(node->L())
+#define RESOLVE_R() if (node->R()) resolve(node->R())
+#define RESOLVE_LR() do {RESOLVE_L(); RESOLVE_R();} while (0)
+
+Resolver::Resolver():
+ast(nullptr),
+id_table(),
+resolve_stack(),
+error_cnt(0),
+propagate(false)
+{}
+
+Resolver::~Resolver() {}
+
+void Resolver::ctor() {
+	ast = nullptr;
+	id_table.ctor();
+	resolve_stack.ctor();
+	error_cnt = 0;
+	propagate = false;
+}
+
+Resolver *Resolver::NEW() {
+	Resolver *cake = (Resolver*) calloc(1, sizeof(Resolver));
+	if (!cake) {
+		return nullptr;
+	}
+
+	cake->ctor();
+	return cake;
+}
+
+void Resolver::dtor() {
+	ast = nullptr;
+	id_table.dtor();
+	resolve_stack.dtor();
+	error_cnt = 0;
+}
+
+void Resolver::DELETE(Resolver *resolver) {
+	if (!resolver) {
+		return;
+	}
+
+	resolver->dtor();
+	free(resolver);
+}
+
+//=============================================================================
+
+AstBinding Resolver::find_var(AstNode name) const {
+	int offset = 0;
+	AstNode value = nullptr;
+	int found = id_table.find_var(name->get_sym(), &offset, &value);
+
+	if (found == NOT_FOUND) {
+		return {BOUND_UNDEFINED, 0, NO_CALL};
+	}
+
+	if (value) {
+		return {BOUND_CONST, value.get_index(), NO_CALL};
+	}
+
+	return {found == ID_TYPE_GLOBAL ? BOUND_GLOBAL : BOUND_LOCAL, offset, NO_CALL};
+}
+
+void Resolver::bind_var(AstNode name, AstNode where) {
+	AstBinding binding = find_var(name);
+	ast->bind(name, binding.kind, binding.value);
+
+	if (binding.kind == BOUND_UNDEFINED) {
+		NAME_ERROR("variable does not exist [");
+		name->get_id()->print();
+		printf("]\n");
+		LOG_ERROR_LINE_POS(where);
+	}
+}
+
+void Resolver::resolve_operation(AstNode node) {
+	switch (node->get_op()) {
+		case '=' : {
+			RESOLVE_R();
+			resolve_lvalue(node->L());
+			break;
+		}
+
+		case OPCODE_ASGN_ADD :
+		case OPCODE_ASGN_SUB :
+		case OPCODE_ASGN_MUL :
+		case OPCODE_ASGN_DIV :
+		case OPCODE_ASGN_POW : {
+			resolve_lvalue(node->L());
+			RESOLVE_R();
+			break;
+		}
+
+		case OPCODE_EXPR : {
+			resolve_expr(node);
+			break;
+		}
+
+		case OPCODE_VAR_DEF : {
+			if (!node->L() || !node->L()->is_id()) {
+				break;
+			}
+
+			RESOLVE_R();
+
+			// a constant with a value, as the simplifier leaves 2 * 3.14, takes no slot
+			const bool constant = propagate && node->R() && node->R()->is_val() && node->L()->get_id()->starts_with("_");
+			const bool declared = constant ? id_table.declare_const(node->L()->get_sym(), node->R())
+			                               : id_table.declare_var  (node->L()->get_sym(), 1);
+			if (!declared) {
+				NAME_ERROR("Redefinition of the id [");
+				node->L()->get_id()->print();
+				printf("]\n");
+				LOG_ERROR_LINE_POS(node);
+				break;
+			}
+
+			if (node->R()) {
+				bind_var(node->L(), node->L());
+			}
+
+			break;
+		}
+
+		case OPCODE_ARR_DEF : {
+			AstNode arr_name = node->L()->R();
+			if (!node->L() || !node->L()->is_op(OPCODE_ARR_INFO)) {
+				break;
+			}
+
+			if (!id_table.declare_var(arr_name->get_sym(), 1)) {
+				NAME_ERROR("Redefinition of the id [");
+				arr_name->get_id()->print();
+				printf("]\n");
+				LOG_ERROR_LINE_POS(node);
+				break;
+			}
+			id_table.add_buffer_zone((int) node->L()->L()->get_val());
+
+			bind_var(arr_name, node);
+			break;
+		}
+
+		case OPCODE_ELEM_RANDOM : {
+			RESOLVE_LR();
+			break;
+		}
+
+		case OPCODE_ELEM_G_INIT :
+		case OPCODE_ELEM_G_PUT_PIXEL : {
+			if (!node->R() || !node->L()) {
+				break;
+			}
+
+			RESOLVE_LR();
+			break;
+		}
+
+		case OPCODE_ELEM_PUTN :
+		case OPCODE_ELEM_PUTC :
+		case OPCODE_ELEM_MALLOC :
+		case OPCODE_ELEM_G_FILL :
+		case OPCODE_RET : {
+			RESOLVE_R();
+			break;
+		}
+
+		case OPCODE_FUNC_INFO : {
+			RESOLVE_L();
+			ast->bind(node->R(), BOUND_FUNC, id_table.find_func(node->R()->get_sym()));
+			break;
+		}
+
+		case OPCODE_FUNC_ARG_DECL : {
+			if (!node->L()) {
+				break;
+			}
+
+			if (node->L()->is_op(OPCODE_VAR_DEF)) {
+				if (!node->L()->L()) {
+					break;
+				}
+
+				id_table.declare_var(node->L()->L()->get_sym(), 1);
+			} else if (node->L()->is_id()) {
+				id_table.declare_var(node->L()->get_sym(), 1);
+			}
+
+			RESOLVE_R();
+			break;
+		}
+
+		case OPCODE_FUNC_CALL : {
+			const int label = id_table.find_func(node->R()->get_sym());
+			if (label == NOT_FOUND) {
+				resolve_arr_call(node);
+			} else {
+				ast->bind(node->R(), BOUND_FUNC, label);
+				resolve_func_call(node);
+			}
+			break;
+		}
+
+		default : {
+			break;
+		}
+	}
+}
+
+void Resolver::resolve_expr(AstNode node) {
+	if (node->is_op(OPCODE_EXPR)) {
+		RESOLVE_L();
+	} else {
+		resolve(node);
+	}
+}
+
+void Resolver::resolve_func_call(AstNode node) {
+	if ((!node->R() && !node->is_id()) || (node->R() && !node->R()->is_id())) {
+		return; // codegen reports the broken node
+	}
+
+	AstNode name = node->R() ? node->R() : node;
+	const int sym = name->get_sym();
+
+	const int label = id_table.find_func(sym);
+	if (label == NOT_FOUND) {
+		NAME_ERROR("bad func call, func not declared [");
+		name->get_id()->print();
+		printf("]\n");
+		LOG_ERROR_LINE_POS(node);
+		return;
+	}
+
+	AstNode func_arglist = id_table.get_arglist(sym);
+	if (!func_arglist) {
+		NAME_ERROR("bad func call, declared func arglist is absent\n");
+		LOG_ERROR_LINE_POS(node);
+		return;
+	}
+
+	const int call = ast->add_call(node, label);
+	id_table.add_scope(ARG_SCOPE);
+
+	AstNode arglist = node->L();
+	while (arglist && func_arglist && arglist->L() && func_arglist->L()) {
+		AstNode arg  = arglist->L();
+		AstNode prot = func_arglist->L();
+
+		if (arg->is_op(OPCODE_DEFAULT_ARG)) {
+			resolve_default_arg(call, arg, prot);
+		} else if (arg->is_op(OPCODE_CONTEXT_ARG)) {
+			resolve_context_arg(call, arg, prot);
+		} else if (arg->is_op(OPCODE_EXPR)) {
+			resolve_expr_arg(call, arg, prot);
+		}
+
+		arglist = arglist->R();
+		func_arglist = func_arglist->R();
+	}
+
+	while (func_arglist && func_arglist->L()) {
+		resolve_default_arg(call, node, func_arglist->L());
+		func_arglist = func_arglist->R();
+	}
+
+	id_table.remove_scope();
+	ast->set_frame(call, id_table.get_func_offset());
+}
+
+// the caller's var of the same name, looked up from the caller's scope
+bool Resolver::resolve_push_arg(AstNode arg, AstNode name, AstParam *param) {
+	id_table.shift_backward();
+	param->source_name = find_var(name);
+	id_table.shift_forward();
+
+	if (param->source_name.kind == BOUND_UNDEFINED) {
+		NAME_ERROR("variable does not exist [");
+		name->get_id()->print();
+		printf("]\n");
+		LOG_ERROR_LINE_POS(name);
+
+		RAISE_ERROR("func call arg position:\n");
+		LOG_ERROR_LINE_POS(arg);
+		return false;
+	}
+
+	return true;
+}
+
+// declares the arg in the call's scope and binds the slot param is popped to
+void Resolver::add_param(const int call, AstParam *param, AstNode name) {
+	id_table.declare_var(name->get_sym(), 1);
+
+	param->target = find_var(name);
+	if (param->target.kind == BOUND_UNDEFINED) {
+		NAME_ERROR("variable does not exist [");
+		name->get_id()->print();
+		printf("]\n");
+		LOG_ERROR_LINE_POS(name);
+		return;
+	}
+
+	ast->add_param(call, *param);
+}
+
+void Resolver::resolve_default_arg(const int call, AstNode arg, AstNode prot) {
+	AstParam param = {};
+
+	if (prot->is_id()) {
+		if (!resolve_push_arg(arg, prot, &param)) {
+			return;
+		}
+
+		add_param(call, &param, prot);
+	} else if (prot->is_op(OPCODE_VAR_DEF)) {
+		if (!prot->R()) {
+			NAME_ERROR("bad func call, required arg [");
+			prot->L()->get_id()->print();
+			printf("] has no default set\n");
+			LOG_ERROR_LINE_POS(arg);
+			return;
+		}
+
+		id_table.shift_backward();
+		param.source = ast->clone(prot->R());
+		resolve(param.source);
+		id_table.shift_forward();
+
+		add_param(call, &param, prot->L());
+	} else {
+		NAME_ERROR("bad func call, unexpected PROT type [");
+		printf("%d]\n", prot->get_op());
+		LOG_ERROR_LINE_POS(prot);
+	}
+}
+
+void Resolver::resolve_context_arg(const int call, AstNode arg, AstNode prot) {
+	if (!prot->is_id() && !prot->is_op(OPCODE_VAR_DEF)) {
+		NAME_ERROR("bad func call, unexpected PROT type [");
+		printf("%d]\n", prot->get_op());
+		LOG_ERROR_LINE_POS(arg);
+		return;
+	}
+
+	AstNode name = prot->is_id() ? prot : prot->L();
+
+	AstParam param = {};
+	if (!resolve_push_arg(arg, name, &param)) {
+		return;
+	}
+
+	add_param(call, &param, name);
+}
+
+void Resolver::resolve_expr_arg(const int call, AstNode arg, AstNode prot) {
+	if (!arg->L()) {
+		NAME_ERROR("bad func call, expr node has no expression inside\n");
+		LOG_ERROR_LINE_POS(arg);
+		return;
+	}
+
+	AstParam param = {};
+	param.source = arg->L();
+
+	id_table.shift_backward();
+	resolve(param.source);
+	id_table.shift_forward();
+
+	if (prot->is_id()) {
+		add_param(call, &param, prot);
+	} else if (prot->is_op(OPCODE_VAR_DEF)) {
+		add_param(call, &param, prot->L());
+	} else {
+		NAME_ERROR("bad func call, unexpected PROT type [");
+		printf("%d]\n", prot->get_op());
+		LOG_ERROR_LINE_POS(arg);
+	}
+}
+
+void Resolver::resolve_arr_call(AstNode node) {
+	if (!node->R()) {
+		return; // codegen reports the nameless call
+	}
+
+	bind_var(node->R(), node);
+	if (node->R()->get_binding().kind == BOUND_UNDEFINED) {
+		return;
+	}
+
+	for (AstNode args = node->L(); args && args->L(); args = args->R()) {
+		resolve_expr(args->L());
+	}
+}
+
+void Resolver::resolve_lvalue(AstNode node) {
+	assert(node);
+
+	if (node->is_id()) {
+		bind_var(node, node);
+	} else if (node->is_op(OPCODE_FUNC_CALL)) {
+		const int label = id_table.find_func(node->R()->get_sym());
+		if (label != NOT_FOUND) { // codegen reports an assignment to a func
+			ast->bind(node->R(), BOUND_FUNC, label);
+			return;
+		}
+
+		resolve_arr_call(node);
+	}
+}
+
+void Resolver::resolve_node(AstNode node) {
+	switch (node->get_type()) {
+		case OPERATION : {
+			resolve_operation(node);
+			break;
+		}
+
+		case ID : {
+			const int label = id_table.find_func(node->get_sym());
+			if (label != NOT_FOUND) {
+				ast->bind(node, BOUND_FUNC, label);
+				resolve_func_call(node);
+			} else if (node->R()) {
+				resolve_arr_call(node);
+			} else {
+				bind_var(node, node);
+			}
+			break;
+		}
+
+		default: {
+			break;
+		}
+	}
+}
+
+// the statements whose bodies nest: what comes before the body, then the body
+// and the rest of the statement on resolve_stack. False for any other node.
+bool Resolver::resolve_body(const ResolveFrame &frame) {
+	AstNode node = frame.node;
+
+	switch (node->get_op()) {
+		case OPCODE_WHILE :
+		case OPCODE_IF :
+		case OPCODE_COND_DEPENDENT : {
+			if (node->R()) {
+				resolve_stack.push_back({node->R(), 0});
+			}
+			if (node->L()) {
+				resolve_stack.push_back({node->L(), 0});
+			}
+			break;
+		}
+
+		case OPCODE_FOR : {
+			if (!node->L() || !node->R() || !node->L()->L() || !node->L()->R() || !node->L()->L()->L() || !node->L()->L()->R()) {
+				break;
+			}
+
+			if (frame.stage == 0) {
+				id_table.add_scope();
+				resolve(node->L()->L()->L());
+				resolve(node->L()->L()->R());
+				resolve_stack.push_back({node, 1});
+				resolve_stack.push_back({node->R(), 0});
+			} else {
+				resolve_expr(node->L()->R());
+				id_table.remove_scope();
+			}
+			break;
+		}
+
+		case OPCODE_FUNC_DECL : {
+			if (!node->L() || !node->L()->R()) {
+				break;
+			}
+
+			if (frame.stage == 1) {
+				id_table.remove_scope();
+				break;
+			}
+
+			AstNode name = node->L()->R();
+			const int sym = name->get_sym();
+			if (id_table.find_in_upper_scope(ID_TYPE_FUNC, sym) != NOT_FOUND) {
+				NAME_ERROR("Redifenition of function [");
+				name->get_id()->print();
+				printf("]\n");
+				LOG_ERROR_LINE_POS(node);
+			}
+
+			id_table.declare_func(sym, node->L()->L(), id_table.size());
+			ast->bind(name, BOUND_FUNC, id_table.find_func(sym));
+
+			id_table.add_scope(FUNC_SCOPE);
+			resolve_stack.push_back({node, 1});
+			if (node->R()) {
+				resolve_stack.push_back({node->R(), 0});
+			}
+			resolve_stack.push_back({node->L(), 0});
+			break;
+		}
+
+		default : {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// the walk of Compiler::compile(): operator chains, blocks and statement bodies
+// on resolve_stack, '{' opens a scope and closes it after its L
+void Resolver::resolve(AstNode node) {
+	if (!node) {
+		return;
+	}
+
+	const size_t base = resolve_stack.size();
+	resolve_stack.push_back({node, 0});
+
+	while (resolve_stack.size() > base) {
+		ResolveFrame frame = resolve_stack.pop_back();
+		node = frame.node;
+
+		const int op = node->is_op() ? node->get_op() : 0;
+		if (op == '{' || op == ';') {
+			if (frame.stage == 0) {
+				if (op == '{') {
+					id_table.add_scope();
+				}
+
+				resolve_stack.push_back({node, 1});
+				if (node->L()) {
+					resolve_stack.push_back({node->L(), 0});
+				}
+			} else {
+				if (op == '{') {
+					id_table.remove_scope();
+				}
+
+				if (node->R()) {
+					resolve_stack.push_back({node->R(), 0});
+				}
+			}
+			continue;
+		}
+
+		if (op && resolve_body(frame)) {
+			continue;
+		}
+
+		if (!op || ir_stack_op(op) == IR_NONE) {
+			resolve_node(node);
+			continue;
+		}
+
+		if (node->R()) {
+			resolve_stack.push_back({node->R(), 0});
+		}
+		if (node->L()) {
+			resolve_stack.push_back({node->L(), 0});
+		}
+	}
+}
+
+void Resolver::set_propagation(const bool enabled) {
+	propagate = enabled;
+}
+
+bool Resolver::resolve(FlatAst *tree, AstNode root) {
+	ast       = tree;
+	error_cnt = 0;
+
+	id_table.dtor();
+	id_table.ctor();
+
+	resolve(root);
+	return !error_cnt;
+}
+
+#undef LOG_ERROR_LINE_POS
+#undef NAME_ERROR
+#undef RESOLVE_L
+#undef RESOLVE_R
+#undef RESOLVE_LR
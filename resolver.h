@@ -0,0 +1,74 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "general/c/announcement.h"
+#include "general/cpp/vector.hpp"
+
+#include <cassert>
+
+#include "id_table.h"
+#include "flat_ast.h"
+#include "ir.h"
+
+// a node resolve() has entered, stage 1 is after its L
+struct ResolveFrame {
+	AstNode node;
+	int     stage;
+};
+
+//=============================================================================
+// Resolver ===================================================================
+// The pass between parsing and codegen that owns the IdTable. It walks the
+// tree in the order codegen does, opening and closing the same scopes, and
+// binds every name to a frame slot, a global index or a func label. A call
+// gets its label, its frame and its arguments, default ones included: their
+// expressions are cloned per call, as they resolve in each caller's scope.
+// Every undefined or redefined name is reported, codegen runs only if none.
+
+class Resolver {
+private:
+// data =======================================================================
+	FlatAst *ast;
+	IdTable  id_table;
+	Vector<ResolveFrame> resolve_stack;
+	int      error_cnt;
+	bool     propagate; // a _name defined with a value becomes BOUND_CONST
+//=============================================================================
+
+	AstBinding find_var(AstNode name) const; // BOUND_UNDEFINED if there is none
+	void bind_var(AstNode name, AstNode where);
+
+	void resolve_operation  (AstNode node);
+	void resolve_expr       (AstNode node);
+	void resolve_func_call  (AstNode node);
+	bool resolve_push_arg   (AstNode arg, AstNode name, AstParam *param);
+	void resolve_default_arg(const int call, AstNode arg, AstNode prot);
+	void resolve_context_arg(const int call, AstNode arg, AstNode prot);
+	void resolve_expr_arg   (const int call, AstNode arg, AstNode prot);
+	void add_param          (const int call, AstParam *param, AstNode name);
+	void resolve_arr_call   (AstNode node);
+	void resolve_lvalue     (AstNode node);
+	bool resolve_body       (const ResolveFrame &frame);
+	void resolve_node       (AstNode node);
+	void resolve            (AstNode node);
+
+public:
+	Resolver            (const Resolver&) = delete;
+	Resolver &operator= (const Resolver&) = delete;
+
+	Resolver ();
+	~Resolver();
+
+	void ctor();
+	static Resolver *NEW();
+
+	void dtor();
+	static void DELETE(Resolver *resolver);
+
+//=============================================================================
+
+	void set_propagation(const bool enabled);
+	bool resolve(FlatAst *tree, AstNode root); // false if a name is undefined or redefined
+};
+
+#endif // RESOLVER_H
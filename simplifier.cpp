@@ -0,0 +1,312 @@
+#include "simplifier.h"
+
+#include <cstring>
+
+// node takes the place of the operand it is rewritten to
+static void become(CodeNode *node, const CodeNode *operand) {
+	node->type = operand->type;
+	node->data = operand->data;
+	node->line = operand->line;
+	node->pos  = operand->pos;
+	node->set_LR(operand->L, operand->R);
+}
+
+static void become_value(CodeNode *node, const double value) {
+	node->set_type(VALUE);
+	node->set_val(value);
+	node->set_LR(nullptr, nullptr);
+}
+
+// a value codegen can push: -0 would come out as the text "-0"
+static bool foldable(const double value) {
+	return std::isfinite(value) && !(value == 0 && std::signbit(value));
+}
+
+//=============================================================================
+
+// c1 op c2 -> c
+static bool fold(CodeNode *node) {
+	double result = 0;
+	if (!ir_fold(ir_stack_op(node->get_op()), node->L->get_val(), node->R->get_val(), &result) || !foldable(result)) {
+		return false;
+	}
+
+	become_value(node, result);
+	return true;
+}
+
+// -c, which runs as 0 - c
+static bool negate(CodeNode *node) {
+	const double result = 0 - node->R->get_val();
+	if (!foldable(result)) {
+		return false;
+	}
+
+	become_value(node, result);
+	return true;
+}
+
+static bool to_left(CodeNode *node) {
+	become(node, node->L);
+	return true;
+}
+
+static bool to_right(CodeNode *node) {
+	become(node, node->R);
+	return true;
+}
+
+static bool to_zero(CodeNode *node) {
+	become_value(node, 0);
+	return true;
+}
+
+static bool to_one(CodeNode *node) {
+	become_value(node, 1);
+	return true;
+}
+
+// x + -c -> x - c and x - -c -> x + c, what x - c is defined as
+static bool flip_sign(CodeNode *node) {
+	node->set_op(node->get_op() == '+' ? '-' : '+');
+	node->R->set_val(-node->R->get_val());
+	return true;
+}
+
+// - - x runs as 0 - (0 - x), which is x but for -0, and so is x + 0
+static bool double_negation(CodeNode *node) {
+	CodeNode *inner = node->R;
+	CodeNode *x     = inner->R;
+
+	become_value(inner, 0);
+	node->set_op('+');
+	node->set_LR(x, inner);
+	return true;
+}
+
+// x + 0 is not x for x = -0 and x * 0 is not 0 for x < 0 or inf: those stay
+static const SimplifyRule SIMPLIFY_RULES[] = {
+	{"fold",            0,          MATCH_CONST,  MATCH_CONST, fold},
+	{"negate-constant", '-',        MATCH_ABSENT, MATCH_CONST, negate},
+	{"unary-plus",      '+',        MATCH_ABSENT, MATCH_ANY,   to_right},
+	{"double-negation", '-',        MATCH_ABSENT, MATCH_NEG,   double_negation},
+	{"add-zero",        '+',        MATCH_BOOL,   MATCH_ZERO,  to_left},
+	{"add-zero",        '+',        MATCH_ZERO,   MATCH_BOOL,  to_right},
+	{"sub-zero",        '-',        MATCH_ANY,    MATCH_ZERO,  to_left},
+	{"add-negative",    '+',        MATCH_ANY,    MATCH_BELOW, flip_sign},
+	{"sub-negative",    '-',        MATCH_ANY,    MATCH_BELOW, flip_sign},
+	{"mul-one",         '*',        MATCH_ANY,    MATCH_ONE,   to_left},
+	{"mul-one",         '*',        MATCH_ONE,    MATCH_ANY,   to_right},
+	{"div-one",         '/',        MATCH_ANY,    MATCH_ONE,   to_left},
+	{"pow-one",         '^',        MATCH_ANY,    MATCH_ONE,   to_left},
+	{"pow-zero",        '^',        MATCH_PURE,   MATCH_ZERO,  to_one},
+	{"and-false",       OPCODE_AND, MATCH_PURE,   MATCH_ZERO,  to_zero},
+	{"and-false",       OPCODE_AND, MATCH_ZERO,   MATCH_PURE,  to_zero},
+	{"and-true",        OPCODE_AND, MATCH_BOOL,   MATCH_TRUE,  to_left},
+	{"and-true",        OPCODE_AND, MATCH_TRUE,   MATCH_BOOL,  to_right},
+	{"or-true",         OPCODE_OR,  MATCH_PURE,   MATCH_TRUE,  to_one},
+	{"or-true",         OPCODE_OR,  MATCH_TRUE,   MATCH_PURE,  to_one},
+	{"or-false",        OPCODE_OR,  MATCH_BOOL,   MATCH_ZERO,  to_left},
+	{"or-false",        OPCODE_OR,  MATCH_ZERO,   MATCH_BOOL,  to_right},
+};
+
+static const int SIMPLIFY_RULE_CNT = (int) (sizeof(SIMPLIFY_RULES) / sizeof(SIMPLIFY_RULES[0]));
+
+//=============================================================================
+// Simplifier =================================================================
+
+Simplifier::Simplifier():
+walk(),
+scan(),
+fired(nullptr)
+{}
+
+Simplifier::~Simplifier() {}
+
+void Simplifier::ctor() {
+	walk.ctor();
+	scan.ctor();
+	fired = (size_t*) calloc(SIMPLIFY_RULE_CNT, sizeof(size_t));
+	if (!fired) {
+		throw std::length_error("[ERR]<simplifier>: calloc fail");
+	}
+}
+
+Simplifier *Simplifier::NEW() {
+	Simplifier *cake = (Simplifier*) calloc(1, sizeof(Simplifier));
+	if (!cake) {
+		return nullptr;
+	}
+
+	cake->ctor();
+	return cake;
+}
+
+void Simplifier::dtor() {
+	walk.dtor();
+	scan.dtor();
+	free(fired);
+	fired = nullptr;
+}
+
+void Simplifier::DELETE(Simplifier *simplifier) {
+	if (!simplifier) {
+		return;
+	}
+
+	simplifier->dtor();
+	free(simplifier);
+}
+
+//=============================================================================
+
+bool Simplifier::is_pure(const CodeNode *node) {
+	while (scan.size()) {
+		scan.pop_back();
+	}
+	scan.push_back(node);
+
+	for (int seen = 0; scan.size(); ++seen) {
+		if (seen == SIMPLIFIER_PURE_SCAN) {
+			return false;
+		}
+
+		node = scan.pop_back();
+		switch (node->get_type()) {
+			case VALUE : break;
+
+			case OPERATION : {
+				if (ir_stack_op(node->get_op()) == IR_NONE) {
+					return false;
+				}
+
+				if (node->L) {
+					scan.push_back(node->L);
+				}
+				if (node->R) {
+					scan.push_back(node->R);
+				}
+				break;
+			}
+
+			default : return false;
+		}
+	}
+
+	return true;
+}
+
+bool Simplifier::matches(const CodeNode *operand, const int what) {
+	switch (what) {
+		case MATCH_ANY    : return operand;
+		case MATCH_ABSENT : return !operand;
+		case MATCH_CONST  : return operand && operand->is_val();
+		case MATCH_ZERO   : return operand && operand->is_val() && operand->get_val() == 0 && !std::signbit(operand->get_val());
+		case MATCH_ONE    : return operand && operand->is_val() && operand->get_val() == 1;
+		case MATCH_TRUE   : return operand && operand->is_val() && operand->get_val() != 0;
+		case MATCH_BELOW  : return operand && operand->is_val() && operand->get_val() < 0;
+		case MATCH_NEG    : return operand && operand->is_op('-') && !operand->L && operand->R;
+		case MATCH_PURE   : return operand && is_pure(operand);
+
+		case MATCH_BOOL : {
+			if (!operand) {
+				return false;
+			}
+
+			if (operand->is_val()) {
+				return operand->get_val() == 1 || (operand->get_val() == 0 && !std::signbit(operand->get_val()));
+			}
+
+			switch (operand->is_op() ? operand->get_op() : 0) {
+				case '<' :
+				case '>' :
+				case OPCODE_LE :
+				case OPCODE_GE :
+				case OPCODE_EQ :
+				case OPCODE_NEQ :
+				case OPCODE_AND :
+				case OPCODE_OR : return operand->L; // a unary one is not a comparison
+				default : return false;
+			}
+		}
+
+		default : return false;
+	}
+}
+
+// rules are tried in order until one fires, then again on what it made
+int Simplifier::simplify_node(CodeNode *node) {
+	int rewrites = 0;
+
+	for (int r = 0; r < SIMPLIFY_RULE_CNT && node->is_op() && ir_stack_op(node->get_op()) != IR_NONE; ++r) {
+		const SimplifyRule &rule = SIMPLIFY_RULES[r];
+		if (rule.op && rule.op != node->get_op()) {
+			continue;
+		}
+
+		// the pure scan goes last
+		const bool fits = rule.left == MATCH_PURE
+		                ? matches(node->R, rule.right) && matches(node->L, rule.left)
+		                : matches(node->L, rule.left)  && matches(node->R, rule.right);
+		if (!fits || !rule.rewrite(node)) {
+			continue;
+		}
+
+		++fired[r];
+		++rewrites;
+		r = -1;
+	}
+
+	return rewrites;
+}
+
+int Simplifier::simplify(CodeNode *root) {
+	if (!root) {
+		return 0;
+	}
+
+	int rewrites = 0;
+	walk.push_back({root, 0});
+	while (walk.size()) {
+		SimplifyFrame frame = walk.pop_back();
+		CodeNode *node = frame.node;
+
+		if (frame.stage == 0) {
+			walk.push_back({node, 1});
+			if (node->R) {
+				walk.push_back({node->R, 0});
+			}
+			if (node->L) {
+				walk.push_back({node->L, 0});
+			}
+			continue;
+		}
+
+		rewrites += simplify_node(node);
+	}
+
+	return rewrites;
+}
+
+void Simplifier::dump_stats(FILE *file) const {
+	size_t total = 0;
+
+	fprintf(file, "%-18s %10s\n", "simplify", "fired");
+	for (int i = 0; i < SIMPLIFY_RULE_CNT; ++i) {
+		// a rule in two orders is counted once, under the first
+		if (i && !strcmp(SIMPLIFY_RULES[i].name, SIMPLIFY_RULES[i - 1].name)) {
+			continue;
+		}
+
+		size_t cnt = fired[i];
+		for (int j = i + 1; j < SIMPLIFY_RULE_CNT && !strcmp(SIMPLIFY_RULES[j].name, SIMPLIFY_RULES[i].name); ++j) {
+			cnt += fired[j];
+		}
+
+		if (cnt) {
+			fprintf(file, "%-18s %10zu\n", SIMPLIFY_RULES[i].name, cnt);
+			total += cnt;
+		}
+	}
+	fprintf(file, "%-18s %10zu\n", "total", total);
+}
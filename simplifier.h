@@ -0,0 +1,87 @@
+#ifndef SIMPLIFIER_H
+#define SIMPLIFIER_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "general/cpp/vector.hpp"
+
+#include "code_node.h"
+#include "ir.h"
+
+const int SIMPLIFIER_PURE_SCAN = 256; // nodes looked through to prove an operand has no side effects
+
+// what an operand of a rule has to be
+enum SIMPLIFY_MATCH {
+	MATCH_ANY = 0,
+	MATCH_ABSENT, // no operand, as L of unary - and +
+	MATCH_CONST,  // a value
+	MATCH_ZERO,   // the value 0, not -0
+	MATCH_ONE,
+	MATCH_TRUE,   // a value but 0
+	MATCH_BELOW,  // a value below 0, pushed as 0 - |value|
+	MATCH_BOOL,   // 0 or 1 whatever it is: a comparison, && or ||
+	MATCH_PURE,   // values and stack ops of them: evaluating it changes nothing and names no var to report
+	MATCH_NEG,    // a unary minus
+};
+
+class Simplifier;
+
+// A rule matches an operation node by its op and what its operands are and
+// rewrites it in place. rewrite() returns false if the values do not fit.
+// Names are never dropped: the Resolver still has to see an undefined one.
+struct SimplifyRule {
+	const char *name;
+	int         op;
+	int         left;  // SIMPLIFY_MATCH of L
+	int         right; // of R
+	bool      (*rewrite)(CodeNode *node);
+};
+
+// a node simplify() has entered, stage 1 is after its children
+struct SimplifyFrame {
+	CodeNode *node;
+	int       stage;
+};
+
+//=============================================================================
+// Simplifier =================================================================
+// Folds constant expressions and applies the identities of SIMPLIFY_RULES to
+// the CodeNode tree before it is flattened, children first. Only rewrites
+// that give the same double, -0 and NaN included, are made, and an operand is
+// dropped only if evaluating it has no effect.
+
+class Simplifier {
+private:
+// data =======================================================================
+	Vector<SimplifyFrame>    walk;
+	Vector<const CodeNode*>  scan;  // is_pure() stack
+	size_t                  *fired; // per rule
+//=============================================================================
+
+	bool is_pure (const CodeNode *node);
+	bool matches (const CodeNode *operand, const int what);
+	int  simplify_node(CodeNode *node); // returns the rewrites made
+
+public:
+	Simplifier            (const Simplifier&) = delete;
+	Simplifier &operator= (const Simplifier&) = delete;
+
+	Simplifier ();
+	~Simplifier();
+
+	void ctor();
+	static Simplifier *NEW();
+
+	void dtor();
+	static void DELETE(Simplifier *simplifier);
+
+//=============================================================================
+
+	int simplify(CodeNode *root); // returns the rewrites made
+
+	void dump_stats(FILE *file) const;
+};
+
+#endif // SIMPLIFIER_H
@@ -0,0 +1,175 @@
+#include "symbol_pool.h"
+
+SymbolPool SYMBOL_POOL;
+
+unsigned SymbolPool::hash(const char *name, const size_t length) {
+	unsigned ret = 2166136261u; // FNV-1a
+	for (size_t i = 0; i < length; ++i) {
+		ret = (ret ^ (unsigned char) name[i]) * 16777619u;
+	}
+	return ret;
+}
+
+const char *SymbolPool::store(const char *name, const size_t length) {
+	if (length > chunk_left) {
+		size_t chunk_size = length > SYMBOL_POOL_CHUNK_SIZE ? length : SYMBOL_POOL_CHUNK_SIZE;
+		chunk_cur = (char*) calloc(chunk_size, sizeof(char));
+		if (!chunk_cur) {
+			throw std::length_error("[ERR]<symbol_pool>: chunk alloc fail");
+		}
+
+		chunks.push_back(chunk_cur);
+		chunk_left = chunk_size;
+	}
+
+	char *ret = chunk_cur;
+	memcpy(ret, name, length);
+	chunk_cur  += length;
+	chunk_left -= length;
+	return ret;
+}
+
+void SymbolPool::rehash(const size_t new_bucket_cnt) {
+	free(buckets);
+	buckets = (int*) malloc(new_bucket_cnt * sizeof(int));
+	if (!buckets) {
+		throw std::length_error("[ERR]<symbol_pool>: buckets alloc fail");
+	}
+	bucket_cnt = new_bucket_cnt;
+
+	for (size_t i = 0; i < bucket_cnt; ++i) {
+		buckets[i] = NO_SYMBOL;
+	}
+
+	const size_t mask = bucket_cnt - 1;
+	for (size_t sym = 0; sym < names.size(); ++sym) {
+		size_t i = hashes[sym] & mask;
+		while (buckets[i] != NO_SYMBOL) {
+			i = (i + 1) & mask;
+		}
+		buckets[i] = (int) sym;
+	}
+}
+
+SymbolPool::SymbolPool():
+names(),
+hashes(),
+buckets(nullptr),
+bucket_cnt(0),
+chunks(),
+chunk_cur(nullptr),
+chunk_left(0)
+{}
+
+SymbolPool::~SymbolPool() {}
+
+void SymbolPool::ctor() {
+	names.ctor();
+	hashes.ctor();
+	chunks.ctor();
+
+	buckets    = nullptr;
+	chunk_cur  = nullptr;
+	chunk_left = 0;
+	rehash(SYMBOL_POOL_INIT_BUCKETS);
+}
+
+SymbolPool *SymbolPool::NEW() {
+	SymbolPool *cake = (SymbolPool*) calloc(1, sizeof(SymbolPool));
+	if (!cake) {
+		return nullptr;
+	}
+
+	cake->ctor();
+	return cake;
+}
+
+void SymbolPool::dtor() {
+	if (!bucket_cnt) {
+		return;
+	}
+
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		free(chunks[i]);
+	}
+	chunks.dtor();
+	names.dtor();
+	hashes.dtor();
+
+	free(buckets);
+	buckets    = nullptr;
+	bucket_cnt = 0;
+	chunk_cur  = nullptr;
+	chunk_left = 0;
+}
+
+void SymbolPool::DELETE(SymbolPool *pool) {
+	if (!pool) {
+		return;
+	}
+
+	pool->dtor();
+	free(pool);
+}
+
+//=============================================================================
+
+int SymbolPool::intern(const char *name, const size_t length) {
+	if (!bucket_cnt) {
+		ctor();
+	}
+
+	const unsigned h = hash(name, length);
+	const size_t mask = bucket_cnt - 1;
+	size_t i = h & mask;
+	for (; buckets[i] != NO_SYMBOL; i = (i + 1) & mask) {
+		const int sym = buckets[i];
+		if (hashes[sym] == h && names[sym].length() == length && !memcmp(names[sym].get_buffer(), name, length)) {
+			return sym;
+		}
+	}
+
+	const int sym = (int) names.size();
+
+	StringView view = {};
+	view.ctor(store(name, length), false);
+	view.set_length(length);
+	names.push_back(view);
+	hashes.push_back(h);
+	buckets[i] = sym;
+
+	if (2 * names.size() > bucket_cnt) {
+		rehash(bucket_cnt * 2);
+	}
+
+	return sym;
+}
+
+int SymbolPool::find(const char *name, const size_t length) const {
+	if (!bucket_cnt) {
+		return NO_SYMBOL;
+	}
+
+	const unsigned h = hash(name, length);
+	const size_t mask = bucket_cnt - 1;
+	for (size_t i = h & mask; buckets[i] != NO_SYMBOL; i = (i + 1) & mask) {
+		const int sym = buckets[i];
+		if (hashes[sym] == h && names[sym].length() == length && !memcmp(names[sym].get_buffer(), name, length)) {
+			return sym;
+		}
+	}
+
+	return NO_SYMBOL;
+}
+
+const StringView *SymbolPool::get(const int sym) const {
+	if (sym < 0 || (size_t) sym >= names.size()) {
+		return nullptr;
+	}
+
+	return &names[(size_t) sym];
+}
+
+int SymbolPool::size() const {
+	return (int) names.size();
+}
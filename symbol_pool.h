@@ -0,0 +1,61 @@
+#ifndef SYMBOL_POOL_H
+#define SYMBOL_POOL_H
+
+#include "general/cpp/stringview.hpp"
+#include "general/cpp/vector.hpp"
+
+const int NO_SYMBOL = -1;
+
+const size_t SYMBOL_POOL_INIT_BUCKETS = 1024;
+const size_t SYMBOL_POOL_CHUNK_SIZE   = 1 << 16;
+
+//=============================================================================
+// SymbolPool =================================================================
+// Interns identifiers: every distinct name gets one canonical StringView and
+// a dense symbol id, so identifiers compare as ints everywhere after lexing.
+// Names are copied into pool-owned chunks and outlive the source buffer.
+
+class SymbolPool {
+private:
+// data =======================================================================
+	Vector<StringView> names;   // symbol -> name
+	Vector<unsigned>   hashes;  // symbol -> hash of the name
+	int               *buckets; // open addressing, NO_SYMBOL is empty
+	size_t             bucket_cnt;
+
+	Vector<char*>      chunks;
+	char              *chunk_cur;
+	size_t             chunk_left;
+//=============================================================================
+
+	static unsigned hash(const char *name, const size_t length);
+
+	const char *store(const char *name, const size_t length);
+	void rehash(const size_t new_bucket_cnt);
+
+public:
+	SymbolPool            (const SymbolPool&) = delete;
+	SymbolPool &operator= (const SymbolPool&) = delete;
+
+	SymbolPool ();
+	~SymbolPool();
+
+	void ctor();
+	static SymbolPool *NEW();
+
+	void dtor();
+	static void DELETE(SymbolPool *pool);
+
+//=============================================================================
+
+	int intern(const char *name, const size_t length);
+	int find  (const char *name, const size_t length) const;
+
+	const StringView *get(const int sym) const;
+
+	int size() const;
+};
+
+extern SymbolPool SYMBOL_POOL;
+
+#endif // SYMBOL_POOL_H
@@ -0,0 +1,396 @@
+#include "token_stream.h"
+#include "lexical_parser.h"
+
+const size_t TOKEN_STREAM_BYTES_PER_TOKEN = 4; // average over the examples is 4.5
+const size_t TOKEN_STREAM_INIT_RUNS       = 64;
+
+void TokenStream::realloc_buffers(const size_t new_capacity) {
+	char      *new_kinds     = (char*)      realloc(kinds,     new_capacity * sizeof(char));
+	TokenData *new_payloads  = (TokenData*) realloc(payloads,  new_capacity * sizeof(TokenData));
+	int       *new_positions = (int*)       realloc(positions, new_capacity * sizeof(int));
+
+	if (new_kinds)     kinds     = new_kinds;
+	if (new_payloads)  payloads  = new_payloads;
+	if (new_positions) positions = new_positions;
+
+	if (!new_kinds || !new_payloads || !new_positions) {
+		throw std::length_error("[ERR]<token_stream>: realloc fail");
+	}
+
+	capacity = new_capacity;
+}
+
+size_t TokenStream::release_floor() const {
+	size_t floor = furthest > TOKEN_STREAM_SLACK ? furthest - TOKEN_STREAM_SLACK : 0;
+	for (size_t i = 0; i < pins.size(); ++i) {
+		if (pins[i] < floor) {
+			floor = pins[i];
+		}
+	}
+
+	return floor > base ? floor : base;
+}
+
+void TokenStream::release_before(const size_t index) {
+	const size_t shift = index - base;
+	count -= shift;
+	memmove(kinds,     kinds     + shift, count * sizeof(char));
+	memmove(payloads,  payloads  + shift, count * sizeof(TokenData));
+	memmove(positions, positions + shift, count * sizeof(int));
+	base = index;
+
+	size_t first_run = 0; // the run holding the new base stays
+	while (first_run + 1 < run_cnt && (size_t) runs[first_run + 1].first <= base) {
+		++first_run;
+	}
+
+	run_cnt -= first_run;
+	memmove(runs, runs + first_run, run_cnt * sizeof(TokenLineRun));
+}
+
+void TokenStream::fetch_slow(const size_t i, Token *token) {
+	while (source && i >= size()) {
+		source->lex_until(i + TOKEN_STREAM_BATCH);
+	}
+
+	window_index(i);
+	fetch(i, token);
+}
+
+TokenStream::TokenStream():
+kinds(nullptr),
+payloads(nullptr),
+positions(nullptr),
+base(0),
+count(0),
+capacity(0),
+runs(nullptr),
+run_cnt(0),
+run_cap(0),
+streaming(false),
+source(nullptr),
+furthest(0),
+pins()
+{}
+
+TokenStream::~TokenStream() {}
+
+void TokenStream::ctor(const size_t capacity_, LexicalParser *source_) {
+	kinds     = nullptr;
+	payloads  = nullptr;
+	positions = nullptr;
+	base      = 0;
+	count     = 0;
+	capacity  = 0;
+	realloc_buffers(capacity_ ? capacity_ : 1);
+
+	run_cnt = 0;
+	run_cap = TOKEN_STREAM_INIT_RUNS;
+	runs    = (TokenLineRun*) calloc(run_cap, sizeof(TokenLineRun));
+	if (!runs) {
+		throw std::length_error("[ERR]<token_stream>: runs alloc fail");
+	}
+
+	streaming = source_ != nullptr;
+	source    = source_;
+	furthest  = 0;
+	pins.ctor();
+}
+
+TokenStream *TokenStream::NEW(const size_t capacity_, LexicalParser *source_) {
+	TokenStream *cake = (TokenStream*) calloc(1, sizeof(TokenStream));
+	if (!cake) {
+		return nullptr;
+	}
+
+	cake->ctor(capacity_, source_);
+	return cake;
+}
+
+void TokenStream::dtor() {
+	free(kinds);
+	free(payloads);
+	free(positions);
+	free(runs);
+	kinds     = nullptr;
+	payloads  = nullptr;
+	positions = nullptr;
+	runs      = nullptr;
+	base      = 0;
+	count     = 0;
+	capacity  = 0;
+	run_cnt   = 0;
+	run_cap   = 0;
+	source    = nullptr;
+	pins.dtor();
+}
+
+void TokenStream::DELETE(TokenStream *stream) {
+	if (!stream) {
+		return;
+	}
+
+	stream->dtor();
+	free(stream);
+}
+
+//=============================================================================
+
+size_t TokenStream::estimate_capacity(const size_t source_length) {
+	return source_length / TOKEN_STREAM_BYTES_PER_TOKEN + 32;
+}
+
+void TokenStream::push_run(const int first, const int line, const int start) {
+	if (run_cnt && runs[run_cnt - 1].line == line) {
+		return;
+	}
+
+	if (run_cnt == run_cap) {
+		TokenLineRun *new_runs = (TokenLineRun*) realloc(runs, run_cap * 2 * sizeof(TokenLineRun));
+		if (!new_runs) {
+			throw std::length_error("[ERR]<token_stream>: runs realloc fail");
+		}
+
+		runs     = new_runs;
+		run_cap *= 2;
+	}
+
+	runs[run_cnt].first = first;
+	runs[run_cnt].line  = line;
+	runs[run_cnt].start = start;
+	++run_cnt;
+}
+
+void TokenStream::push_back(const Token &token, const int line_start) {
+	if (count == capacity) {
+		const size_t floor = streaming ? release_floor() : base;
+		if (floor - base >= capacity / 2) {
+			release_before(floor);
+		} else {
+			realloc_buffers(capacity * 2);
+		}
+	}
+
+	push_run((int) size(), token.line, line_start);
+
+	kinds    [count] = (char) token.type;
+	payloads [count] = token.data;
+	positions[count] = token.pos;
+	++count;
+}
+
+void TokenStream::reserve(const size_t new_capacity) {
+	if (new_capacity > capacity) {
+		realloc_buffers(new_capacity);
+	}
+}
+
+void TokenStream::shrink_to_fit() {
+	if (!streaming && count && count < capacity) {
+		realloc_buffers(count);
+	}
+}
+
+void TokenStream::finish() {
+	source = nullptr;
+}
+
+int TokenStream::line(const size_t i) const {
+	size_t hint = 0;
+	return line(i, &hint);
+}
+
+size_t TokenStream::find_run(const size_t i, size_t *run_hint) const {
+	window_index(i);
+
+	size_t h = *run_hint < run_cnt ? *run_hint : run_cnt - 1;
+	if ((size_t) runs[h].first <= i && (h + 1 == run_cnt || i < (size_t) runs[h + 1].first)) {
+		return h;
+	}
+
+	if (h + 1 < run_cnt && (size_t) runs[h + 1].first <= i && (h + 2 == run_cnt || i < (size_t) runs[h + 2].first)) {
+		*run_hint = h + 1;
+		return h + 1;
+	}
+
+	size_t l = 0;
+	size_t r = run_cnt;
+	while (r - l > 1) { // last run with first <= i
+		size_t m = (l + r) / 2;
+		if ((size_t) runs[m].first <= i) {
+			l = m;
+		} else {
+			r = m;
+		}
+	}
+
+	*run_hint = l;
+	return l;
+}
+
+int TokenStream::line(const size_t i, size_t *run_hint) const {
+	return runs[find_run(i, run_hint)].line;
+}
+
+size_t TokenStream::line_start(const size_t i, size_t *run_hint) const {
+	return (size_t) runs[find_run(i, run_hint)].start;
+}
+
+size_t TokenStream::offset(const size_t i, size_t *run_hint, const SymbolPool *symbols) const {
+	const size_t j = window_index(i);
+	size_t ret = line_start(i, run_hint) + (size_t) positions[j];
+	if (kinds[j] == T_ID) { // ids are positioned after their last char
+		ret -= symbols->get(payloads[j].id)->length();
+	}
+	return ret;
+}
+
+Token TokenStream::get(const size_t i) const {
+	const size_t j = window_index(i);
+
+	Token token = {};
+	token.type = kinds[j];
+	token.data = payloads[j];
+	token.line = line(i);
+	token.pos  = positions[j];
+	return token;
+}
+
+void TokenStream::splice(const size_t from, const size_t to, const TokenStream *fresh, const size_t fresh_cnt,
+                         const int line_delta, const int offset_delta, const int pos_delta) {
+	size_t hint = 0;
+	const size_t to_run   = find_run(to, &hint); // `to` is a kept token, T_END at the latest
+	const size_t tail     = count - to;
+	const size_t new_size = from + fresh_cnt + tail;
+	if (new_size > capacity) {
+		realloc_buffers(new_size + new_size / 8 + 32); // room for the next few edits
+	}
+
+	const size_t dest = from + fresh_cnt;
+	if (dest != to) {
+		memmove(kinds     + dest, kinds     + to, tail * sizeof(char));
+		memmove(payloads  + dest, payloads  + to, tail * sizeof(TokenData));
+		memmove(positions + dest, positions + to, tail * sizeof(int));
+	}
+	memcpy (kinds     + from, fresh->kinds,     fresh_cnt * sizeof(char));
+	memcpy (payloads  + from, fresh->payloads,  fresh_cnt * sizeof(TokenData));
+	memcpy (positions + from, fresh->positions, fresh_cnt * sizeof(int));
+	count = new_size;
+
+	size_t line_end = dest + tail; // the tokens of the line of `to` get pos_delta
+	if (to_run + 1 < run_cnt) {
+		line_end = dest + (size_t) runs[to_run + 1].first - to;
+	}
+	for (size_t i = dest; i < line_end; ++i) {
+		positions[i] += pos_delta;
+	}
+
+	size_t keep = 0; // runs starting before `from` stay as they are
+	while (keep < run_cnt && (size_t) runs[keep].first < from) {
+		++keep;
+	}
+
+	int last_line = keep ? runs[keep - 1].line : 0;
+	size_t added = 0;
+	for (size_t r = 0; r < fresh->run_cnt && (size_t) fresh->runs[r].first < fresh_cnt; ++r) {
+		if (!(keep + added) || fresh->runs[r].line != last_line) {
+			last_line = fresh->runs[r].line;
+			++added;
+		}
+	}
+
+	const size_t merged  = (keep + added && runs[to_run].line + line_delta == last_line) ? 1 : 0;
+	const size_t moved   = run_cnt - to_run - merged;
+	const size_t new_cnt = keep + added + moved;
+	if (new_cnt > run_cap) {
+		TokenLineRun *new_runs = (TokenLineRun*) realloc(runs, new_cnt * 2 * sizeof(TokenLineRun));
+		if (!new_runs) {
+			throw std::length_error("[ERR]<token_stream>: runs realloc fail");
+		}
+
+		runs    = new_runs;
+		run_cap = new_cnt * 2;
+	}
+
+	const int to_start = runs[to_run].start;
+	memmove(runs + keep + added, runs + to_run + merged, moved * sizeof(TokenLineRun));
+
+	run_cnt = keep;
+	for (size_t r = 0; r < fresh->run_cnt && (size_t) fresh->runs[r].first < fresh_cnt; ++r) {
+		push_run((int) from + fresh->runs[r].first, fresh->runs[r].line, fresh->runs[r].start);
+	}
+
+	for (size_t r = run_cnt; r < new_cnt; ++r) { // the rest is shifted, not relexed
+		runs[r].first += (int) dest - (int) to;
+		runs[r].line  += line_delta;
+		runs[r].start += offset_delta;
+	}
+
+	if (!merged && moved) { // the run of `to` may have started before it
+		runs[run_cnt].first = (int) dest;
+		runs[run_cnt].start = to_start + offset_delta - pos_delta;
+	}
+	run_cnt = new_cnt;
+}
+
+void TokenStream::append(const TokenStream *src, const size_t first, const int line_delta, const int pos_delta,
+                         const SymbolPool *src_symbols, int *id_map) {
+	if (first >= src->size()) {
+		return;
+	}
+
+	const size_t src_j = src->window_index(first);
+	const size_t cnt   = src->count - src_j;
+	if (count + cnt > capacity) {
+		realloc_buffers(count + cnt > capacity * 2 ? count + cnt : capacity * 2);
+	}
+
+	const size_t dest = size();
+	memcpy(kinds     + count, src->kinds     + src_j, cnt * sizeof(char));
+	memcpy(payloads  + count, src->payloads  + src_j, cnt * sizeof(TokenData));
+	memcpy(positions + count, src->positions + src_j, cnt * sizeof(int));
+
+	for (size_t j = count; j < count + cnt; ++j) {
+		if (kinds[j] != T_ID) {
+			continue;
+		}
+
+		const int sym = payloads[j].id;
+		if (id_map[sym] == NO_SYMBOL) {
+			const StringView *name = src_symbols->get(sym);
+			id_map[sym] = SYMBOL_POOL.intern(name->get_buffer(), name->length());
+		}
+		payloads[j].id = id_map[sym];
+	}
+
+	size_t hint = 0;
+	const size_t first_run = src->find_run(first, &hint);
+	const int    run_delta = (size_t) src->runs[first_run].first < first ? pos_delta : 0; // still on the line of first - 1
+	const size_t line_end  = first_run + 1 < src->run_cnt ? (size_t) src->runs[first_run + 1].first : src->size();
+	for (size_t i = first; i < line_end; ++i) {
+		positions[count + i - first] += run_delta;
+	}
+	count += cnt;
+
+	for (size_t r = first_run; r < src->run_cnt; ++r) {
+		const size_t run_first = (size_t) src->runs[r].first > first ? (size_t) src->runs[r].first : first;
+		const int    start     = src->runs[r].start - (r == first_run ? run_delta : 0);
+		push_run((int) (run_first - first + dest), src->runs[r].line + line_delta, start);
+	}
+}
+
+void TokenStream::pin(const size_t i) {
+	if (streaming) {
+		pins.push_back(i);
+	}
+}
+
+void TokenStream::unpin() {
+	if (streaming) {
+		pins.pop_back();
+	}
+}
+
+size_t TokenStream::memory() const {
+	return capacity * (sizeof(char) + sizeof(TokenData) + sizeof(int)) + run_cap * sizeof(TokenLineRun);
+}
@@ -0,0 +1,159 @@
+#ifndef TOKEN_STREAM
+#define TOKEN_STREAM
+
+#include "general/cpp/vector.hpp"
+
+#include "lex_token.h"
+#include "symbol_pool.h"
+
+class LexicalParser;
+
+const size_t TOKEN_STREAM_BATCH = 256; // tokens lexed per pull in streaming mode
+const size_t TOKEN_STREAM_SLACK = 64;  // tokens kept behind the furthest fetch for PREV()
+
+//=============================================================================
+// TokenStream ================================================================
+// Structure-of-arrays token storage: kinds, payloads and positions live in
+// separate dense arrays, so the parser's type/data checks stay in cache.
+// Lines are stored once per source line as runs of token indices.
+//
+// Indices are absolute, the arrays hold the window [base, base + count).
+// A streaming stream is filled lazily from its lexer by fetch(), and tokens
+// behind both the oldest pin and the slack are dropped when it refills.
+// Touching a dropped token throws, as an out-of-range index does.
+
+struct TokenLineRun {
+	int first; // index of the first token on the line
+	int line;
+	int start; // source offset of the line
+};
+
+class TokenStream {
+private:
+// data =======================================================================
+	char          *kinds;
+	TokenData     *payloads;
+	int           *positions;
+	size_t         base;
+	size_t         count;
+	size_t         capacity;
+
+	TokenLineRun  *runs;
+	size_t         run_cnt;
+	size_t         run_cap;
+
+	bool           streaming;
+	LexicalParser *source;   // nullptr once T_END is lexed
+	size_t         furthest; // furthest fetched index
+	Vector<size_t> pins;     // pinned indices, innermost last
+//=============================================================================
+
+	void realloc_buffers(const size_t new_capacity);
+	void release_before (const size_t index);
+	size_t release_floor() const;
+
+	void fetch_slow(const size_t i, Token *token);
+
+	size_t find_run(const size_t i, size_t *run_hint) const;
+	void push_run(const int first, const int line, const int start);
+
+	size_t window_index(const size_t i) const {
+		const size_t j = i - base;
+		if (j >= count) {
+			throw std::length_error(i < base ? "[ERR]<token_stream>: token released" : "[ERR]<token_stream>: index overflow");
+		}
+		return j;
+	}
+
+public:
+	TokenStream            (const TokenStream&) = delete;
+	TokenStream &operator= (const TokenStream&) = delete;
+
+	TokenStream ();
+	~TokenStream();
+
+	void ctor(const size_t capacity_ = 32, LexicalParser *source_ = nullptr);
+	static TokenStream *NEW(const size_t capacity_ = 32, LexicalParser *source_ = nullptr);
+
+	void dtor();
+	static void DELETE(TokenStream *stream);
+
+//=============================================================================
+
+	static size_t estimate_capacity(const size_t source_length);
+
+	void push_back(const Token &token, const int line_start);
+	void reserve(const size_t new_capacity);
+	void shrink_to_fit();
+	void finish(); // the source has lexed T_END
+
+	size_t size() const { return base + count; } // lexed so far
+	bool  whole() const { return !source && !base; } // lexed to T_END, nothing released
+	bool  released(const size_t i) const { return i < base; }
+
+	int       type(const size_t i) const { return kinds    [window_index(i)]; }
+	TokenData data(const size_t i) const { return payloads [window_index(i)]; }
+	int       pos (const size_t i) const { return positions[window_index(i)]; }
+	int       line(const size_t i) const;
+	int       line(const size_t i, size_t *run_hint) const; // amortized O(1) for nearby i
+
+	size_t line_start(const size_t i, size_t *run_hint) const;
+	size_t offset    (const size_t i, size_t *run_hint, const SymbolPool *symbols = &SYMBOL_POOL) const; // where the token starts in the source
+
+	void fetch(const size_t i, Token *token) { // type and data only, the parser's hot path
+		const size_t j = i - base;
+		if (j >= count) {
+			fetch_slow(i, token);
+			return;
+		}
+
+		if (streaming && i > furthest) { // whole streams are read by parser workers at once
+			furthest = i;
+		}
+
+		token->type = kinds[j];
+		token->data = payloads[j];
+	}
+
+	Token get(const size_t i) const;
+
+	// Replaces tokens [from, to) with the first fresh_cnt tokens of fresh, whose runs
+	// are numbered from 0. Lines of the tokens after it move by line_delta and their
+	// offsets by offset_delta; the tokens left on the line of `to` also get pos_delta.
+	void splice(const size_t from, const size_t to, const TokenStream *fresh, const size_t fresh_cnt,
+	            const int line_delta, const int offset_delta, const int pos_delta);
+
+	// Appends the tokens of src from first on, shifting their lines by line_delta and
+	// the positions of those still on the line of first - 1 by pos_delta. Ids are moved
+	// from src_symbols to SYMBOL_POOL through id_map, filled in on first use.
+	void append(const TokenStream *src, const size_t first, const int line_delta, const int pos_delta,
+	            const SymbolPool *src_symbols, int *id_map);
+
+	void pin  (const size_t i);
+	void unpin();
+
+	size_t memory() const;
+};
+
+//=============================================================================
+// TokenPin ===================================================================
+// Keeps a parser reset point inside the stream window while in scope.
+
+struct TokenPin {
+	TokenStream *stream;
+
+	TokenPin(TokenStream *stream_, const size_t i):
+	stream(stream_)
+	{
+		stream->pin(i);
+	}
+
+	~TokenPin() {
+		stream->unpin();
+	}
+
+	TokenPin            (const TokenPin&) = delete;
+	TokenPin &operator= (const TokenPin&) = delete;
+};
+
+#endif // TOKEN_STREAM